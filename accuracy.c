@@ -0,0 +1,330 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "getopthelp.h"
+#include "libunvigenere.h"
+#include "synth.h"
+#include "driver.h"
+#include "misc.h"
+
+
+/*
+ * Crack accuracy versus cost.
+ * Encrypt synthetic plaintexts of several sizes with random keys of several
+ * lengths, crack them with every key length estimator and report how often
+ * the key length and the key are found, how much of the plaintext is
+ * recovered, how long it took and how much scratch memory was needed. This
+ * tells which estimator is the cheapest to reach a given accuracy for each
+ * message size.
+ */
+
+
+#ifndef BENCH_VERSION
+# define BENCH_VERSION "unknown"
+#endif
+
+
+enum option_id {
+	OPT_SEED = 256,
+	OPT_LAST
+};
+
+
+static const struct goh_option opt_desc[] = {
+	{"sizes", 's', GOH_ARG_REQUIRED, 's',
+		"Comma separated list of text sizes in bytes. "
+		"Default to 50,100,200,500,1000,2000,5000."},
+	{"key-lengths", 'k', GOH_ARG_REQUIRED, 'k',
+		"Comma separated list of key lengths. Default to 3,5,8,13."},
+	{"estimators", 'e', GOH_ARG_REQUIRED, 'e',
+		"Comma separated list of key length estimators. "
+		"Default to all of them."},
+	{"trials", 'n', GOH_ARG_REQUIRED, 'n',
+		"Number of texts for every combination. Default to 20."},
+	{"format", 'f', GOH_ARG_REQUIRED, 'f',
+		"Output format, csv or json. Default to csv."},
+	{"output", 'o', GOH_ARG_REQUIRED, 'o',
+		"Output file. May be - for stdout. Default to stdout."},
+	{"seed", '\0', GOH_ARG_REQUIRED, OPT_SEED,
+		"Seed of the random generator. Default to 1."}
+};
+
+
+/* Outcome of all the trials of one combination. */
+struct result {
+	enum ck_estimator est;
+	size_t size;
+	size_t klen;
+	size_t trials;
+	size_t length_ok;
+	size_t key_ok;
+	double chars_ok;
+	double seconds;
+	size_t peak;
+};
+
+
+struct harness {
+	struct driver_report report;
+	struct synth_model model;
+	struct synth_rng rng;
+	struct charset cs;
+};
+
+
+
+static void report(struct harness *h, const struct result *r) {
+	double lrate = (double)r->length_ok / r->trials;
+	double krate = (double)r->key_ok / r->trials;
+	double crate = r->chars_ok / r->trials;
+	double us = r->seconds / r->trials * 1e6;
+	const char *name = ck_estimator_name(r->est);
+	FILE *out = h->report.out;
+
+	driver_result(&h->report, "version,estimator,size,keylen,trials,"
+	              "length_rate,key_rate,char_accuracy,mean_us,"
+	              "peak_bytes");
+
+	if (h->report.format == DRIVER_CSV) {
+		fprintf(out, "%s,%s,%lu,%lu,%lu,%.3f,%.3f,%.4f,%.1f,%lu\n",
+		        BENCH_VERSION, name, (unsigned long)r->size,
+		        (unsigned long)r->klen, (unsigned long)r->trials,
+		        lrate, krate, crate, us, (unsigned long)r->peak);
+	} else {
+		fprintf(out, "  {\"estimator\": \"%s\", \"size\": %lu, "
+		        "\"keylen\": %lu, \"trials\": %lu, "
+		        "\"length_rate\": %.3f, \"key_rate\": %.3f, "
+		        "\"char_accuracy\": %.4f, \"mean_us\": %.1f, "
+		        "\"peak_bytes\": %lu}",
+		        name, (unsigned long)r->size, (unsigned long)r->klen,
+		        (unsigned long)r->trials, lrate, krate, crate, us,
+		        (unsigned long)r->peak);
+	}
+}
+
+
+
+/* Return whether two keys are the same up to equivalent characters. */
+static int same_key(const struct charset *cs, const char *k1, const char *k2) {
+	for (; *k1 != '\0' && *k2 != '\0'; k1++, k2++) {
+		if (!cs_equiv(cs, *k1, *k2))
+			return 0;
+	}
+
+	return *k1 == *k2;
+}
+
+
+
+/* Crack one ciphertext and accumulate the outcome into r. */
+static void trial(struct harness *h, struct cracker *ck, struct result *r,
+                  const char *plain, char *text) {
+	struct fs_ctx s;
+	char key[256];
+	size_t i, good = 0, total = 0;
+	double t;
+	int err;
+
+	synth_key(&h->rng, &h->cs, key, r->klen);
+
+	memcpy(text, plain, r->size);
+	check(fs_init(&s, text, r->size, &h->cs, NULL), "fs_init");
+	check(vig_encrypt(&s, key), "vig_encrypt");
+	fs_fini(&s);
+
+	ck_reset(ck);
+	ck->arena.peak = 0;
+
+	/* The filtering is part of the cost of a crack. */
+	t = driver_now();
+	check(fs_init(&s, text, r->size, &h->cs, &ck->arena), "fs_init");
+	ck_set_text(ck, &s);
+	err = ck_crack(ck);
+	r->seconds += driver_now() - t;
+
+	if (ck->arena.peak > r->peak)
+		r->peak = ck->arena.peak;
+
+	if (err == ERR_TOOSHORT)
+		return;
+	check(err, "ck_crack");
+
+	if (ck->klen == r->klen)
+		r->length_ok++;
+
+	if (same_key(&h->cs, ck->key, key))
+		r->key_ok++;
+
+	/* The other characters are left as is by the cipher, they'd count
+	 * as recovered whatever the key. */
+	check(vig_decrypt(&s, ck->key), "vig_decrypt");
+	for (i = 0; i < r->size; i++) {
+		if (!cs_belong(&h->cs, plain[i]))
+			continue;
+
+		total++;
+		if (text[i] == plain[i])
+			good++;
+	}
+
+	if (total > 0)
+		r->chars_ok += (double)good / total;
+}
+
+
+
+int main(int argc, char **argv) {
+	struct goh_state st;
+	struct harness h;
+	struct cracker ck;
+	int opt;
+	size_t sizes[64] = {50, 100, 200, 500, 1000, 2000, 5000};
+	size_t nsizes = 7;
+	size_t klens[64] = {3, 5, 8, 13};
+	size_t nklens = 4;
+	enum ck_estimator ests[CK_EST_LAST];
+	enum ck_estimator est;
+	size_t nests = 0;
+	size_t trials = 20;
+	unsigned long seed = 1;
+	const char *filenameout = "-";
+	char *estlist = NULL;
+	char *name;
+	size_t i, j, k, n;
+
+	memset(&h, 0, sizeof(h));
+
+	goh_init(&st, opt_desc, ARRAY_LENGTH(opt_desc), argc, argv, 1);
+	st.usagehelp = "[options]\n";
+
+	while ((opt = goh_nextoption(&st)) >= 0) {
+		switch (opt) {
+		case 's':
+			nsizes = driver_parse_list(st.argval, sizes,
+			                    ARRAY_LENGTH(sizes));
+			break;
+
+		case 'k':
+			nklens = driver_parse_list(st.argval, klens,
+			                    ARRAY_LENGTH(klens));
+			break;
+
+		case 'e':
+			estlist = st.argval;
+			break;
+
+		case 'n':
+			trials = atoi(st.argval);
+			break;
+
+		case 'f':
+			driver_set_format(&h.report, st.argval);
+			break;
+
+		case 'o':
+			filenameout = st.argval;
+			break;
+
+		case OPT_SEED:
+			seed = strtoul(st.argval, NULL, 10);
+			break;
+
+		default:
+			custom_error("Unrecognized option (shouldn't happen)");
+			break;
+		}
+	}
+
+	if (st.argidx != argc)
+		custom_error("Useless argument %s", argv[st.argidx]);
+
+	goh_fini(&st);
+
+	if (trials == 0)
+		custom_error("The number of trials must be positive");
+
+	for (i = 0; i < nklens; i++) {
+		if (klens[i] == 0 || klens[i] > 255)
+			custom_error("Key lengths must be between 1 and 255");
+	}
+
+	if (estlist == NULL) {
+		for (i = 0; i < CK_EST_LAST; i++)
+			ests[nests++] = i;
+	} else {
+		for (name = strtok(estlist, ","); name != NULL;
+		     name = strtok(NULL, ",")) {
+			est = ck_estimator_from_name(name);
+			if (est == CK_EST_LAST)
+				custom_error("Unknown estimator %s", name);
+
+			for (i = 0; i < nests; i++) {
+				if (ests[i] == est)
+					custom_error("Estimator %s given twice",
+					             name);
+			}
+
+			if (nests == CK_EST_LAST)
+				custom_error("Too many estimators");
+
+			ests[nests++] = est;
+		}
+	}
+
+	driver_open(&h.report, filenameout);
+
+	check(cs_init(&h.cs), "Charset");
+	check(cs_add(&h.cs, CHARSET_UPPER), "Charset");
+	check(cs_add(&h.cs, CHARSET_LOWER), "Charset");
+
+	synth_train(&h.model);
+	ck_init(&ck, NULL);
+
+	for (i = 0; i < nests; i++) {
+		ck.estimator = ests[i];
+
+		/* Every estimator is given the same texts and keys. */
+		synth_seed(&h.rng, seed);
+
+		for (j = 0; j < nsizes; j++) {
+			char *plain, *text;
+
+			plain = malloc(sizes[j] + 1);
+			text = malloc(sizes[j] + 1);
+			if (plain == NULL || text == NULL)
+				system_error("malloc");
+
+			for (k = 0; k < nklens; k++) {
+				struct result r;
+
+				memset(&r, 0, sizeof(r));
+				r.est = ests[i];
+				r.size = sizes[j];
+				r.klen = klens[k];
+				r.trials = trials;
+
+				for (n = 0; n < trials; n++) {
+					synth_text(&h.model, &h.rng, plain,
+					           r.size);
+					trial(&h, &ck, &r, plain, text);
+				}
+
+				report(&h, &r);
+			}
+
+			free(text);
+			free(plain);
+		}
+	}
+
+
+	ck_fini(&ck);
+	cs_fini(&h.cs);
+
+	driver_close(&h.report, filenameout);
+
+	return EXIT_SUCCESS;
+}
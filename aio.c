@@ -0,0 +1,428 @@
+/* syscall() and the io_uring interface are Linux specific. */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef SYS_io_uring_setup
+# include <linux/io_uring.h>
+#endif
+
+#include "error.h"
+#include "aio.h"
+
+
+
+/* A single read or write of the uring backend is limited to 32 bits. */
+#define MAX_RW_LEN (1UL << 30)
+
+
+
+/*
+ * Synchronous backend.
+ */
+
+static long sync_exec(struct aio_req *r) {
+	struct pollfd pfd;
+	long res;
+
+	switch (r->op) {
+	case AIO_OPEN_READ:
+		res = open(r->path, O_RDONLY);
+		break;
+
+	case AIO_OPEN_WRITE:
+		res = open(r->path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		break;
+
+	case AIO_READ:
+		res = pread(r->fd, r->buf, r->len, r->off);
+		break;
+
+	case AIO_WRITE:
+		res = pwrite(r->fd, r->buf, r->len, r->off);
+		break;
+
+	case AIO_CLOSE:
+		res = close(r->fd);
+		break;
+
+	case AIO_POLL:
+		pfd.fd = r->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		res = poll(&pfd, 1, -1);
+		if (res >= 0)
+			res = pfd.revents;
+		break;
+
+	default:
+		errno = EINVAL;
+		res = -1;
+		break;
+	}
+
+	if (res < 0)
+		res = -errno;
+
+	return res;
+}
+
+
+
+static int sync_wait(struct aio *a, struct aio_req **rp) {
+	struct aio_req *r;
+	unsigned i;
+
+	/* A poll would block until some other thread does something, so only
+	 * do it when there's nothing else to do. */
+	for (i = 0; i < a->inflight; i++) {
+		if (a->pending[i]->op != AIO_POLL)
+			break;
+	}
+
+	if (i == a->inflight)
+		i = 0;
+
+	r = a->pending[i];
+	memmove(&a->pending[i], &a->pending[i + 1],
+	        (a->inflight - i - 1) * sizeof(*a->pending));
+	a->inflight--;
+
+	do {
+		r->res = sync_exec(r);
+	} while (r->res == -EINTR);
+
+	*rp = r;
+	return ERR_OK;
+}
+
+
+
+/*
+ * io_uring backend.
+ * There is no liburing dependency, the rings are handled directly.
+ */
+
+#ifdef SYS_io_uring_setup
+
+static int uring_init(struct aio *a) {
+	struct io_uring_params p;
+	char *sq, *cq;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(SYS_io_uring_setup, a->depth, &p);
+	if (fd < 0)
+		return ERR_IO;
+
+	a->ring_fd = fd;
+	a->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	a->cq_ring_size = p.cq_off.cqes +
+	                  p.cq_entries * sizeof(struct io_uring_cqe);
+	a->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	a->sq_ring = mmap(NULL, a->sq_ring_size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED, fd, IORING_OFF_SQ_RING);
+	if (a->sq_ring == MAP_FAILED)
+		goto err_sq;
+
+	a->cq_ring = mmap(NULL, a->cq_ring_size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED, fd, IORING_OFF_CQ_RING);
+	if (a->cq_ring == MAP_FAILED)
+		goto err_cq;
+
+	a->sqes = mmap(NULL, a->sqes_size, PROT_READ | PROT_WRITE,
+	               MAP_SHARED, fd, IORING_OFF_SQES);
+	if (a->sqes == MAP_FAILED)
+		goto err_sqes;
+
+	sq = a->sq_ring;
+	a->sq_head = (unsigned *)(sq + p.sq_off.head);
+	a->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	a->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	a->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+	cq = a->cq_ring;
+	a->cq_head = (unsigned *)(cq + p.cq_off.head);
+	a->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	a->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	a->cqes = cq + p.cq_off.cqes;
+
+	return ERR_OK;
+
+err_sqes:
+	munmap(a->cq_ring, a->cq_ring_size);
+err_cq:
+	munmap(a->sq_ring, a->sq_ring_size);
+err_sq:
+	close(fd);
+	return ERR_IO;
+}
+
+
+
+static void uring_fini(struct aio *a) {
+	munmap(a->sqes, a->sqes_size);
+	munmap(a->cq_ring, a->cq_ring_size);
+	munmap(a->sq_ring, a->sq_ring_size);
+	close(a->ring_fd);
+}
+
+
+
+static void uring_submit(struct aio *a, struct aio_req *r) {
+	struct io_uring_sqe *sqe;
+	unsigned tail, idx;
+	size_t len;
+
+	/* We're the only producer, nobody else moves the tail. */
+	tail = *a->sq_tail;
+	idx = tail & *a->sq_mask;
+	sqe = (struct io_uring_sqe *)a->sqes + idx;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = (unsigned long)r;
+	sqe->fd = r->fd;
+
+	len = r->len < MAX_RW_LEN ? r->len : MAX_RW_LEN;
+
+	switch (r->op) {
+	case AIO_OPEN_READ:
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (unsigned long)r->path;
+		sqe->open_flags = O_RDONLY;
+		break;
+
+	case AIO_OPEN_WRITE:
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (unsigned long)r->path;
+		sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+		sqe->len = 0666;
+		break;
+
+	case AIO_READ:
+		sqe->opcode = IORING_OP_READ;
+		sqe->addr = (unsigned long)r->buf;
+		sqe->len = len;
+		sqe->off = r->off;
+		break;
+
+	case AIO_WRITE:
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->addr = (unsigned long)r->buf;
+		sqe->len = len;
+		sqe->off = r->off;
+		break;
+
+	case AIO_CLOSE:
+		sqe->opcode = IORING_OP_CLOSE;
+		break;
+
+	case AIO_POLL:
+		sqe->opcode = IORING_OP_POLL_ADD;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		sqe->poll32_events = (POLLIN << 16) | (POLLIN >> 16);
+#else
+		sqe->poll32_events = POLLIN;
+#endif
+		break;
+	}
+
+	a->sq_array[idx] = idx;
+
+	/* The kernel must see the whole SQE before the new tail. */
+	__atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	a->to_submit++;
+}
+
+
+
+static int uring_wait(struct aio *a, struct aio_req **rp) {
+	struct io_uring_cqe *cqe;
+	unsigned head, tail;
+	unsigned wait = 0;
+	int ret;
+
+	for (;;) {
+		head = *a->cq_head;
+		tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+
+		/* Submit what's pending even if a completion is available
+		 * so that the kernel can work on it in the meantime. */
+		if (head != tail && a->to_submit == 0)
+			break;
+
+		if (head != tail)
+			wait = 0;
+		else
+			wait = 1;
+
+		ret = syscall(SYS_io_uring_enter, a->ring_fd, a->to_submit,
+		              wait, wait ? IORING_ENTER_GETEVENTS : 0,
+		              NULL, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+
+		if (ret < 0)
+			return ERR_IO;
+
+		a->to_submit -= ret;
+	}
+
+	cqe = (struct io_uring_cqe *)a->cqes + (head & *a->cq_mask);
+	*rp = (struct aio_req *)(unsigned long)cqe->user_data;
+	(*rp)->res = cqe->res;
+
+	/* Let the kernel reuse the CQE only once we're done reading it. */
+	__atomic_store_n(a->cq_head, head + 1, __ATOMIC_RELEASE);
+	a->inflight--;
+
+	return ERR_OK;
+}
+
+
+
+/* The kernel only reads the submission queue in io_uring_enter, the requests
+ * not submitted yet can be taken back. */
+static void uring_unsubmit(struct aio *a) {
+	__atomic_store_n(a->sq_tail, *a->sq_tail - a->to_submit,
+	                 __ATOMIC_RELEASE);
+	a->inflight -= a->to_submit;
+	a->to_submit = 0;
+}
+
+#else
+
+static int uring_init(struct aio *a) {
+	(void)a;
+	errno = ENOSYS;
+	return ERR_IO;
+}
+
+static void uring_fini(struct aio *a) {
+	(void)a;
+}
+
+static void uring_submit(struct aio *a, struct aio_req *r) {
+	(void)a;
+	(void)r;
+}
+
+static int uring_wait(struct aio *a, struct aio_req **rp) {
+	(void)a;
+	(void)rp;
+	return ERR_IO;
+}
+
+static void uring_unsubmit(struct aio *a) {
+	(void)a;
+}
+
+#endif
+
+
+
+int aio_init(struct aio *a, unsigned depth, int use_uring) {
+	memset(a, 0, sizeof(*a));
+	a->depth = depth;
+	a->ring_fd = -1;
+
+	if (depth == 0)
+		return ERR_INVAL;
+
+	if (use_uring && uring_init(a) == ERR_OK) {
+		a->backend = AIO_BACKEND_URING;
+		return ERR_OK;
+	}
+
+	a->backend = AIO_BACKEND_SYNC;
+	a->pending = malloc(depth * sizeof(*a->pending));
+	if (a->pending == NULL)
+		return ERR_NOMEM;
+
+	return ERR_OK;
+}
+
+
+
+void aio_fini(struct aio *a) {
+	if (a->backend == AIO_BACKEND_URING)
+		uring_fini(a);
+	else
+		free(a->pending);
+
+	memset(a, 0, sizeof(*a));
+}
+
+
+
+int aio_submit(struct aio *a, struct aio_req *r) {
+	if (a->inflight >= a->depth)
+		return ERR_INVAL;
+
+	if (a->backend == AIO_BACKEND_URING)
+		uring_submit(a, r);
+	else
+		a->pending[a->inflight] = r;
+
+	a->inflight++;
+	return ERR_OK;
+}
+
+
+
+int aio_wait(struct aio *a, struct aio_req **r) {
+	int err;
+
+	if (a->inflight == 0)
+		return ERR_INVAL;
+
+	if (a->backend == AIO_BACKEND_SYNC)
+		return sync_wait(a, r);
+
+	err = uring_wait(a, r);
+	if (err != ERR_OK)
+		return err;
+
+	/* Before Linux 5.6, io_uring knows polls but not the other
+	 * operations and fails them with EINVAL. */
+	if ((*r)->res == -EINVAL && (*r)->op != AIO_POLL) {
+		do {
+			(*r)->res = sync_exec(*r);
+		} while ((*r)->res == -EINTR);
+	}
+
+	return ERR_OK;
+}
+
+
+
+int aio_drain(struct aio *a) {
+	struct aio_req *r;
+	int err;
+
+	if (a->backend == AIO_BACKEND_SYNC) {
+		a->inflight = 0;
+		return ERR_OK;
+	}
+
+	uring_unsubmit(a);
+
+	while (a->inflight > 0) {
+		err = uring_wait(a, &r);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return ERR_OK;
+}
@@ -0,0 +1,101 @@
+#ifndef AIO_H__
+#define AIO_H__
+
+/*
+ * This module keep several file operations in flight at once.
+ * It uses io_uring when the kernel supports it. Otherwise, the operations are
+ * performed one at a time with the usual system calls when their completion
+ * is waited for. The same goes for the operations that io_uring doesn't
+ * support on older kernels.
+ */
+
+#include <sys/types.h>
+
+
+enum aio_op {
+	AIO_OPEN_READ,  /* Open path for reading. */
+	AIO_OPEN_WRITE, /* Open path for writing, create or truncate it. */
+	AIO_READ,       /* Read len bytes into buf at offset off. */
+	AIO_WRITE,      /* Write len bytes from buf at offset off. */
+	AIO_CLOSE,      /* Close fd. */
+	AIO_POLL        /* Wait for fd to be readable. */
+};
+
+enum aio_backend {
+	AIO_BACKEND_SYNC,
+	AIO_BACKEND_URING
+};
+
+
+struct aio_req {
+	enum aio_op op;
+	int fd;
+	const char *path;
+	char *buf;
+	size_t len;
+	off_t off;
+
+	/* Result of the operation, like the return value of the equivalent
+	 * system call, or -errno on error. */
+	long res;
+
+	/* For the caller to find its data back. */
+	void *data;
+};
+
+
+struct aio {
+	enum aio_backend backend;
+	unsigned depth;
+
+	/* Requests submitted and not yet completed. */
+	unsigned inflight;
+
+	/* Sync backend: the pending requests, in submission order. */
+	struct aio_req **pending;
+
+	/* io_uring backend. */
+	int ring_fd;
+	unsigned to_submit;
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	void *sqes;
+	size_t sqes_size;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	void *cqes;
+};
+
+
+
+/*
+ * Initialize an aio context able to hold depth requests in flight.
+ * io_uring is only tried if use_uring is not 0.
+ */
+int aio_init(struct aio *a, unsigned depth, int use_uring);
+
+void aio_fini(struct aio *a);
+
+/*
+ * Queue a request. It must stay valid until aio_wait returns it.
+ * Return ERR_INVAL if depth requests are already in flight.
+ */
+int aio_submit(struct aio *a, struct aio_req *r);
+
+/*
+ * Wait for a request to complete and return it in *r.
+ * Return ERR_INVAL if no request is in flight.
+ */
+int aio_wait(struct aio *a, struct aio_req **r);
+
+/*
+ * Give up on the requests in flight. Those not started yet are dropped, and
+ * those the kernel is working on are waited for, so that their buffers can be
+ * freed. A poll must be made to complete by the caller, or this never returns.
+ * Return ERR_IO if the wait failed, the buffers must then be kept.
+ */
+int aio_drain(struct aio *a);
+
+#endif
@@ -0,0 +1,169 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+
+
+/* Every allocation is aligned on the size of this union. */
+union arena_align {
+	long l;
+	double d;
+	long double ld;
+	void *p;
+	void (*f)(void);
+};
+
+#define ALIGN (sizeof(union arena_align))
+#define ALIGN_UP(n) (((n) + ALIGN - 1) / ALIGN * ALIGN)
+
+
+
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+
+	/* Make sure the data right after the header is aligned. */
+	union arena_align data[1];
+};
+
+#define BLOCK_HEADER (offsetof(struct arena_block, data))
+
+
+
+void arena_init(struct arena *a, size_t blocksize) {
+	memset(a, 0, sizeof(*a));
+
+	if (blocksize == 0)
+		blocksize = ARENA_BLOCK_SIZE;
+
+	a->blocksize = blocksize;
+}
+
+
+
+void arena_fini(struct arena *a) {
+	struct arena_block *b, *next;
+
+	for (b = a->first; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+
+	memset(a, 0, sizeof(*a));
+}
+
+
+
+static struct arena_block *new_block(size_t size) {
+	struct arena_block *b;
+
+	if (size > (size_t)-1 - BLOCK_HEADER)
+		return NULL;
+
+	b = malloc(BLOCK_HEADER + size);
+	if (b == NULL)
+		return NULL;
+
+	b->next = NULL;
+	b->size = size;
+	b->used = 0;
+
+	return b;
+}
+
+
+
+/* Find or allocate a free block of at least size bytes after a->cur. */
+static struct arena_block *next_block(struct arena *a, size_t size) {
+	struct arena_block *b;
+	struct arena_block *prev = a->cur;
+
+	/* Look for a block big enough among the ones after cur. */
+	for (b = prev != NULL ? prev->next : a->first; b != NULL; b = b->next) {
+		if (b->size >= size)
+			break;
+		prev = b;
+	}
+
+	if (b == NULL) {
+		b = new_block(size > a->blocksize ? size : a->blocksize);
+		if (b == NULL)
+			return NULL;
+
+		if (prev == NULL)
+			a->first = b;
+		else
+			prev->next = b;
+	}
+
+	/* Move the block right after cur so that the ones we skipped can
+	 * still be used later. */
+	if (a->cur != NULL && a->cur->next != b) {
+		prev->next = b->next;
+		b->next = a->cur->next;
+		a->cur->next = b;
+	} else if (a->cur == NULL && a->first != b) {
+		prev->next = b->next;
+		b->next = a->first;
+		a->first = b;
+	}
+
+	return b;
+}
+
+
+
+void *arena_alloc(struct arena *a, size_t size) {
+	struct arena_block *b;
+	void *p;
+
+	if (a == NULL)
+		return malloc(size);
+
+	if (size > (size_t)-1 - ALIGN)
+		return NULL;
+
+	size = ALIGN_UP(size);
+	b = a->cur;
+
+	if (b == NULL || b->size - b->used < size) {
+		b = next_block(a, size);
+		if (b == NULL)
+			return NULL;
+
+		a->cur = b;
+	}
+
+	p = (char *)b->data + b->used;
+	b->used += size;
+
+	a->nallocs++;
+	a->allocated += size;
+	a->used += size;
+	if (a->used > a->peak)
+		a->peak = a->used;
+
+	return p;
+}
+
+
+
+void arena_free(struct arena *a, void *ptr) {
+	if (a == NULL)
+		free(ptr);
+}
+
+
+
+void arena_reset(struct arena *a) {
+	struct arena_block *b;
+
+	for (b = a->first; b != NULL; b = b->next)
+		b->used = 0;
+
+	a->cur = NULL;
+	a->used = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef ARENA_H__
+#define ARENA_H__
+
+/*
+ * This module implement a bump allocator.
+ * Memory is taken from big blocks and is never freed individually. Instead,
+ * the whole arena is reset at once and its blocks are reused for the next
+ * allocations. This is intended for the scratch memory of a crack that would
+ * otherwise be malloc'ed and freed again for every message.
+ *
+ * Every function taking a struct arena * accept NULL, in which case it just
+ * falls back to malloc and free.
+ */
+
+#include <sys/types.h>
+
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+
+struct arena_block;
+
+struct arena {
+	/* Blocks are never freed before arena_fini. cur is the one being
+	 * filled, the ones after it are free for use. */
+	struct arena_block *first;
+	struct arena_block *cur;
+	size_t blocksize;
+
+	/* Bytes handed out since the last reset and the most there has ever
+	 * been at once. */
+	size_t used;
+	size_t peak;
+
+	/* Number of allocations and bytes allocated since arena_init. */
+	size_t nallocs;
+	size_t allocated;
+};
+
+
+
+/* Initialize an empty arena. blocksize may be 0 to use the default. */
+void arena_init(struct arena *a, size_t blocksize);
+
+/* Free all the memory owned by the arena. */
+void arena_fini(struct arena *a);
+
+/* Allocate size bytes suitably aligned for any type. Return NULL on error. */
+void *arena_alloc(struct arena *a, size_t size);
+
+/* Only free the memory when a is NULL. */
+void arena_free(struct arena *a, void *ptr);
+
+/* Make all the memory of the arena available again. */
+void arena_reset(struct arena *a);
+
+#endif
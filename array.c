@@ -2,48 +2,64 @@
 #include <string.h>
 #include <assert.h>
 
-#include "misc.h"
+#include "error.h"
 #include "array.h"
 
 
-void *array_alloc(size_t array_mem, size_t elemsize) {
-	void *array;
+int array_alloc(void **array, size_t *array_mem, size_t *array_size,
+                size_t mem, size_t elemsize) {
+	void *p;
 
-	assert(array_mem > 0);
+	assert(mem > 0);
 
-	/* TODO: check for integer overflow */
-	array = malloc(array_mem * elemsize);
-	if (array == NULL)
-		system_error("array malloc");
+	if (mem > (size_t)-1 / elemsize)
+		return ERR_NOMEM;
 
-	return array;
+	p = malloc(mem * elemsize);
+	if (p == NULL)
+		return ERR_NOMEM;
+
+	*array = p;
+	*array_mem = mem;
+	*array_size = 0;
+	return ERR_OK;
 }
 
 
 
-void *array_grow(void *array, size_t *array_mem, size_t elemsize) {
-	*array_mem *= 2;
-	array = realloc(array, *array_mem * elemsize);
-	if (array == NULL)
-		system_error("array realloc");
+int array_grow(void **array, size_t *array_mem, size_t elemsize) {
+	size_t mem = *array_mem * 2;
+	void *p;
+
+	if (mem < *array_mem || mem > (size_t)-1 / elemsize)
+		return ERR_NOMEM;
+
+	p = realloc(*array, mem * elemsize);
+	if (p == NULL)
+		return ERR_NOMEM;
 
-	return array;
+	*array = p;
+	*array_mem = mem;
+	return ERR_OK;
 }
 
 
 
-void *array_append(void *array, size_t *array_mem, size_t elemsize,
-                   size_t *array_size, void *elem) {
+int array_append(void **array, size_t *array_mem, size_t elemsize,
+                 size_t *array_size, const void *elem) {
 	char *carray;
 
-	if (*array_size >= *array_mem)
-		array = array_grow(array, array_mem, elemsize);
+	if (*array_size >= *array_mem) {
+		int err = array_grow(array, array_mem, elemsize);
+		if (err != ERR_OK)
+			return err;
+	}
 
-	carray = array;
+	carray = *array;
 	memcpy(carray + *array_size * elemsize, elem, elemsize);
 	(*array_size)++;
 
-	return array;
+	return ERR_OK;
 }
 
 
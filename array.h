@@ -3,24 +3,26 @@
 
 #include <sys/types.h>
 
+/*
+ * All the macros that may allocate memory evaluate to an error code from
+ * error.h. On failure, the array is left untouched.
+ */
+
 #define ARRAY_DECL(type, name) \
 	type *name;             \
 	size_t name ## _mem;   \
 	size_t name ## _size
 
-#define ARRAY_ALLOC(name, size)                                      \
-	do {                                                         \
-		name ## _mem = (size);                               \
-		name ## _size = 0;                                   \
-		name = array_alloc((name ## _mem), sizeof(*(name))); \
-	} while (0)
+#define ARRAY_ALLOC(name, size)                                       \
+	array_alloc((void **)&(name), &(name ## _mem), &(name ## _size), \
+	            (size), sizeof(*(name)))
 
 #define ARRAY_GROW(name) \
-	name = array_grow((name), &(name ## _mem), sizeof(*(name)))
+	array_grow((void **)&(name), &(name ## _mem), sizeof(*(name)))
 
-#define ARRAY_APPEND(name, elem)                                      \
-	name = array_append((name), &(name ## _mem), sizeof(*(name)), \
-	                   &(name ## _size), &(elem))
+#define ARRAY_APPEND(name, elem)                                           \
+	array_append((void **)&(name), &(name ## _mem), sizeof(*(name)),   \
+	             &(name ## _size), &(elem))
 
 #define ARRAY_FREE(name)             \
 	do {                         \
@@ -30,15 +32,16 @@
 		(name ## _size) = 0; \
 	} while (0)
 
-/* Allocate a new array of array_mem elements of elemsize bytes. */
-void *array_alloc(size_t array_mem, size_t elemsize);
+/* Allocate a new empty array of mem elements of elemsize bytes. */
+int array_alloc(void **array, size_t *array_mem, size_t *array_size,
+                size_t mem, size_t elemsize);
 
 /* Double the buffer size. */
-void *array_grow(void *array, size_t *array_mem, size_t elemsize);
+int array_grow(void **array, size_t *array_mem, size_t elemsize);
 
 /* Append an element to an array. */
-void *array_append(void *array, size_t *array_mem, size_t elemsize,
-                   size_t *array_size, void *elem);
+int array_append(void **array, size_t *array_mem, size_t elemsize,
+                 size_t *array_size, const void *elem);
 
 void array_free(void *array);
 
@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "error.h"
+#include "aio.h"
+#include "trace.h"
+#include "batch.h"
+
+
+
+/* What the pending request of an item is about. */
+enum item_state {
+	ST_OPEN_IN,
+	ST_READ,
+	ST_CLOSE_IN,
+	ST_WORK,
+	ST_OPEN_OUT,
+	ST_WRITE,
+	ST_CLOSE_OUT,
+	ST_DONE
+};
+
+
+struct batch {
+	const struct batch_config *cfg;
+	struct aio aio;
+
+	/* Number of items started and finished. */
+	size_t started;
+	size_t finished;
+
+	/* Items loaded and waiting for a worker, and items processed and
+	 * waiting to be written. Protected by lock. */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct batch_item *todo_head;
+	struct batch_item *todo_tail;
+	struct batch_item *done;
+	int stop;
+
+	/* The workers write to this pipe to wake up the I/O loop. */
+	int wake[2];
+	char wake_buf[64];
+	struct aio_req wake_req;
+};
+
+struct worker {
+	struct batch *b;
+	size_t idx;
+	pthread_t thread;
+};
+
+
+
+static void *worker_main(void *arg) {
+	struct worker *w = arg;
+	struct batch *b = w->b;
+	struct batch_item *it;
+	struct trace_buf *tb = trace_thread(b->cfg->trace, "batch worker");
+	ssize_t nw;
+	double t;
+
+	for (;;) {
+		pthread_mutex_lock(&b->lock);
+		while (!b->stop && b->todo_head == NULL)
+			pthread_cond_wait(&b->cond, &b->lock);
+
+		it = b->todo_head;
+		if (it == NULL) {
+			pthread_mutex_unlock(&b->lock);
+			return NULL;
+		}
+
+		b->todo_head = it->next;
+		if (b->todo_head == NULL)
+			b->todo_tail = NULL;
+		pthread_mutex_unlock(&b->lock);
+
+		it->trace = tb;
+		t = trace_begin(tb);
+		it->err = b->cfg->work(b->cfg->arg, w->idx, it);
+		trace_end(tb, t, "job", it->in, it->len);
+		it->trace = NULL;
+
+		pthread_mutex_lock(&b->lock);
+		it->next = b->done;
+		b->done = it;
+		pthread_mutex_unlock(&b->lock);
+
+		/* The pipe is non-blocking, if it's full the loop will wake up
+		 * anyway. */
+		nw = write(b->wake[1], "", 1);
+		(void)nw;
+	}
+}
+
+
+
+static int submit(struct batch *b, struct batch_item *it, enum aio_op op) {
+	struct aio_req *r = &it->req;
+
+	r->op = op;
+	r->fd = it->fd;
+	r->data = it;
+
+	if (op == AIO_OPEN_READ)
+		r->path = it->in;
+	else if (op == AIO_OPEN_WRITE)
+		r->path = it->out;
+
+	if (op == AIO_READ || op == AIO_WRITE) {
+		r->buf = it->data + it->done;
+		r->len = it->len - it->done;
+		r->off = it->done;
+	}
+
+	return aio_submit(&b->aio, r);
+}
+
+
+
+static void finish(struct batch *b, struct batch_item *it) {
+	free(it->data);
+	it->data = NULL;
+	it->state = ST_DONE;
+	b->finished++;
+}
+
+
+
+/* Record an I/O error and close the file if it was opened. */
+static int fail(struct batch *b, struct batch_item *it, long res,
+                enum item_state close_state) {
+	if (it->err == ERR_OK) {
+		it->err = ERR_IO;
+		it->errno_value = -res;
+	}
+
+	if (it->fd == -1) {
+		finish(b, it);
+		return ERR_OK;
+	}
+
+	it->state = close_state;
+	return submit(b, it, AIO_CLOSE);
+}
+
+
+
+static int start_item(struct batch *b, struct batch_item *it) {
+	it->err = ERR_OK;
+	it->errno_value = 0;
+	it->data = NULL;
+	it->len = 0;
+	it->done = 0;
+	it->fd = -1;
+	it->state = ST_OPEN_IN;
+
+	return submit(b, it, AIO_OPEN_READ);
+}
+
+
+
+/* The file is loaded, give it to the workers. */
+static void queue_work(struct batch *b, struct batch_item *it) {
+	it->state = ST_WORK;
+	it->next = NULL;
+
+	pthread_mutex_lock(&b->lock);
+	if (b->todo_tail == NULL)
+		b->todo_head = it;
+	else
+		b->todo_tail->next = it;
+	b->todo_tail = it;
+	pthread_cond_signal(&b->cond);
+	pthread_mutex_unlock(&b->lock);
+}
+
+
+
+/* A worker is done with the item, write it out. */
+static int item_processed(struct batch *b, struct batch_item *it) {
+	if (it->err != ERR_OK || it->out == NULL) {
+		finish(b, it);
+		return ERR_OK;
+	}
+
+	it->fd = -1;
+	it->done = 0;
+	it->state = ST_OPEN_OUT;
+	return submit(b, it, AIO_OPEN_WRITE);
+}
+
+
+
+/* Move the item to its next state after its request completed. */
+static int item_step(struct batch *b, struct batch_item *it) {
+	long res = it->req.res;
+	struct stat st;
+
+	switch (it->state) {
+	case ST_OPEN_IN:
+		if (res < 0)
+			return fail(b, it, res, ST_CLOSE_IN);
+
+		it->fd = res;
+		if (fstat(it->fd, &st) == -1)
+			return fail(b, it, -errno, ST_CLOSE_IN);
+
+		it->len = st.st_size;
+		it->data = malloc(it->len > 0 ? it->len : 1);
+		if (it->data == NULL)
+			return fail(b, it, -ENOMEM, ST_CLOSE_IN);
+
+		it->state = it->len > 0 ? ST_READ : ST_CLOSE_IN;
+		return submit(b, it, it->len > 0 ? AIO_READ : AIO_CLOSE);
+
+	case ST_READ:
+		if (res < 0)
+			return fail(b, it, res, ST_CLOSE_IN);
+
+		/* The file shrank since fstat. */
+		if (res == 0)
+			it->len = it->done;
+
+		it->done += res;
+		if (it->done < it->len)
+			return submit(b, it, AIO_READ);
+
+		it->state = ST_CLOSE_IN;
+		return submit(b, it, AIO_CLOSE);
+
+	case ST_CLOSE_IN:
+		it->fd = -1;
+		if (it->err != ERR_OK) {
+			finish(b, it);
+			return ERR_OK;
+		}
+
+		queue_work(b, it);
+		return ERR_OK;
+
+	case ST_OPEN_OUT:
+		if (res < 0)
+			return fail(b, it, res, ST_CLOSE_OUT);
+
+		it->fd = res;
+		it->state = it->len > 0 ? ST_WRITE : ST_CLOSE_OUT;
+		return submit(b, it, it->len > 0 ? AIO_WRITE : AIO_CLOSE);
+
+	case ST_WRITE:
+		if (res < 0)
+			return fail(b, it, res, ST_CLOSE_OUT);
+
+		it->done += res;
+		if (it->done < it->len)
+			return submit(b, it, AIO_WRITE);
+
+		it->state = ST_CLOSE_OUT;
+		return submit(b, it, AIO_CLOSE);
+
+	case ST_CLOSE_OUT:
+		it->fd = -1;
+		if (res < 0 && it->err == ERR_OK) {
+			it->err = ERR_IO;
+			it->errno_value = -res;
+		}
+
+		finish(b, it);
+		return ERR_OK;
+
+	default:
+		return ERR_INVAL;
+	}
+}
+
+
+
+/* Some workers are done. Empty the pipe and take their items. */
+static int wake_up(struct batch *b) {
+	struct batch_item *it, *next;
+	int err;
+
+	while (read(b->wake[0], b->wake_buf, sizeof(b->wake_buf)) > 0)
+		continue;
+
+	err = aio_submit(&b->aio, &b->wake_req);
+	if (err != ERR_OK)
+		return err;
+
+	pthread_mutex_lock(&b->lock);
+	it = b->done;
+	b->done = NULL;
+	pthread_mutex_unlock(&b->lock);
+
+	for (; it != NULL; it = next) {
+		next = it->next;
+		err = item_processed(b, it);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return ERR_OK;
+}
+
+
+
+static int io_loop(struct batch *b, struct batch_item *items, size_t n) {
+	size_t active;
+	struct aio_req *r;
+	struct trace_buf *tb = trace_thread(b->cfg->trace, "batch io");
+	double t;
+	int err;
+
+	err = aio_submit(&b->aio, &b->wake_req);
+	if (err != ERR_OK)
+		return err;
+
+	while (b->finished < n) {
+		/* Keep as many files in flight as allowed. */
+		active = b->started - b->finished;
+		while (active < b->cfg->depth && b->started < n) {
+			err = start_item(b, &items[b->started]);
+			if (err != ERR_OK)
+				return err;
+
+			b->started++;
+			active++;
+		}
+
+		t = trace_begin(tb);
+		err = aio_wait(&b->aio, &r);
+		trace_end(tb, t, "io wait", NULL, -1);
+		if (err != ERR_OK)
+			return err;
+
+		if (r == &b->wake_req)
+			err = wake_up(b);
+		else
+			err = item_step(b, r->data);
+
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return ERR_OK;
+}
+
+
+
+void batch_config_init(struct batch_config *cfg, batch_work_fn *work,
+                       void *arg, size_t nthreads) {
+	long ncpus;
+
+	if (nthreads == 0) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->depth = BATCH_DEFAULT_DEPTH;
+	cfg->nthreads = nthreads;
+	cfg->use_uring = 1;
+	cfg->work = work;
+	cfg->arg = arg;
+}
+
+
+
+int batch_run(const struct batch_config *cfg, struct batch_item *items,
+              size_t n) {
+	struct batch b;
+	struct worker *workers;
+	size_t nstarted = 0;
+	size_t i;
+	ssize_t nw;
+	int drained = 1;
+	int err;
+
+	if (cfg->depth == 0 || cfg->nthreads == 0)
+		return ERR_INVAL;
+
+	memset(&b, 0, sizeof(b));
+	b.cfg = cfg;
+
+	workers = malloc(cfg->nthreads * sizeof(*workers));
+	if (workers == NULL)
+		return ERR_NOMEM;
+
+	/* One request per item in flight, plus the wake up poll. */
+	err = aio_init(&b.aio, cfg->depth + 1, cfg->use_uring);
+	if (err != ERR_OK)
+		goto err_aio;
+
+	if (pipe(b.wake) == -1) {
+		err = ERR_IO;
+		goto err_pipe;
+	}
+
+	fcntl(b.wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(b.wake[1], F_SETFL, O_NONBLOCK);
+
+	b.wake_req.op = AIO_POLL;
+	b.wake_req.fd = b.wake[0];
+
+	pthread_mutex_init(&b.lock, NULL);
+	pthread_cond_init(&b.cond, NULL);
+
+	for (nstarted = 0; nstarted < cfg->nthreads; nstarted++) {
+		workers[nstarted].b = &b;
+		workers[nstarted].idx = nstarted;
+		if (pthread_create(&workers[nstarted].thread, NULL,
+		                   worker_main, &workers[nstarted]) != 0)
+			break;
+	}
+
+	if (nstarted == 0)
+		err = ERR_THREAD;
+	else
+		err = io_loop(&b, items, n);
+
+	pthread_mutex_lock(&b.lock);
+	b.stop = 1;
+	pthread_cond_broadcast(&b.cond);
+	pthread_mutex_unlock(&b.lock);
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	/* On error, the kernel may still be reading into the data of some
+	 * items. The wake up poll has to complete for them to be waited for.
+	 * If that fails, leaking the data is the only safe thing to do. */
+	if (err != ERR_OK) {
+		nw = write(b.wake[1], "", 1);
+		(void)nw;
+		drained = aio_drain(&b.aio) == ERR_OK;
+	}
+
+	/* Some items may still hold data. */
+	for (i = 0; i < b.started && drained; i++) {
+		free(items[i].data);
+		items[i].data = NULL;
+	}
+
+	pthread_cond_destroy(&b.cond);
+	pthread_mutex_destroy(&b.lock);
+	close(b.wake[0]);
+	close(b.wake[1]);
+err_pipe:
+	aio_fini(&b.aio);
+err_aio:
+	free(workers);
+	return err;
+}
@@ -0,0 +1,82 @@
+#ifndef BATCH_H__
+#define BATCH_H__
+
+/*
+ * This module process many files at once.
+ * Every file is loaded, handed to a pool of worker threads and written out.
+ * The loading and writing are done asynchronously with the aio module so
+ * that many files are read and written while the workers process the ones
+ * already loaded.
+ */
+
+#include <sys/types.h>
+
+#include "aio.h"
+#include "trace.h"
+
+
+#define BATCH_DEFAULT_DEPTH 64
+
+
+struct batch_item {
+	/* Filled by the caller. out may be NULL not to write anything. */
+	const char *in;
+	const char *out;
+
+	/* Content of the file, available to the work function. */
+	char *data;
+	size_t len;
+
+	/* Free for the work function to store its results. */
+	void *result;
+
+	/* Trace buffer of the worker thread processing the item, or NULL. */
+	struct trace_buf *trace;
+
+	/* ERR_OK or the error that stopped the processing of this file.
+	 * errno_value is the errno of an ERR_IO. */
+	int err;
+	int errno_value;
+
+	/* Private to the batch module. */
+	int state;
+	int fd;
+	size_t done;
+	struct aio_req req;
+	struct batch_item *next;
+};
+
+/*
+ * Function processing a file in place. thread is the index of the worker
+ * thread calling it, to let it use per-thread data. The data may be modified
+ * but its length can't change. Return an error code.
+ */
+typedef int batch_work_fn(void *arg, size_t thread, struct batch_item *it);
+
+struct batch_config {
+	/* Maximum number of files being loaded, processed or written. */
+	unsigned depth;
+	size_t nthreads;
+	int use_uring;
+	batch_work_fn *work;
+	void *arg;
+
+	/* Trace the I/O loop and every job. May be NULL. */
+	struct trace *trace;
+};
+
+
+
+/* Fill cfg with the default values. nthreads may be 0 for one per CPU. */
+void batch_config_init(struct batch_config *cfg, batch_work_fn *work,
+                       void *arg, size_t nthreads);
+
+/*
+ * Process all the items. An error on a file is reported in its item and
+ * doesn't stop the others. The returned error code only tells about the
+ * batch itself.
+ */
+int batch_run(const struct batch_config *cfg, struct batch_item *items,
+              size_t n);
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "mfreq_analysis.h"
+#include "ngram.h"
+#include "arena.h"
+#include "deadline.h"
+#include "beam.h"
+
+
+
+/* A partial key of the beam, or a candidate to enter it. */
+struct beam_entry {
+	float score;
+
+	/* Entry of the previous step it extends and its key character. */
+	size_t parent;
+	unsigned char k;
+
+	/* Order of generation, to break the ties. */
+	size_t rank;
+};
+
+
+
+int beam_init(struct beam *bm, const struct mfreq *mfa, struct arena *arena) {
+	memset(bm, 0, sizeof(*bm));
+	bm->mfa = mfa;
+	bm->width = BEAM_DEFAULT_WIDTH;
+	bm->ncand = BEAM_DEFAULT_CAND;
+	bm->sample = BEAM_DEFAULT_SAMPLE;
+	bm->ntop = 1;
+	bm->arena = arena;
+
+	ngram_train_en(&bm->model_en);
+	bm->model = &bm->model_en;
+
+	if (mfa->charset->length != NGRAM_NSYM)
+		return ERR_CHARSET;
+
+	return ERR_OK;
+}
+
+
+
+void beam_fini(struct beam *bm) {
+	arena_free(bm->arena, bm->scores);
+	arena_free(bm->arena, bm->keys);
+	memset(bm, 0, sizeof(*bm));
+}
+
+
+
+const char *beam_key(const struct beam *bm, size_t i) {
+	return bm->keys + i * (bm->mfa->klen + 1);
+}
+
+
+
+static int entry_cmp(const void *pa, const void *pb) {
+	const struct beam_entry *a = pa, *b = pb;
+
+	if (a->score != b->score)
+		return a->score > b->score ? -1 : 1;
+
+	return a->rank < b->rank ? -1 : a->rank > b->rank;
+}
+
+
+
+int beam_search(struct beam *bm) {
+	const struct mfreq *mfa = bm->mfa;
+	const struct charset *cs = mfa->charset;
+	const size_t n = NGRAM_NSYM;
+	size_t klen = mfa->klen;
+	size_t ncand = bm->ncand < n ? bm->ncand : n;
+	size_t slen, size, nnext, t, i, j;
+	struct beam_entry *next = NULL;
+	unsigned char *ord = NULL, *keys = NULL, *nkeys = NULL, *tmpk;
+	size_t *count = NULL, *shifts = NULL;
+	float *tab = NULL;
+	int err = ERR_OK;
+
+	if (bm->width == 0 || bm->ncand == 0 || bm->sample == 0 ||
+	    bm->ntop == 0 || klen == 0)
+		return ERR_INVAL;
+
+	slen = mfa->str_len < bm->sample ? mfa->str_len : bm->sample;
+
+	ord = arena_alloc(bm->arena, slen + 1);
+	tab = arena_alloc(bm->arena, klen * n * n * sizeof(*tab));
+	count = arena_alloc(bm->arena, klen * n * n * sizeof(*count));
+	shifts = arena_alloc(bm->arena, ncand * sizeof(*shifts));
+	/* Room for the beam and all the entries extending it. */
+	next = arena_alloc(bm->arena, bm->width * (ncand + 1) *
+	                   sizeof(*next));
+	keys = arena_alloc(bm->arena, bm->width * ncand * klen);
+	nkeys = arena_alloc(bm->arena, bm->width * ncand * klen);
+	if (ord == NULL || tab == NULL || count == NULL || shifts == NULL ||
+	    next == NULL || keys == NULL || nkeys == NULL) {
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < slen; i++)
+		ord[i] = CS_TABLE_ORD(cs, mfa->str[i]);
+
+	ngram_pair_tables(bm->model, ord, slen, klen, tab, count);
+
+	/* The beam starts with the candidates of the first column. */
+	mfa_candidates(mfa, 0, ncand, shifts);
+	size = ncand < bm->width ? ncand : bm->width;
+	for (i = 0; i < size; i++) {
+		keys[i * klen] = (n - shifts[i]) % n;
+		next[i].score = 0;
+		next[i].parent = i;
+		next[i].rank = i;
+	}
+
+	for (t = 1; t < klen; t++) {
+		if (!bm->expired && deadline_passed(bm->deadline)) {
+			bm->expired = 1;
+			ncand = 1;
+		}
+
+		mfa_candidates(mfa, t, ncand, shifts);
+
+		/* Extend every partial key with every candidate. */
+		nnext = 0;
+		for (i = 0; i < size; i++) {
+			const unsigned char *key = keys + i * klen;
+			const float *row = tab + ((t - 1) * n + key[t - 1]) * n;
+			float base = next[i].score;
+
+			for (j = 0; j < ncand; j++) {
+				struct beam_entry *e = &next[size + nnext];
+
+				e->k = (n - shifts[j]) % n;
+				e->score = base + row[e->k];
+				e->parent = i;
+				e->rank = nnext++;
+			}
+		}
+
+		/* The new entries were appended after the current ones. */
+		memmove(next, next + size, nnext * sizeof(*next));
+		qsort(next, nnext, sizeof(*next), entry_cmp);
+		size = nnext < bm->width ? nnext : bm->width;
+
+		for (i = 0; i < size; i++) {
+			unsigned char *key = nkeys + i * klen;
+
+			memcpy(key, keys + next[i].parent * klen, t);
+			key[t] = next[i].k;
+			next[i].rank = i;
+		}
+
+		tmpk = keys;
+		keys = nkeys;
+		nkeys = tmpk;
+	}
+
+	/* Close the loop from the last column to the first one. */
+	for (i = 0; i < size; i++) {
+		const unsigned char *key = keys + i * klen;
+
+		next[i].score += tab[((klen - 1) * n + key[klen - 1]) * n +
+		                     key[0]];
+		next[i].parent = i;
+		next[i].rank = i;
+	}
+
+	qsort(next, size, sizeof(*next), entry_cmp);
+
+	arena_free(bm->arena, bm->scores);
+	arena_free(bm->arena, bm->keys);
+	bm->nkeys = size < bm->ntop ? size : bm->ntop;
+	bm->keys = arena_alloc(bm->arena, bm->nkeys * (klen + 1));
+	bm->scores = arena_alloc(bm->arena, bm->nkeys * sizeof(*bm->scores));
+	if (bm->keys == NULL || bm->scores == NULL) {
+		arena_free(bm->arena, bm->scores);
+		arena_free(bm->arena, bm->keys);
+		bm->keys = NULL;
+		bm->scores = NULL;
+		bm->nkeys = 0;
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < bm->nkeys; i++) {
+		const unsigned char *key = keys + next[i].parent * klen;
+		char *dst = bm->keys + i * (klen + 1);
+
+		for (j = 0; j < klen; j++)
+			dst[j] = cs_chr(cs, key[j]);
+		dst[klen] = '\0';
+		bm->scores[i] = next[i].score;
+	}
+
+out:
+	arena_free(bm->arena, nkeys);
+	arena_free(bm->arena, keys);
+	arena_free(bm->arena, next);
+	arena_free(bm->arena, shifts);
+	arena_free(bm->arena, count);
+	arena_free(bm->arena, tab);
+	arena_free(bm->arena, ord);
+	return err;
+}
@@ -0,0 +1,78 @@
+#ifndef BEAM_H__
+#define BEAM_H__
+
+/*
+ * This module refine the key found by the frequency analysis. The best shift
+ * of a column is often wrong on a short text, while the right one is only a
+ * bit behind. So the few best shifts of every column are kept, and the keys
+ * made of them are explored column after column, only keeping the most
+ * promising partial keys at every step: a beam search.
+ *
+ * A partial key is scored by the letter bigram log-likelihood of the sample
+ * decrypted with it, counting the bigrams whose both letters are decrypted by
+ * the key characters known so far. The full keys also count the bigrams
+ * between the last column and the first one.
+ */
+
+#include <sys/types.h>
+
+#include "mfreq_analysis.h"
+#include "ngram.h"
+#include "arena.h"
+
+
+#define BEAM_DEFAULT_WIDTH 64
+#define BEAM_DEFAULT_CAND 6
+#define BEAM_DEFAULT_SAMPLE 4096
+
+
+
+struct beam {
+	/* The frequency analysis giving the text, key length and shifts. */
+	const struct mfreq *mfa;
+
+	/* Settings, may be changed before beam_search. */
+	size_t width;
+	size_t ncand;
+	size_t sample;
+	size_t ntop;
+
+	/* Language model, model_en by default. */
+	const struct ngram *model;
+
+	/* The best keys found by beam_search, best first. Every key takes
+	 * mfa->klen + 1 bytes of keys and is nul-terminated. */
+	char *keys;
+	float *scores;
+	size_t nkeys;
+
+	struct arena *arena;
+	struct ngram model_en;
+
+	/* When to hurry, see deadline.h. 0 by default. Once it passed, the
+	 * partial keys are only extended with the best shift of the remaining
+	 * columns. */
+	double deadline;
+	int expired;
+};
+
+
+
+/*
+ * Initialize a struct beam to refine the results of mfa, which must have been
+ * analyzed. arena may be NULL to use malloc.
+ * Return ERR_CHARSET if the charset doesn't have the length of the model.
+ */
+int beam_init(struct beam *bm, const struct mfreq *mfa, struct arena *arena);
+
+/* Deinitialize a struct beam. */
+void beam_fini(struct beam *bm);
+
+/* Run the search. Return ERR_INVAL if a setting is 0. Set expired if the
+ * deadline passed before the end. */
+int beam_search(struct beam *bm);
+
+/* Return the i-th best key. */
+const char *beam_key(const struct beam *bm, size_t i);
+
+#endif
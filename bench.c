@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "getopthelp.h"
+#include "libunvigenere.h"
+#include "synth.h"
+#include "driver.h"
+#include "misc.h"
+
+
+/*
+ * Benchmark driver.
+ * Generate synthetic plaintexts for a grid of sizes, key lengths and charsets,
+ * encrypt them with random keys and time every stage separately. The results
+ * are printed as CSV or JSON so that they can be compared between versions.
+ */
+
+
+#ifndef BENCH_VERSION
+# define BENCH_VERSION "unknown"
+#endif
+
+
+enum option_id {
+	OPT_SEED = 256,
+	OPT_MAX_KASISKI,
+	OPT_LAST
+};
+
+
+static const struct goh_option opt_desc[] = {
+	{"sizes", 's', GOH_ARG_REQUIRED, 's',
+		"Comma separated list of text sizes in bytes. "
+		"Default to 1024,16384,262144,4194304."},
+	{"key-lengths", 'k', GOH_ARG_REQUIRED, 'k',
+		"Comma separated list of key lengths. Default to 3,7,13,31."},
+	{"charsets", 'c', GOH_ARG_REQUIRED, 'c',
+		"Comma separated list of charsets among alpha, upper and "
+		"lower. Default to alpha,upper."},
+	{"repeat", 'r', GOH_ARG_REQUIRED, 'r',
+		"Number of runs for every combination. Default to 3."},
+	{"format", 'f', GOH_ARG_REQUIRED, 'f',
+		"Output format, csv or json. Default to csv."},
+	{"output", 'o', GOH_ARG_REQUIRED, 'o',
+		"Output file. May be - for stdout. Default to stdout."},
+	{"seed", '\0', GOH_ARG_REQUIRED, OPT_SEED,
+		"Seed of the random generator. Default to 1."},
+	{"max-kasiski", '\0', GOH_ARG_REQUIRED, OPT_MAX_KASISKI,
+		"Skip the Kasiski analysis, which is quadratic, for texts "
+		"longer than this. Default to 65536."}
+};
+
+
+struct bench {
+	struct driver_report report;
+	struct synth_model model;
+	struct synth_rng rng;
+	size_t max_kasiski;
+	char tmpname[4096];
+
+	/* Current combination. */
+	const char *csname;
+	size_t size;
+	size_t klen;
+	size_t rep;
+};
+
+
+
+static void report(struct bench *b, const char *stage, double seconds,
+                   size_t bytes) {
+	FILE *out = b->report.out;
+	double mbps = seconds > 0 ? bytes / seconds / 1e6 : 0;
+
+	driver_result(&b->report, "version,charset,size,keylen,rep,stage,"
+	              "seconds,bytes,mbps");
+
+	if (b->report.format == DRIVER_CSV) {
+		fprintf(out, "%s,%s,%lu,%lu,%lu,%s,%.9f,%lu,%.3f\n",
+		        BENCH_VERSION, b->csname, (unsigned long)b->size,
+		        (unsigned long)b->klen, (unsigned long)b->rep, stage,
+		        seconds, (unsigned long)bytes, mbps);
+	} else {
+		fprintf(out, "  {\"charset\": \"%s\", \"size\": %lu, "
+		        "\"keylen\": %lu, \"rep\": %lu, \"stage\": \"%s\", "
+		        "\"seconds\": %.9f, \"bytes\": %lu, \"mbps\": %.3f}",
+		        b->csname, (unsigned long)b->size,
+		        (unsigned long)b->klen, (unsigned long)b->rep, stage,
+		        seconds, (unsigned long)bytes, mbps);
+	}
+}
+
+
+
+static void build_charset(struct charset *cs, const char *name) {
+	check(cs_init(cs), "Charset");
+
+	if (strcmp(name, "alpha") == 0) {
+		check(cs_add(cs, CHARSET_UPPER), "Charset");
+		check(cs_add(cs, CHARSET_LOWER), "Charset");
+	} else if (strcmp(name, "upper") == 0) {
+		check(cs_add(cs, CHARSET_UPPER), "Charset");
+	} else if (strcmp(name, "lower") == 0) {
+		check(cs_add(cs, CHARSET_LOWER), "Charset");
+	} else {
+		custom_error("Unknown charset %s", name);
+	}
+}
+
+
+
+/* Time every stage on one text. */
+static void bench_one(struct bench *b, const struct charset *cs,
+                      const char *plain, char *text, const char *key) {
+	struct fs_ctx s;
+	struct kasiski ka;
+	struct mfreq mfa;
+	struct io_buf buf;
+	double t;
+	size_t size = b->size;
+
+	memcpy(text, plain, size);
+
+	t = driver_now();
+	check(fs_init(&s, text, size, cs, NULL), "fs_init");
+	report(b, "fs_init", driver_now() - t, size);
+
+	t = driver_now();
+	check(vig_encrypt(&s, key), "vig_encrypt");
+	report(b, "vig_encrypt", driver_now() - t, size);
+
+	if (size <= b->max_kasiski) {
+		t = driver_now();
+		check(ka_init(&ka, s.norm, s.nlen, 3, NULL), "ka_init");
+		ka_analyze(&ka);
+		report(b, "ka_analyze", driver_now() - t, s.nlen);
+		ka_fini(&ka);
+	}
+
+	t = driver_now();
+	check(mfa_init(&mfa, s.norm, s.nlen, b->klen, cs, freq_en, NULL),
+	      "mfa_init");
+	check(mfa_analyze(&mfa), "mfa_analyze");
+	report(b, "mfa_analyze", driver_now() - t, s.nlen);
+	mfa_fini(&mfa);
+
+	t = driver_now();
+	check(vig_decrypt(&s, key), "vig_decrypt");
+	report(b, "vig_decrypt", driver_now() - t, size);
+
+	if (memcmp(text, plain, size) != 0)
+		custom_error("Decryption doesn't give the plaintext back");
+
+	t = driver_now();
+	check(io_write(b->tmpname, text, size), "io_write");
+	report(b, "io_write", driver_now() - t, size);
+
+	t = driver_now();
+	check(io_read(&buf, b->tmpname), "io_read");
+	report(b, "io_read", driver_now() - t, size);
+
+	if (buf.len != size || memcmp(buf.data, plain, size) != 0)
+		custom_error("Data read back differs from the data written");
+
+	io_release(&buf);
+	fs_fini(&s);
+}
+
+
+
+static void bench_charset(struct bench *b, const char *csname,
+                          const size_t *sizes, size_t nsizes,
+                          const size_t *klens, size_t nklens, size_t reps) {
+	struct charset cs;
+	size_t i, j, k;
+
+	build_charset(&cs, csname);
+	b->csname = csname;
+
+	for (i = 0; i < nsizes; i++) {
+		char *plain, *text, *key;
+		size_t n;
+
+		b->size = sizes[i];
+		plain = malloc(b->size + 1);
+		text = malloc(b->size + 1);
+		if (plain == NULL || text == NULL)
+			system_error("malloc");
+
+		synth_text(&b->model, &b->rng, plain, b->size);
+		for (n = 0; n < b->size; n++) {
+			if (strcmp(csname, "upper") == 0)
+				plain[n] = toupper((unsigned char)plain[n]);
+			else if (strcmp(csname, "lower") == 0)
+				plain[n] = tolower((unsigned char)plain[n]);
+		}
+
+		for (j = 0; j < nklens; j++) {
+			b->klen = klens[j];
+			key = malloc(b->klen + 1);
+			if (key == NULL)
+				system_error("malloc");
+
+			for (k = 0; k < reps; k++) {
+				b->rep = k;
+				synth_key(&b->rng, &cs, key, b->klen);
+				bench_one(b, &cs, plain, text, key);
+			}
+
+			free(key);
+		}
+
+		free(text);
+		free(plain);
+	}
+
+	cs_fini(&cs);
+}
+
+
+
+int main(int argc, char **argv) {
+	struct goh_state st;
+	struct bench b;
+	int opt;
+	size_t sizes[64] = {1024, 16384, 262144, 4194304};
+	size_t nsizes = 4;
+	size_t klens[64] = {3, 7, 13, 31};
+	size_t nklens = 4;
+	const char *charsets = "alpha,upper";
+	char *cslist;
+	char *csname;
+	size_t reps = 3;
+	unsigned long seed = 1;
+	const char *filenameout = "-";
+	const char *tmpdir;
+	int fd;
+	size_t i;
+
+	memset(&b, 0, sizeof(b));
+	b.max_kasiski = 65536;
+
+	goh_init(&st, opt_desc, ARRAY_LENGTH(opt_desc), argc, argv, 1);
+	st.usagehelp = "[options]\n";
+
+	while ((opt = goh_nextoption(&st)) >= 0) {
+		switch (opt) {
+		case 's':
+			nsizes = driver_parse_list(st.argval, sizes,
+			                    ARRAY_LENGTH(sizes));
+			break;
+
+		case 'k':
+			nklens = driver_parse_list(st.argval, klens,
+			                    ARRAY_LENGTH(klens));
+			break;
+
+		case 'c':
+			charsets = st.argval;
+			break;
+
+		case 'r':
+			reps = atoi(st.argval);
+			break;
+
+		case 'f':
+			driver_set_format(&b.report, st.argval);
+			break;
+
+		case 'o':
+			filenameout = st.argval;
+			break;
+
+		case OPT_SEED:
+			seed = strtoul(st.argval, NULL, 10);
+			break;
+
+		case OPT_MAX_KASISKI:
+			b.max_kasiski = strtoul(st.argval, NULL, 10);
+			break;
+
+		default:
+			custom_error("Unrecognized option (shouldn't happen)");
+			break;
+		}
+	}
+
+	if (st.argidx != argc)
+		custom_error("Useless argument %s", argv[st.argidx]);
+
+	goh_fini(&st);
+
+	for (i = 0; i < nklens; i++) {
+		if (klens[i] == 0)
+			custom_error("Key lengths must be positive");
+	}
+
+	driver_open(&b.report, filenameout);
+
+	tmpdir = getenv("TMPDIR");
+	if (tmpdir == NULL)
+		tmpdir = "/tmp";
+
+	sprintf(b.tmpname, "%.4000s/unvigenere-bench-XXXXXX", tmpdir);
+	fd = mkstemp(b.tmpname);
+	if (fd == -1)
+		system_error(b.tmpname);
+	close(fd);
+
+	synth_train(&b.model);
+	synth_seed(&b.rng, seed);
+
+	cslist = strdup(charsets);
+	if (cslist == NULL)
+		system_error("strdup");
+
+	for (csname = strtok(cslist, ","); csname != NULL;
+	     csname = strtok(NULL, ","))
+		bench_charset(&b, csname, sizes, nsizes, klens, nklens, reps);
+
+	free(cslist);
+
+	driver_close(&b.report, filenameout);
+
+	unlink(b.tmpname);
+
+	return EXIT_SUCCESS;
+}
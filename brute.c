@@ -0,0 +1,621 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "ngram.h"
+#include "arena.h"
+#include "deadline.h"
+#include "checkpoint.h"
+#include "brute.h"
+
+
+
+/* What all the threads share. */
+struct brute_run {
+	const struct brute *b;
+
+	/* Pair tables of every key length, see ngram_pair_tables. */
+	float *tab[BRUTE_MAX_KLEN + 1];
+
+	/* A work item is a key length and the first characters of the key,
+	 * all of them but ITEM_FREE, or the first one for the short keys.
+	 * first[klen] is the first item of the key length klen. */
+	size_t first[BRUTE_MAX_KLEN + 2];
+	size_t nitems;
+	size_t next;
+
+	/* Set by the first thread that saw the deadline pass. */
+	int expired;
+};
+
+
+
+struct brute_job {
+	struct brute_run *run;
+
+	/* Min-heap of the best keys of this thread, the worst one on top. */
+	struct brute_key *heap;
+	size_t size;
+
+	/* Number of items done by this thread. */
+	size_t ndone;
+
+	pthread_t thread;
+};
+
+
+
+int brute_init(struct brute *b, const char *str, size_t len,
+               const struct charset *charset, struct arena *arena) {
+	memset(b, 0, sizeof(*b));
+	b->str = str;
+	b->str_len = len;
+	b->charset = charset;
+	b->minlen = 1;
+	b->maxlen = BRUTE_DEFAULT_MAXLEN;
+	b->sample = BRUTE_DEFAULT_SAMPLE;
+	b->ntop = BRUTE_DEFAULT_TOP;
+	b->arena = arena;
+
+	ngram_train_en(&b->model_en);
+	b->model = &b->model_en;
+
+	if (charset->length != NGRAM_NSYM)
+		return ERR_CHARSET;
+
+	return ERR_OK;
+}
+
+
+
+void brute_fini(struct brute *b) {
+	arena_free(b->arena, b->done);
+	arena_free(b->arena, b->top);
+	memset(b, 0, sizeof(*b));
+}
+
+
+
+/* Total order of the keys. The shorter key wins the ties, then the first one
+ * in alphabetical order. */
+static int key_better(const struct brute_key *a, const struct brute_key *b) {
+	if (a->score != b->score)
+		return a->score > b->score;
+
+	if (a->klen != b->klen)
+		return a->klen < b->klen;
+
+	return strcmp(a->key, b->key) < 0;
+}
+
+
+
+static int key_cmp(const void *pa, const void *pb) {
+	const struct brute_key *a = pa, *b = pb;
+
+	if (key_better(a, b))
+		return -1;
+
+	return key_better(b, a);
+}
+
+
+
+/* Remove the consecutive copies of the same key in the size keys, and return
+ * the number left. */
+static size_t unique(struct brute_key *keys, size_t size) {
+	size_t i, n = 0;
+
+	for (i = 0; i < size; i++) {
+		if (n > 0 && keys[n - 1].klen == keys[i].klen &&
+		    strcmp(keys[n - 1].key, keys[i].key) == 0)
+			continue;
+
+		keys[n++] = keys[i];
+	}
+
+	return n;
+}
+
+
+
+static void heap_down(struct brute_key *heap, size_t size, size_t i) {
+	struct brute_key tmp;
+	size_t c;
+
+	while ((c = 2 * i + 1) < size) {
+		if (c + 1 < size && key_better(&heap[c], &heap[c + 1]))
+			c++;
+
+		if (!key_better(&heap[i], &heap[c]))
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[c];
+		heap[c] = tmp;
+		i = c;
+	}
+}
+
+
+
+static void heap_up(struct brute_key *heap, size_t i) {
+	struct brute_key tmp;
+	size_t p;
+
+	while (i > 0) {
+		p = (i - 1) / 2;
+		if (!key_better(&heap[p], &heap[i]))
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[p];
+		heap[p] = tmp;
+		i = p;
+	}
+}
+
+
+
+/* Number of key characters left to choose when the deadline is checked. */
+#define CHECK_DEPTH 4
+
+/* Number of key characters left to choose by a work item. An item then tries
+ * at most n^ITEM_FREE keys, which doesn't take long to finish once started. */
+#define ITEM_FREE 5
+
+
+
+/* Number of characters fixed by the work items of the key length klen. */
+static size_t item_prefix(size_t klen) {
+	return klen > ITEM_FREE + 1 ? klen - ITEM_FREE : 1;
+}
+
+
+
+/* Set the first item of every key length, and return the number of items. */
+static size_t count_items(const struct brute *b, size_t *first) {
+	size_t n = b->charset->length;
+	size_t nitems = 0;
+	size_t klen, i, m;
+
+	for (klen = b->minlen; klen <= b->maxlen; klen++) {
+		first[klen] = nitems;
+		for (m = 1, i = 0; i < item_prefix(klen); i++)
+			m *= n;
+		nitems += m;
+	}
+	first[klen] = nitems;
+
+	return nitems;
+}
+
+
+
+/* Tell whether the workers must stop. Once a thread saw the deadline pass, the
+ * others don't need to read the clock anymore. */
+static int out_of_time(struct brute_run *run) {
+	if (__atomic_load_n(&run->expired, __ATOMIC_RELAXED))
+		return 1;
+
+	if (!deadline_passed(run->b->deadline))
+		return 0;
+
+	__atomic_store_n(&run->expired, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+
+
+/* Lowest score still worth looking at. */
+static float threshold(const struct brute_job *j) {
+	if (j->size < j->run->b->ntop)
+		return -FLT_MAX;
+
+	return j->heap[0].score;
+}
+
+
+
+/* Offer the key of klen characters k to the heap of the job. */
+static void consider(struct brute_job *j, const unsigned char *k, size_t klen,
+                     float score) {
+	const struct brute *b = j->run->b;
+	struct brute_key key;
+	size_t i;
+
+	key.score = score;
+	key.klen = klen;
+	for (i = 0; i < klen; i++)
+		key.key[i] = cs_chr(b->charset, k[i]);
+	key.key[klen] = '\0';
+
+	/* A key tried again after a resume may already be there. */
+	for (i = 0; i < j->size; i++)
+		if (j->heap[i].klen == klen && strcmp(j->heap[i].key,
+		                                     key.key) == 0)
+			return;
+
+	if (j->size < b->ntop) {
+		j->heap[j->size] = key;
+		heap_up(j->heap, j->size++);
+	} else if (key_better(&key, &j->heap[0])) {
+		j->heap[0] = key;
+		heap_down(j->heap, j->size, 0);
+	}
+}
+
+
+
+/*
+ * Try every key whose characters up to t are those of k. base is the score of
+ * the pairs of these characters. last[x] is the score of the pair made of the
+ * last character x and the first one.
+ */
+static void walk(struct brute_job *j, const float *tab, size_t klen, size_t t,
+                 unsigned char *k, float base, const float *last) {
+	size_t n = j->run->b->charset->length;
+	float s[NGRAM_NSYM];
+	const float *row;
+	float thr;
+	size_t x;
+
+	/* Every job finishes at least one item, so that every run makes some
+	 * progress. */
+	if (t + CHECK_DEPTH == klen && j->ndone > 0 && out_of_time(j->run))
+		return;
+
+	row = tab + (t * n + k[t]) * n;
+
+	if (t + 2 < klen) {
+		for (x = 0; x < n; x++) {
+			k[t + 1] = x;
+			walk(j, tab, klen, t + 1, k, base + row[x], last);
+		}
+		return;
+	}
+
+	/* Every choice of the last character at once. */
+	for (x = 0; x < n; x++)
+		s[x] = base + row[x] + last[x];
+
+	thr = threshold(j);
+	for (x = 0; x < n; x++) {
+		if (s[x] < thr)
+			continue;
+
+		k[t + 1] = x;
+		consider(j, k, klen, s[x]);
+		thr = threshold(j);
+	}
+}
+
+
+
+static void *brute_worker(void *arg) {
+	struct brute_job *j = arg;
+	struct brute_run *run = j->run;
+	const struct brute *b = run->b;
+	size_t n = b->charset->length;
+	unsigned char k[BRUTE_MAX_KLEN];
+	float last[NGRAM_NSYM];
+	float penalty = log(n);
+	const float *tab;
+	size_t item, klen, p, r, x, t;
+	float base;
+
+	while ((item = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) <
+	       run->nitems) {
+		if (b->done[item])
+			continue;
+
+		if (j->ndone > 0 && out_of_time(run))
+			break;
+
+		for (klen = b->minlen; run->first[klen + 1] <= item; klen++)
+			;
+
+		p = item_prefix(klen);
+		r = item - run->first[klen];
+		for (t = p; t-- > 0; r /= n)
+			k[t] = r % n;
+
+		tab = run->tab[klen];
+
+		if (klen == 1) {
+			consider(j, k, 1, tab[k[0] * n + k[0]] - penalty);
+		} else {
+			for (x = 0; x < n; x++)
+				last[x] = tab[((klen - 1) * n + x) * n + k[0]];
+
+			base = -penalty * klen;
+			for (t = 0; t + 1 < p; t++)
+				base += tab[(t * n + k[t]) * n + k[t + 1]];
+
+			walk(j, tab, klen, p - 1, k, base, last);
+
+			/* The walk may have been cut short. */
+			if (__atomic_load_n(&run->expired, __ATOMIC_RELAXED))
+				break;
+		}
+
+		b->done[item] = 1;
+		j->ndone++;
+	}
+
+	return NULL;
+}
+
+
+
+int brute_crack(struct brute *b) {
+	const struct charset *cs = b->charset;
+	size_t n = cs->length;
+	struct brute_run run;
+	struct brute_job *jobs = NULL;
+	struct brute_key *heaps = NULL;
+	unsigned char *ord = NULL;
+	size_t *count = NULL;
+	float *tables = NULL;
+	size_t slen, nthreads, nstarted, tsize, klen, i;
+	long ncpus;
+	int err = ERR_OK;
+
+	if (b->minlen == 0 || b->minlen > b->maxlen ||
+	    b->maxlen > BRUTE_MAX_KLEN || b->ntop == 0)
+		return ERR_INVAL;
+
+	slen = b->str_len < b->sample ? b->str_len : b->sample;
+	if (slen < 2)
+		return ERR_TOOSHORT;
+
+	nthreads = b->nthreads;
+	if (nthreads == 0) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+
+	memset(&run, 0, sizeof(run));
+	run.b = b;
+	run.nitems = count_items(b, run.first);
+	if (nthreads > run.nitems)
+		nthreads = run.nitems;
+
+	/* Continue the previous run if it was cut short with the same
+	 * settings. */
+	if (b->done != NULL && b->nitems != run.nitems) {
+		arena_free(b->arena, b->done);
+		b->done = NULL;
+	}
+
+	if (b->done == NULL) {
+		b->done = arena_alloc(b->arena, run.nitems);
+		if (b->done == NULL)
+			return ERR_NOMEM;
+
+		memset(b->done, 0, run.nitems);
+		b->nitems = run.nitems;
+		b->top_size = 0;
+	}
+
+	tsize = 0;
+	for (klen = b->minlen; klen <= b->maxlen; klen++)
+		tsize += klen * n * n;
+
+	ord = arena_alloc(b->arena, slen);
+	count = arena_alloc(b->arena, b->maxlen * n * n * sizeof(*count));
+	tables = arena_alloc(b->arena, tsize * sizeof(*tables));
+	jobs = arena_alloc(b->arena, nthreads * sizeof(*jobs));
+	heaps = arena_alloc(b->arena, nthreads * b->ntop * sizeof(*heaps));
+	if (ord == NULL || count == NULL || tables == NULL || jobs == NULL ||
+	    heaps == NULL) {
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < slen; i++)
+		ord[i] = CS_TABLE_ORD(cs, b->str[i]);
+
+	tsize = 0;
+	for (klen = b->minlen; klen <= b->maxlen; klen++) {
+		run.tab[klen] = tables + tsize;
+		tsize += klen * n * n;
+		ngram_pair_tables(b->model, ord, slen, klen, run.tab[klen],
+		                  count);
+	}
+
+	for (nstarted = 0; nstarted < nthreads; nstarted++) {
+		struct brute_job *j = &jobs[nstarted];
+
+		j->run = &run;
+		j->heap = heaps + nstarted * b->ntop;
+		j->ndone = 0;
+
+		/* The best keys found before raise the threshold from the
+		 * start. */
+		for (j->size = 0; j->size < b->top_size; j->size++) {
+			j->heap[j->size] = b->top[j->size];
+			heap_up(j->heap, j->size);
+		}
+
+		if (pthread_create(&j->thread, NULL, brute_worker, j) != 0)
+			break;
+	}
+
+	if (nstarted == 0) {
+		err = ERR_THREAD;
+		goto out;
+	}
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(jobs[i].thread, NULL);
+
+	b->expired = run.expired;
+
+	/* Gather the best keys of every thread. The ntop best keys overall
+	 * are among them, whatever the thread that found them. */
+	arena_free(b->arena, b->top);
+	b->top = arena_alloc(b->arena, nstarted * b->ntop * sizeof(*b->top));
+	if (b->top == NULL) {
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	b->top_size = 0;
+	for (i = 0; i < nstarted; i++) {
+		memcpy(b->top + b->top_size, jobs[i].heap,
+		       jobs[i].size * sizeof(*b->top));
+		b->top_size += jobs[i].size;
+	}
+
+	/* Every thread started with the same keys, the copies are next to
+	 * each other once sorted. */
+	qsort(b->top, b->top_size, sizeof(*b->top), key_cmp);
+	b->top_size = unique(b->top, b->top_size);
+	if (b->top_size > b->ntop)
+		b->top_size = b->ntop;
+
+	if (!b->expired) {
+		arena_free(b->arena, b->done);
+		b->done = NULL;
+	}
+
+out:
+	arena_free(b->arena, heaps);
+	arena_free(b->arena, jobs);
+	arena_free(b->arena, tables);
+	arena_free(b->arena, count);
+	arena_free(b->arena, ord);
+	return err;
+}
+
+
+
+int brute_save(const struct brute *b, struct ckpt *c) {
+	unsigned char bits;
+	size_t nitems, i;
+	int err;
+
+	nitems = b->done != NULL ? b->nitems : 0;
+
+	err = ckpt_put(c, b->minlen);
+	if (err == ERR_OK)
+		err = ckpt_put(c, b->maxlen);
+	if (err == ERR_OK)
+		err = ckpt_put(c, b->ntop);
+	if (err == ERR_OK)
+		err = ckpt_put(c, nitems);
+
+	for (i = 0; i < nitems && err == ERR_OK; i += 8) {
+		size_t bit;
+
+		bits = 0;
+		for (bit = 0; bit < 8 && i + bit < nitems; bit++)
+			bits |= (b->done[i + bit] != 0) << bit;
+
+		err = ckpt_put_bytes(c, &bits, 1);
+	}
+
+	if (err == ERR_OK)
+		err = ckpt_put(c, b->top_size);
+
+	for (i = 0; i < b->top_size && err == ERR_OK; i++) {
+		const struct brute_key *key = &b->top[i];
+
+		err = ckpt_put(c, key->klen);
+		if (err == ERR_OK)
+			err = ckpt_put_bytes(c, key->key, key->klen);
+		if (err == ERR_OK)
+			err = ckpt_put_bytes(c, &key->score, sizeof(key->score));
+	}
+
+	return err;
+}
+
+
+
+int brute_restore(struct brute *b, struct ckpt *c) {
+	size_t first[BRUTE_MAX_KLEN + 2];
+	size_t minlen, maxlen, ntop, nitems, top_size, i;
+	unsigned char bits;
+	int err;
+
+	if (b->minlen == 0 || b->minlen > b->maxlen ||
+	    b->maxlen > BRUTE_MAX_KLEN || b->ntop == 0)
+		return ERR_INVAL;
+
+	err = ckpt_get(c, &minlen);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &maxlen);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &ntop);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &nitems);
+	if (err != ERR_OK)
+		return err;
+
+	if (minlen != b->minlen || maxlen != b->maxlen || ntop != b->ntop ||
+	    (nitems != 0 && nitems != count_items(b, first)))
+		return ERR_FORMAT;
+
+	arena_free(b->arena, b->done);
+	b->done = NULL;
+	b->top_size = 0;
+
+	/* Before or after the search, there's no progress to restore, only
+	 * the best keys. */
+	if (nitems != 0) {
+		b->done = arena_alloc(b->arena, nitems);
+		if (b->done == NULL)
+			return ERR_NOMEM;
+
+		b->nitems = nitems;
+	}
+
+	for (i = 0; i < nitems && err == ERR_OK; i++) {
+		if (i % 8 == 0)
+			err = ckpt_get_bytes(c, &bits, 1);
+
+		b->done[i] = (bits >> i % 8) & 1;
+	}
+
+	if (err == ERR_OK)
+		err = ckpt_get(c, &top_size);
+	if (err != ERR_OK)
+		return err;
+
+	if (top_size > b->ntop)
+		return ERR_FORMAT;
+
+	arena_free(b->arena, b->top);
+	b->top = arena_alloc(b->arena, b->ntop * sizeof(*b->top));
+	if (b->top == NULL)
+		return ERR_NOMEM;
+
+	for (i = 0; i < top_size; i++) {
+		struct brute_key *key = &b->top[i];
+
+		err = ckpt_get(c, &key->klen);
+		if (err == ERR_OK && (key->klen < minlen || key->klen > maxlen))
+			err = ERR_FORMAT;
+		if (err == ERR_OK)
+			err = ckpt_get_bytes(c, key->key, key->klen);
+		if (err == ERR_OK)
+			err = ckpt_get_bytes(c, &key->score, sizeof(key->score));
+		if (err != ERR_OK)
+			return err;
+
+		key->key[key->klen] = '\0';
+		b->top_size++;
+	}
+
+	return ERR_OK;
+}
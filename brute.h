@@ -0,0 +1,119 @@
+#ifndef BRUTE_H__
+#define BRUTE_H__
+
+/*
+ * This module try every key of every length up to a few characters, and keep
+ * the best ones. It's only feasible for short keys, but it's definitive: no
+ * key is missed because of a wrong key length or a misleading column.
+ *
+ * The keys are scored by the letter bigram log-likelihood of a sample taken
+ * from the start of the filtered text once decrypted. A bigram spans two
+ * consecutive key characters, so the score of a key of length klen is the sum
+ * of klen pair scores: the one of the key characters t and t + 1 (modulo
+ * klen) decrypting every bigram starting in the column t. These pair tables
+ * are computed once per key length, after which a key costs a couple of
+ * additions, made for the last key character of all the keys sharing the
+ * others at once.
+ *
+ * Every key character is penalized by the log of the charset length, the
+ * cost of choosing it. Without that, a longer key would always fit the sample
+ * better.
+ *
+ * The key space is partitioned by key length and first characters among
+ * several threads. The work items done are remembered, so that a run cut
+ * short by its deadline can be continued, possibly after a restart through a
+ * checkpoint, see checkpoint.h.
+ */
+
+#include <sys/types.h>
+
+#include "charset.h"
+#include "ngram.h"
+#include "arena.h"
+#include "checkpoint.h"
+
+
+/* Longest key that can be tried, and the default. */
+#define BRUTE_MAX_KLEN 8
+#define BRUTE_DEFAULT_MAXLEN 6
+
+#define BRUTE_DEFAULT_SAMPLE 4096
+#define BRUTE_DEFAULT_TOP 10
+
+
+
+struct brute_key {
+	float score;
+	size_t klen;
+	char key[BRUTE_MAX_KLEN + 1];
+};
+
+
+
+struct brute {
+	const char *str;
+	size_t str_len;
+	const struct charset *charset;
+
+	/* Settings, may be changed before brute_crack. */
+	size_t minlen;
+	size_t maxlen;
+	size_t sample;
+	size_t ntop;
+
+	/* Number of threads, 0 for one per CPU. */
+	size_t nthreads;
+
+	/* Language model, model_en by default. */
+	const struct ngram *model;
+
+	/* The best keys found by brute_crack, best first. */
+	struct brute_key *top;
+	size_t top_size;
+
+	struct arena *arena;
+	struct ngram model_en;
+
+	/* When to stop, see deadline.h. 0 by default. The keys are tried from
+	 * the shortest ones, the top then holds the best of those tried. */
+	double deadline;
+	int expired;
+
+	/* Which work items are done, kept while a run cut short by the
+	 * deadline has some left. Running brute_crack again with the same
+	 * settings then only tries the others. */
+	unsigned char *done;
+	size_t nitems;
+};
+
+
+
+/*
+ * Initialize a struct brute to crack the len bytes of the filtered text str.
+ * arena may be NULL to use malloc.
+ * Return ERR_CHARSET if the charset doesn't have the length of the model.
+ */
+int brute_init(struct brute *b, const char *str, size_t len,
+               const struct charset *charset, struct arena *arena);
+
+/* Deinitialize a struct brute. */
+void brute_fini(struct brute *b);
+
+/*
+ * Try every key from minlen to maxlen characters.
+ * Return ERR_INVAL if the lengths are out of range, ERR_TOOSHORT if the text
+ * has less than two characters, ERR_THREAD if no thread could be started.
+ * Set expired if the deadline passed before the end. Every thread finishes at
+ * least a work item before it checks the deadline.
+ */
+int brute_crack(struct brute *b);
+
+/* Save the work items done and the best keys so far to a checkpoint of kind
+ * CKPT_BRUTE. */
+int brute_save(const struct brute *b, struct ckpt *c);
+
+/* Restore what brute_save saved. Return ERR_INVAL like brute_crack, and
+ * ERR_FORMAT if the key lengths or the number of best keys differ. */
+int brute_restore(struct brute *b, struct ckpt *c);
+
+#endif
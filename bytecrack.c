@@ -0,0 +1,326 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "mfreq_analysis.h"
+#include "bytes.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "bytecrack.h"
+
+
+
+/* Number of bytes compared for every key length with the Hamming distance. */
+#define HAMMING_BYTES (64 * 1024)
+
+
+
+static const char *const estimator_names[BC_EST_LAST] = {
+	"ioc",
+	"hamming"
+};
+
+
+
+void bc_model_en(float model[256]) {
+	const char *punct = ".,;:'\"-!?()";
+	size_t i;
+
+	/* Anything else is very unlikely, but not impossible. */
+	for (i = 0; i < 256; i++)
+		model[i] = 0.00001;
+
+	for (i = 0; i < 26; i++) {
+		model[(unsigned char)CHARSET_LOWER[i]] = 0.72 * freq_en[i];
+		model[(unsigned char)CHARSET_UPPER[i]] = 0.03 * freq_en[i];
+	}
+
+	for (i = 0; i < 10; i++)
+		model[(unsigned char)CHARSET_NUMER[i]] = 0.002;
+
+	for (i = 0; punct[i] != '\0'; i++)
+		model[(unsigned char)punct[i]] = 0.004;
+
+	model[' '] = 0.17;
+	model['\n'] = 0.015;
+}
+
+
+
+const char *bc_estimator_name(enum bc_estimator est) {
+	if (est >= BC_EST_LAST)
+		return NULL;
+
+	return estimator_names[est];
+}
+
+
+
+enum bc_estimator bc_estimator_from_name(const char *name) {
+	size_t i;
+
+	for (i = 0; i < BC_EST_LAST; i++) {
+		if (strcmp(estimator_names[i], name) == 0)
+			return i;
+	}
+
+	return BC_EST_LAST;
+}
+
+
+
+void bc_init(struct byte_cracker *bc, const unsigned char *data, size_t len,
+             enum bytes_op op) {
+	memset(bc, 0, sizeof(*bc));
+	bc->data = data;
+	bc->len = len;
+	bc->op = op;
+	bc->estimator = BC_EST_IOC;
+	bc->maxlen = BC_DEFAULT_MAXLEN;
+
+	bc_model_en(bc->model_en);
+	bc->model = bc->model_en;
+
+	arena_init(&bc->arena, 0);
+}
+
+
+
+void bc_fini(struct byte_cracker *bc) {
+	arena_fini(&bc->arena);
+	memset(bc, 0, sizeof(*bc));
+}
+
+
+
+int bc_set_length(struct byte_cracker *bc, size_t klen) {
+	if (klen == 0)
+		return ERR_INVAL;
+
+	bc->key = arena_alloc(&bc->arena, klen);
+	if (bc->key == NULL)
+		return ERR_NOMEM;
+
+	memset(bc->key, 0, klen);
+	bc->klen = klen;
+	return ERR_OK;
+}
+
+
+
+/* Mean index of coincidence of the columns, times 256. */
+static void score_ioc(struct byte_cracker *bc, size_t sample) {
+	size_t count[256];
+	size_t klen, col, i;
+
+	for (klen = 1; klen < bc->nscores; klen++) {
+		double sum = 0;
+
+		for (col = 0; col < klen; col++) {
+			double c = 0;
+			size_t total = 0;
+
+			memset(count, 0, sizeof(count));
+			for (i = col; i < sample; i += klen) {
+				count[bc->data[i]]++;
+				total++;
+			}
+
+			for (i = 0; i < 256; i++)
+				c += (double)count[i] * (count[i] - 1);
+
+			if (total > 1)
+				sum += c / ((double)total * (total - 1));
+		}
+
+		bc->scores[klen] = sum / klen * 256;
+	}
+}
+
+
+
+static unsigned popcount8(unsigned x) {
+	x = x - ((x >> 1) & 0x55);
+	x = (x & 0x33) + ((x >> 2) & 0x33);
+	return (x + (x >> 4)) & 0x0f;
+}
+
+
+
+/* Mean number of differing bits per byte between consecutive blocks. */
+static void score_hamming(struct byte_cracker *bc, size_t sample) {
+	size_t klen, i, n;
+
+	for (klen = 1; klen < bc->nscores; klen++) {
+		size_t bits = 0;
+
+		/* Compare every byte with the one klen bytes further. */
+		n = sample - klen;
+		if (n > HAMMING_BYTES)
+			n = HAMMING_BYTES;
+
+		for (i = 0; i < n; i++)
+			bits += popcount8(bc->data[i] ^ bc->data[i + klen]);
+
+		bc->scores[klen] = (float)bits / n;
+	}
+}
+
+
+
+/*
+ * The multiples of the key length score as well as the key length. Take the
+ * shortest length that gets most of the way from the typical score to the
+ * best one.
+ */
+static size_t best_length(const struct byte_cracker *bc, int higher) {
+	float best = bc->scores[1];
+	double mean = 0;
+	float threshold;
+	size_t i;
+
+	for (i = 1; i < bc->nscores; i++) {
+		mean += bc->scores[i];
+		if ((higher && bc->scores[i] > best) ||
+		    (!higher && bc->scores[i] < best))
+			best = bc->scores[i];
+	}
+
+	mean /= bc->nscores - 1;
+	threshold = mean + (best - mean) * 0.8;
+
+	for (i = 1; i < bc->nscores; i++) {
+		if ((higher && bc->scores[i] >= threshold) ||
+		    (!higher && bc->scores[i] <= threshold))
+			return i;
+	}
+
+	return 1;
+}
+
+
+
+int bc_length(struct byte_cracker *bc) {
+	size_t sample, maxlen;
+	enum stats_stage stage;
+	double t;
+
+	sample = bc->len < BC_SAMPLE_SIZE ? bc->len : BC_SAMPLE_SIZE;
+
+	/* Have at least two blocks of every length. */
+	maxlen = bc->maxlen < sample / 2 ? bc->maxlen : sample / 2;
+	if (maxlen < 1)
+		return ERR_TOOSHORT;
+
+	bc->nscores = maxlen + 1;
+	bc->scores = arena_alloc(&bc->arena, bc->nscores * sizeof(*bc->scores));
+	if (bc->scores == NULL)
+		return ERR_NOMEM;
+
+	bc->scores[0] = 0;
+	stage = bc->estimator == BC_EST_HAMMING ? STATS_HAMMING : STATS_IOC;
+	stats_begin(bc->stats, &bc->arena);
+	t = trace_begin(bc->trace);
+
+	if (bc->estimator == BC_EST_HAMMING)
+		score_hamming(bc, sample);
+	else
+		score_ioc(bc, sample);
+
+	trace_end(bc->trace, t, stats_stage_name(stage), NULL, maxlen);
+	stats_end(bc->stats, stage, sample);
+
+	return bc_set_length(bc, best_length(bc,
+	                                     bc->estimator != BC_EST_HAMMING));
+}
+
+
+
+/* Find the key byte that makes a column the closest to the model. */
+static unsigned char best_key_byte(const struct byte_cracker *bc,
+                                   const size_t *count) {
+	double best = -1;
+	unsigned char bestk = 0;
+	unsigned k, b;
+
+	for (k = 0; k < 256; k++) {
+		double score = 0;
+
+		for (b = 0; b < 256; b++) {
+			unsigned p;
+
+			if (count[b] == 0)
+				continue;
+
+			p = bc->op == BYTES_XOR ? b ^ k : (b - k) & 0xff;
+			score += count[b] * bc->model[p];
+		}
+
+		if (score > best) {
+			best = score;
+			bestk = k;
+		}
+	}
+
+	return bestk;
+}
+
+
+
+int bc_key(struct byte_cracker *bc) {
+	size_t *count;
+	size_t i, col;
+	double t;
+
+	if (bc->klen == 0)
+		return ERR_NOLENGTH;
+
+	if (bc->klen > (size_t)-1 / 256 / sizeof(*count))
+		return ERR_NOMEM;
+
+	stats_begin(bc->stats, &bc->arena);
+	t = trace_begin(bc->trace);
+
+	count = arena_alloc(&bc->arena, bc->klen * 256 * sizeof(*count));
+	if (count == NULL) {
+		stats_end(bc->stats, STATS_FREQ, 0);
+		return ERR_NOMEM;
+	}
+
+	memset(count, 0, bc->klen * 256 * sizeof(*count));
+
+	/* A single pass over the data for all the columns. */
+	col = 0;
+	for (i = 0; i < bc->len; i++) {
+		count[col * 256 + bc->data[i]]++;
+		if (++col == bc->klen)
+			col = 0;
+	}
+
+	for (col = 0; col < bc->klen; col++)
+		bc->key[col] = best_key_byte(bc, count + col * 256);
+
+	arena_free(&bc->arena, count);
+
+	trace_end(bc->trace, t, "freq", NULL, bc->klen);
+	stats_end(bc->stats, STATS_FREQ, bc->len);
+
+	return ERR_OK;
+}
+
+
+
+int bc_crack(struct byte_cracker *bc) {
+	int err;
+
+	if (bc->klen == 0) {
+		err = bc_length(bc);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return bc_key(bc);
+}
@@ -0,0 +1,103 @@
+#ifndef BYTECRACK_H__
+#define BYTECRACK_H__
+
+/*
+ * This module crack a repeating key XOR or additive cipher over raw bytes, as
+ * encrypted by the bytes module. Like the cracker module, the key length is
+ * found first and then every key byte is found independently:
+ * - The key length is estimated either with the index of coincidence of the
+ *   columns, which works for both operations, or with the normalized Hamming
+ *   distance between consecutive blocks, which only makes sense with XOR.
+ * - Every key byte is the one that makes its column look the most like the
+ *   byte frequency model, English ASCII text by default.
+ *
+ * Only the first BC_SAMPLE_SIZE bytes are used to find the key length, the
+ * key bytes are found with a single pass over all the data.
+ */
+
+#include <sys/types.h>
+
+#include "bytes.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+
+
+#define BC_DEFAULT_MAXLEN 64
+#define BC_SAMPLE_SIZE (256 * 1024)
+
+
+enum bc_estimator {
+	BC_EST_IOC,
+	BC_EST_HAMMING,
+	BC_EST_LAST
+};
+
+
+struct byte_cracker {
+	const unsigned char *data;
+	size_t len;
+	enum bytes_op op;
+
+	/* Settings, may be changed after bc_init. */
+	enum bc_estimator estimator;
+	size_t maxlen;
+
+	/* Expected frequency of every byte value in the plaintext. Points to
+	 * model_en by default. */
+	const float *model;
+
+	/* Score of every key length, scores[0] is unused. For the index of
+	 * coincidence, higher is better. For the Hamming distance, lower is
+	 * better. */
+	float *scores;
+	size_t nscores;
+
+	size_t klen;
+	unsigned char *key;
+
+	struct arena arena;
+	struct stats *stats;
+	struct trace_buf *trace;
+
+	float model_en[256];
+};
+
+
+
+/* Fill model with the byte frequencies of English ASCII text. */
+void bc_model_en(float model[256]);
+
+/* Return the name of an estimator, or NULL if it doesn't exist. */
+const char *bc_estimator_name(enum bc_estimator est);
+
+/* Return the estimator with the given name, or BC_EST_LAST if none. */
+enum bc_estimator bc_estimator_from_name(const char *name);
+
+/* Initialize a cracker for the len bytes of data encrypted with op. */
+void bc_init(struct byte_cracker *bc, const unsigned char *data, size_t len,
+             enum bytes_op op);
+
+/* Free everything the cracker allocated. */
+void bc_fini(struct byte_cracker *bc);
+
+/* Set the key length. */
+int bc_set_length(struct byte_cracker *bc, size_t klen);
+
+/*
+ * Estimate the key length.
+ * Return ERR_TOOSHORT if there isn't enough data for two blocks of every
+ * tested length.
+ */
+int bc_length(struct byte_cracker *bc);
+
+/*
+ * Find the key bytes.
+ * Return ERR_NOLENGTH if the key length hasn't been set or estimated before.
+ */
+int bc_key(struct byte_cracker *bc);
+
+/* Find the key length if needed, then the key. */
+int bc_crack(struct byte_cracker *bc);
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "arena.h"
+#include "bytes.h"
+
+
+
+typedef unsigned long word;
+
+#define WSIZE (sizeof(word))
+
+/* 0x8080...80 and 0x7f7f...7f whatever the word size. */
+#define HIGH_BITS (~(word)0 / 0xff * 0x80)
+#define LOW_BITS (~HIGH_BITS)
+
+
+
+static const char *const op_names[BYTES_OP_LAST] = {
+	"xor",
+	"add"
+};
+
+
+
+const char *bytes_op_name(enum bytes_op op) {
+	if (op >= BYTES_OP_LAST)
+		return NULL;
+
+	return op_names[op];
+}
+
+
+
+enum bytes_op bytes_op_from_name(const char *name) {
+	size_t i;
+
+	for (i = 0; i < BYTES_OP_LAST; i++) {
+		if (strcmp(op_names[i], name) == 0)
+			return i;
+	}
+
+	return BYTES_OP_LAST;
+}
+
+
+
+int bytes_stream_init(struct bytes_stream *bs, const unsigned char *key,
+                      size_t klen, enum bytes_op op, int sign,
+                      struct arena *arena) {
+	size_t i;
+
+	memset(bs, 0, sizeof(*bs));
+	bs->op = op;
+	bs->klen = klen;
+	bs->arena = arena;
+
+	if (klen == 0 || op >= BYTES_OP_LAST || klen > (size_t)-1 / WSIZE - 1)
+		return ERR_INVAL;
+
+	bs->plen = klen * WSIZE;
+	bs->pattern = arena_alloc(arena, bs->plen + WSIZE);
+	if (bs->pattern == NULL)
+		return ERR_NOMEM;
+
+	for (i = 0; i < bs->plen + WSIZE; i++) {
+		unsigned char k = key[i % klen];
+
+		/* Subtracting is adding the opposite. */
+		if (op == BYTES_ADD && sign < 0)
+			k = -k;
+
+		bs->pattern[i] = k;
+	}
+
+	return ERR_OK;
+}
+
+
+
+void bytes_stream_fini(struct bytes_stream *bs) {
+	arena_free(bs->arena, bs->pattern);
+	memset(bs, 0, sizeof(*bs));
+}
+
+
+
+/* Add every byte of a and b, without carry from a byte to the next one. */
+static word add_bytes(word a, word b) {
+	return ((a & LOW_BITS) + (b & LOW_BITS)) ^ ((a ^ b) & HIGH_BITS);
+}
+
+
+
+void bytes_stream_apply(struct bytes_stream *bs, unsigned char *buf,
+                        size_t len) {
+	const unsigned char *pat = bs->pattern;
+	size_t o = bs->phase;
+	size_t i = 0;
+	word w, k;
+
+	/* memcpy lets the compiler do unaligned loads and stores. */
+	if (bs->op == BYTES_XOR) {
+		for (; len - i >= WSIZE; i += WSIZE) {
+			memcpy(&w, buf + i, WSIZE);
+			memcpy(&k, pat + o, WSIZE);
+			w ^= k;
+			memcpy(buf + i, &w, WSIZE);
+
+			o += WSIZE;
+			if (o >= bs->plen)
+				o -= bs->plen;
+		}
+
+		for (; i < len; i++)
+			buf[i] ^= pat[o++];
+	} else {
+		for (; len - i >= WSIZE; i += WSIZE) {
+			memcpy(&w, buf + i, WSIZE);
+			memcpy(&k, pat + o, WSIZE);
+			w = add_bytes(w, k);
+			memcpy(buf + i, &w, WSIZE);
+
+			o += WSIZE;
+			if (o >= bs->plen)
+				o -= bs->plen;
+		}
+
+		for (; i < len; i++)
+			buf[i] += pat[o++];
+	}
+
+	/* The pattern is a whole number of keys. */
+	bs->phase = o % bs->klen;
+}
+
+
+
+static int transform(unsigned char *buf, size_t len, const unsigned char *key,
+                     size_t klen, enum bytes_op op, int sign) {
+	struct bytes_stream bs;
+	int err;
+
+	err = bytes_stream_init(&bs, key, klen, op, sign, NULL);
+	if (err != ERR_OK)
+		return err;
+
+	bytes_stream_apply(&bs, buf, len);
+	bytes_stream_fini(&bs);
+
+	return ERR_OK;
+}
+
+
+
+int bytes_encrypt(unsigned char *buf, size_t len, const unsigned char *key,
+                  size_t klen, enum bytes_op op) {
+	return transform(buf, len, key, klen, op, BYTES_ENCRYPT);
+}
+
+
+
+int bytes_decrypt(unsigned char *buf, size_t len, const unsigned char *key,
+                  size_t klen, enum bytes_op op) {
+	return transform(buf, len, key, klen, op, BYTES_DECRYPT);
+}
@@ -0,0 +1,74 @@
+#ifndef BYTES_H__
+#define BYTES_H__
+
+/*
+ * Encode or decode raw data with a repeating key, where the alphabet is all
+ * the 256 byte values. Every byte is either XORed with the key byte or added
+ * to it modulo 256. Unlike the Vigenère module, nothing is filtered out.
+ *
+ * The data is processed a machine word at a time: the key is repeated into a
+ * pattern whose length is a multiple of the word size so that a whole word of
+ * key can be loaded at any position.
+ */
+
+#include <sys/types.h>
+
+#include "arena.h"
+
+
+enum bytes_op {
+	BYTES_XOR,
+	BYTES_ADD,
+	BYTES_OP_LAST
+};
+
+#define BYTES_ENCRYPT 1
+#define BYTES_DECRYPT -1
+
+
+struct bytes_stream {
+	enum bytes_op op;
+
+	/* Key repeated to plen bytes, plus one word to allow loading a word
+	 * at any position. For a decryption with BYTES_ADD, the key bytes are
+	 * negated so that it's also an addition. */
+	unsigned char *pattern;
+	size_t plen;
+	size_t klen;
+
+	/* Index in the key of the next byte to transform. */
+	size_t phase;
+
+	struct arena *arena;
+};
+
+
+
+/* Return the name of an operation, or NULL if it doesn't exist. */
+const char *bytes_op_name(enum bytes_op op);
+
+/* Return the operation with the given name, or BYTES_OP_LAST if none. */
+enum bytes_op bytes_op_from_name(const char *name);
+
+/*
+ * Prepare the stream to encrypt (sign = BYTES_ENCRYPT) or decrypt
+ * (sign = BYTES_DECRYPT) with the klen bytes of key.
+ * Return ERR_INVAL if the key is empty.
+ */
+int bytes_stream_init(struct bytes_stream *bs, const unsigned char *key,
+                      size_t klen, enum bytes_op op, int sign,
+                      struct arena *arena);
+
+void bytes_stream_fini(struct bytes_stream *bs);
+
+/* Transform the next len bytes of the data in place. */
+void bytes_stream_apply(struct bytes_stream *bs, unsigned char *buf,
+                        size_t len);
+
+/* Transform a whole buffer at once with the given key. */
+int bytes_encrypt(unsigned char *buf, size_t len, const unsigned char *key,
+                  size_t klen, enum bytes_op op);
+int bytes_decrypt(unsigned char *buf, size_t len, const unsigned char *key,
+                  size_t klen, enum bytes_op op);
+
+#endif
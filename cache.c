@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "checkpoint.h"
+#include "cache.h"
+
+
+
+static const char *const kind_names[CKPT_LAST] = {
+	"kasiski",
+	"brute",
+	"dict",
+	"ioc",
+	"freq"
+};
+
+/* Room for the name of a file after the directory: a slash, the digest, two
+ * 64 bits integers, a kind, the dashes and the nul. */
+#define NAME_MAX_LEN 80
+
+/* Offset basis of the 64 bits FNV-1a, in limbs. */
+static const unsigned long digest_basis[CACHE_DIGEST_LIMBS] = {
+	0x2325, 0x8422, 0x9ce4, 0xcbf2
+};
+
+
+
+/* Update the 64 bits FNV-1a digest d with the len bytes of data. */
+static void digest(unsigned long *d, const void *data, size_t len) {
+	const unsigned char *p = data;
+	unsigned long r0, r1, r2, r3;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		d[0] ^= p[i];
+
+		/* Multiply by the prime 2^40 + 0x1b3, the products of 16 bits
+		 * limbs never overflow 32 bits. */
+		r0 = d[0] * 0x1b3;
+		r1 = d[1] * 0x1b3 + (r0 >> 16);
+		r2 = d[2] * 0x1b3 + (d[0] << 8) + (r1 >> 16);
+		r3 = d[3] * 0x1b3 + (d[1] << 8) + (r2 >> 16);
+
+		d[0] = r0 & 0xffff;
+		d[1] = r1 & 0xffff;
+		d[2] = r2 & 0xffff;
+		d[3] = r3 & 0xffff;
+	}
+}
+
+
+
+void cache_init(struct cache *cache, const char *dir, const char *str,
+                size_t len, const struct charset *charset) {
+	unsigned long h;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->dir = dir;
+	cache->len = len;
+
+	/* The positions in the charset tell both what characters belong to it
+	 * and which ones are equivalent. */
+	memcpy(cache->digest, digest_basis, sizeof(cache->digest));
+	digest(cache->digest, charset->ord, sizeof(charset->ord));
+	digest(cache->digest, str, len);
+
+	h = ckpt_hash(0, charset->ord, sizeof(charset->ord));
+	cache->hash = ckpt_hash(h, str, len);
+}
+
+
+
+/* Return the malloc'ed name of the file of an analysis. */
+static char *file_name(const struct cache *cache, enum ckpt_kind kind,
+                       size_t param) {
+	char *name;
+
+	name = malloc(strlen(cache->dir) + NAME_MAX_LEN);
+	if (name == NULL)
+		return NULL;
+
+	sprintf(name, "%s/%04lx%04lx%04lx%04lx-%lu-%s-%lu", cache->dir,
+	        cache->digest[3], cache->digest[2], cache->digest[1],
+	        cache->digest[0], (unsigned long)cache->len, kind_names[kind],
+	        (unsigned long)param);
+
+	return name;
+}
+
+
+
+int cache_load(const struct cache *cache, struct ckpt *c, size_t param) {
+	char *name;
+	int err;
+
+	name = file_name(cache, c->kind, param);
+	if (name == NULL)
+		return ERR_NOMEM;
+
+	err = ckpt_read(c, name);
+	free(name);
+	return err;
+}
+
+
+
+int cache_store(const struct cache *cache, const struct ckpt *c,
+                size_t param) {
+	char *name;
+	int err;
+
+	name = file_name(cache, c->kind, param);
+	if (name == NULL)
+		return ERR_NOMEM;
+
+	err = ckpt_write(c, name);
+	free(name);
+	return err;
+}
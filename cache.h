@@ -0,0 +1,60 @@
+#ifndef CACHE_H__
+#define CACHE_H__
+
+/*
+ * This module keep the results of the analyses of a text in a directory, so
+ * that running them again on the same text only costs reading a file.
+ *
+ * A text is identified by a 64 bits digest of its filtered characters and of
+ * the charset, as well as its length. Every analysis has its own file for
+ * every setting changing its result, named after all that, like
+ * 0123456789abcdef-52000-kasiski-3. The files are checkpoints of the complete
+ * analyses, see checkpoint.h, whose fingerprint is another hash of the text,
+ * so that two texts with the same digest still don't share their results.
+ *
+ * Several processes may share a directory, the files are replaced atomically.
+ * Nothing is ever removed from it.
+ */
+
+
+#include <sys/types.h>
+
+#include "charset.h"
+#include "checkpoint.h"
+
+
+/* The digest is kept in 16 bits limbs, least significant first. */
+#define CACHE_DIGEST_LIMBS 4
+
+
+struct cache {
+	const char *dir;
+
+	/* Digest naming the files, hash checked when reading them, and length
+	 * of the text. */
+	unsigned long digest[CACHE_DIGEST_LIMBS];
+	unsigned long hash;
+	size_t len;
+};
+
+
+
+/* Initialize a struct cache for the len bytes of the filtered text str in the
+ * directory dir, which must outlive it. */
+void cache_init(struct cache *cache, const char *dir, const char *str,
+                size_t len, const struct charset *charset);
+
+/*
+ * Read the result of the analysis c->kind run with the setting param into c,
+ * which must have been initialized with the fingerprint cache->hash.
+ * Return ERR_IO with errno set to ENOENT if it isn't there, and the errors of
+ * ckpt_read.
+ */
+int cache_load(const struct cache *cache, struct ckpt *c, size_t param);
+
+/* Store the result of the analysis c->kind run with the setting param.
+ * Return ERR_IO with errno set when a system call fails. */
+int cache_store(const struct cache *cache, const struct ckpt *c,
+                size_t param);
+
+#endif
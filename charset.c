@@ -1,15 +1,20 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "misc.h"
+#include "error.h"
 #include "array.h"
 #include "charset.h"
 
 
 /* Initialize an empty charset. */
-void cs_init(struct charset *cs) {
+int cs_init(struct charset *cs) {
+	size_t i;
+
 	memset(cs, 0, sizeof(*cs));
-	ARRAY_ALLOC(cs->chars, 2);
+	for (i = 0; i < 256; i++)
+		cs->ord[i] = -1;
+
+	return ARRAY_ALLOC(cs->chars, 2);
 }
 
 
@@ -28,22 +33,75 @@ void cs_fini(struct charset *cs) {
 
 
 
+/* Tell whether the charset is only made of A-Z and a-z, at most once each. */
+static void detect_alpha(struct charset *cs) {
+	int upper = 0, lower = 0;
+	size_t i;
+
+	cs->alpha = 0;
+
+	if (!CS_HAVE_ALPHA)
+		return;
+
+	for (i = 0; i < cs->chars_size; i++) {
+		if (strcmp(cs->chars[i], CHARSET_UPPER) == 0)
+			upper++;
+		else if (strcmp(cs->chars[i], CHARSET_LOWER) == 0)
+			lower++;
+		else
+			return;
+	}
+
+	if (upper > 1 || lower > 1)
+		return;
+
+	cs->alpha = 1;
+	cs->alpha_fold = upper && lower ? 'a' ^ 'A' : 0;
+	cs->alpha_first = upper && !lower ? 'A' : 'a';
+}
+
+
+
 /* Add a list of chars to the charset. */
-void cs_add(struct charset *cs, const char *str) {
+int cs_add(struct charset *cs, const char *str) {
 	char *cpy;
-	size_t len;
+	size_t len, i;
+	int err;
 
 	len = strlen(str);
-	cpy = strdup(str);
 
-	if (cs->chars_size == 0)
-		cs->length = len;
+	if (cs->chars_size > 0 && len != cs->length)
+		return ERR_CHARSET;
+
+	/* The positions have to fit in the ord table. */
+	if (len > 256)
+		return ERR_CHARSET;
+
+	cpy = malloc(len + 1);
+	if (cpy == NULL)
+		return ERR_NOMEM;
+
+	memcpy(cpy, str, len + 1);
 
-	if (len != cs->length)
-		custom_error("cs_add: "
-		             "All the charsets must have the same length");
+	err = ARRAY_APPEND(cs->chars, cpy);
+	if (err != ERR_OK) {
+		free(cpy);
+		return err;
+	}
+
+	/* Like strchr, the first occurence of a character is the one found. */
+	for (i = 0; i < len; i++) {
+		unsigned char c = cpy[i];
+
+		if (cs->row[c] == NULL) {
+			cs->ord[c] = i;
+			cs->row[c] = cpy;
+		}
+	}
 
-	ARRAY_APPEND(cs->chars, cpy);
+	cs->length = len;
+	detect_alpha(cs);
+	return ERR_OK;
 }
 
 
@@ -55,23 +113,22 @@ void cs_add(struct charset *cs, const char *str) {
  */
 int cs_find_char(const struct charset *cs, char c,
                  size_t *stridx, size_t *pos) {
+	const char *row = cs->row[(unsigned char)c];
 	size_t i;
 
-	for (i = 0; i < cs->chars_size; i++) {
-		char *p = strchr(cs->chars[i], c);
+	if (row == NULL)
+		return 0;
 
-		/* Yay, found it! */
-		if (p != NULL) {
-			if (stridx)
-				*stridx = i;
-			if (pos)
-				*pos = p - cs->chars[i];
+	if (pos)
+		*pos = CS_TABLE_ORD(cs, c);
 
-			return 1;
-		}
+	if (stridx) {
+		for (i = 0; cs->chars[i] != row; i++)
+			continue;
+		*stridx = i;
 	}
 
-	return 0;
+	return 1;
 }
 
 
@@ -82,11 +139,7 @@ int cs_find_char(const struct charset *cs, char c,
  * Return -1 if the character is not found.
  */
 int cs_ord(const struct charset *cs, char c) {
-	size_t pos;
-	if (!cs_find_char(cs, c, NULL, &pos))
-		return -1;
-
-	return pos;
+	return CS_TABLE_ORD(cs, c);
 }
 
 
@@ -107,7 +160,7 @@ char cs_chr(const struct charset *cs, size_t pos) {
 
 /* Ask whether a character belong to the charset. Return 1 if yes, 0 if no. */
 int cs_belong(const struct charset *cs, char c) {
-	return cs_find_char(cs, c, NULL, NULL);
+	return cs->row[(unsigned char)c] != NULL;
 }
 
 
@@ -153,23 +206,22 @@ char cs_norm(const struct charset *cs, char c) {
  * other functions of this module.
  */
 char *cs_strpbrk(const struct charset *cs, const char *str) {
-	char *min_pos = NULL;
-	size_t i;
+	return cs_mempbrk(cs, str, strlen(str));
+}
 
-	/*
-	 * Basically, we search the first character that corresponds to one of
-	 * the charset strings.
-	 */
 
-	for (i = 0; i < cs->chars_size; i++) {
-		char *pos = strpbrk(str, cs->chars[i]);
 
-		if (pos == NULL)
-			continue;
+/*
+ * Same as cs_strpbrk but only look at the len first bytes of str, which may
+ * contain nul bytes.
+ */
+char *cs_mempbrk(const struct charset *cs, const char *str, size_t len) {
+	const char *end = str + len;
 
-		if (min_pos == NULL || pos < min_pos)
-			min_pos = pos;
+	for (; str < end; str++) {
+		if (cs->row[(unsigned char)*str] != NULL)
+			return (char *)str;
 	}
 
-	return min_pos;
+	return NULL;
 }
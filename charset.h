@@ -22,21 +22,67 @@
 #define CHARSET_HEX (CHARSET_NUMER "ABCDEF" "abcdef")
 
 
+/*
+ * The charsets made of CHARSET_UPPER and / or CHARSET_LOWER have a fast path
+ * where the lookups are arithmetic on the ASCII ranges. It's only compiled on
+ * ASCII systems, where the two ranges are contiguous and only differ by the
+ * 0x20 bit.
+ */
+#if 'Z' - 'A' == 25 && 'z' - 'a' == 25 && ('a' ^ 'A') == 0x20
+# define CS_HAVE_ALPHA 1
+#else
+# define CS_HAVE_ALPHA 0
+#endif
+
+#define CS_ALPHA_LEN 26
+
+
 struct charset {
 	ARRAY_DECL(char *, chars);
 	size_t length;
+
+	/* Lookup tables kept up to date by cs_add. ord[c] is the position of
+	 * the byte c, or -1 if it doesn't belong to the charset. row[c] is the
+	 * string of chars it has been found in, or NULL. */
+	short ord[256];
+	const char *row[256];
+
+	/* Whether the alpha fast path can be used. Positions are then given
+	 * by CS_ALPHA_ORD. */
+	int alpha;
+	unsigned char alpha_fold;
+	unsigned char alpha_first;
 };
 
 
+/*
+ * Position of the byte c in an alpha charset, or a value >= CS_ALPHA_LEN if it
+ * doesn't belong to it. Setting the case bit makes the ranges A-Z and a-z the
+ * same when both are in the charset.
+ */
+#define CS_ALPHA_ORD(cs, c) \
+	((unsigned)(((unsigned char)(c) | (cs)->alpha_fold) - (cs)->alpha_first))
+
+/* Position of c in any charset, -1 if it doesn't belong to it. */
+#define CS_TABLE_ORD(cs, c) ((cs)->ord[(unsigned char)(c)])
 
-/* Initialize an empty charset. */
-void cs_init(struct charset *cs);
+
+
+/*
+ * Initialize an empty charset.
+ * A charset is never modified by the lookup functions below. Once built, it
+ * can be shared by any number of threads.
+ */
+int cs_init(struct charset *cs);
 
 /* Deinitialize a charset. */
 void cs_fini(struct charset *cs);
 
-/* Add a list of chars to the charset. */
-void cs_add(struct charset *cs, const char *str);
+/*
+ * Add a list of chars to the charset.
+ * Return ERR_CHARSET if its length differ from the previous ones.
+ */
+int cs_add(struct charset *cs, const char *str);
 
 /*
  * Set stridx and pos to be the string index and the position of a character
@@ -79,4 +125,10 @@ char cs_norm(const struct charset *cs, char c);
  */
 char *cs_strpbrk(const struct charset *cs, const char *str);
 
+/*
+ * Same as cs_strpbrk but only look at the len first bytes of str, which may
+ * contain nul bytes.
+ */
+char *cs_mempbrk(const struct charset *cs, const char *str, size_t len);
+
 #endif
@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "array.h"
+#include "io.h"
+#include "checkpoint.h"
+
+
+
+/* 32 bits FNV-1a. */
+#define HASH_BASIS 2166136261UL
+#define HASH_PRIME 16777619UL
+
+/* Longest encoding of an integer, and of the header. */
+#define VARINT_MAX ((sizeof(size_t) * 8 + 6) / 7)
+#define HEADER_MAX (sizeof(CKPT_MAGIC) - 1 + 4 * VARINT_MAX)
+
+/* Room for the suffix of the temporary file written before the rename: a
+ * dot, the process id, a dot, a counter and the nul. */
+#define TMP_SUFFIX_LEN 48
+
+
+
+/* Number of temporary files made by this process so far. */
+static unsigned long ntmp;
+
+
+
+int ckpt_init(struct ckpt *c, enum ckpt_kind kind, unsigned long fingerprint) {
+	memset(c, 0, sizeof(*c));
+	c->kind = kind;
+	c->fingerprint = fingerprint;
+
+	return ARRAY_ALLOC(c->data, 4096);
+}
+
+
+
+void ckpt_fini(struct ckpt *c) {
+	ARRAY_FREE(c->data);
+	memset(c, 0, sizeof(*c));
+}
+
+
+
+void ckpt_clear(struct ckpt *c) {
+	c->data_size = 0;
+	c->pos = 0;
+}
+
+
+
+unsigned long ckpt_hash(unsigned long h, const void *data, size_t len) {
+	const unsigned char *p = data;
+	size_t i;
+
+	/* Starting from the basis keeps the hashes chainable from 0. */
+	h ^= HASH_BASIS;
+	for (i = 0; i < len; i++)
+		h = ((h ^ p[i]) * HASH_PRIME) & 0xffffffffUL;
+
+	return h ^ HASH_BASIS;
+}
+
+
+
+static size_t encode(unsigned char *p, size_t value) {
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		p[n++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	p[n++] = value;
+
+	return n;
+}
+
+
+
+/* Decode the integer at *pos, if it fits in the len bytes of data. */
+static int decode(const unsigned char *data, size_t len, size_t *pos,
+                  size_t *value) {
+	size_t shift = 0;
+	size_t v = 0;
+	unsigned char b;
+
+	do {
+		if (*pos >= len || shift >= sizeof(size_t) * 8)
+			return ERR_FORMAT;
+
+		b = data[(*pos)++];
+		v |= (size_t)(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	*value = v;
+	return ERR_OK;
+}
+
+
+
+int ckpt_put_bytes(struct ckpt *c, const void *data, size_t len) {
+	int err;
+
+	while (c->data_mem - c->data_size < len) {
+		err = ARRAY_GROW(c->data);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	memcpy(c->data + c->data_size, data, len);
+	c->data_size += len;
+	return ERR_OK;
+}
+
+
+
+int ckpt_put(struct ckpt *c, size_t value) {
+	unsigned char buf[VARINT_MAX];
+
+	return ckpt_put_bytes(c, buf, encode(buf, value));
+}
+
+
+
+int ckpt_get(struct ckpt *c, size_t *value) {
+	return decode(c->data, c->data_size, &c->pos, value);
+}
+
+
+
+int ckpt_get_bytes(struct ckpt *c, void *data, size_t len) {
+	if (c->data_size - c->pos < len)
+		return ERR_FORMAT;
+
+	memcpy(data, c->data + c->pos, len);
+	c->pos += len;
+	return ERR_OK;
+}
+
+
+
+static size_t make_header(const struct ckpt *c, unsigned char *p) {
+	size_t n = sizeof(CKPT_MAGIC) - 1;
+
+	memcpy(p, CKPT_MAGIC, n);
+	n += encode(p + n, CKPT_VERSION);
+	n += encode(p + n, c->kind);
+	n += encode(p + n, c->fingerprint);
+	n += encode(p + n, c->data_size);
+
+	return n;
+}
+
+
+
+int ckpt_write(const struct ckpt *c, const char *filename) {
+	unsigned char header[HEADER_MAX];
+	size_t hlen;
+	char *tmp;
+	int err;
+	int fd;
+
+	tmp = malloc(strlen(filename) + TMP_SUFFIX_LEN);
+	if (tmp == NULL)
+		return ERR_NOMEM;
+
+	/* Several writers of the same file, threads or processes, each get
+	 * their own. */
+	sprintf(tmp, "%s.%ld.%lu", filename, (long)getpid(),
+	        __atomic_fetch_add(&ntmp, 1, __ATOMIC_RELAXED));
+
+	err = ERR_IO;
+	fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd == -1)
+		goto out;
+
+	hlen = make_header(c, header);
+	err = io_write_fd(fd, (const char *)header, hlen);
+	if (err == ERR_OK)
+		err = io_write_fd(fd, (const char *)c->data, c->data_size);
+
+	/* The data must be on the disk before the rename is. */
+	if (err == ERR_OK && fsync(fd) == -1)
+		err = ERR_IO;
+
+	if (io_close(fd) == -1 && err == ERR_OK)
+		err = ERR_IO;
+
+	if (err == ERR_OK && rename(tmp, filename) == -1)
+		err = ERR_IO;
+
+	if (err != ERR_OK)
+		unlink(tmp);
+
+out:
+	free(tmp);
+	return err;
+}
+
+
+
+int ckpt_read(struct ckpt *c, const char *filename) {
+	const size_t mlen = sizeof(CKPT_MAGIC) - 1;
+	const unsigned char *data;
+	struct io_buf buf;
+	size_t pos = mlen;
+	size_t version, kind, fingerprint, len;
+	int err;
+
+	err = io_read(&buf, filename);
+	if (err != ERR_OK)
+		return err;
+
+	data = (const unsigned char *)buf.data;
+	err = ERR_FORMAT;
+	if (buf.len < mlen || memcmp(data, CKPT_MAGIC, mlen) != 0)
+		goto out;
+
+	if (decode(data, buf.len, &pos, &version) != ERR_OK ||
+	    decode(data, buf.len, &pos, &kind) != ERR_OK ||
+	    decode(data, buf.len, &pos, &fingerprint) != ERR_OK ||
+	    decode(data, buf.len, &pos, &len) != ERR_OK)
+		goto out;
+
+	if (version != CKPT_VERSION || kind != (size_t)c->kind ||
+	    fingerprint != c->fingerprint || buf.len - pos != len)
+		goto out;
+
+	ckpt_clear(c);
+	err = ckpt_put_bytes(c, data + pos, len);
+
+out:
+	io_release(&buf);
+	return err;
+}
@@ -0,0 +1,97 @@
+#ifndef CHECKPOINT_H__
+#define CHECKPOINT_H__
+
+/*
+ * This module save the state of a long analysis to a file, so that it can be
+ * resumed after a restart instead of starting over.
+ *
+ * The analyses able to resume stop at their deadline, see deadline.h, keeping
+ * track of the work already done. The caller then saves them with their own
+ * *_save function into a struct ckpt, writes it, and runs them again with a
+ * later deadline, which continues where they stopped. On a restart, the file
+ * is read back and given to *_restore before the first run.
+ *
+ * A checkpoint file starts with a magic string, a format version, the kind of
+ * analysis and a fingerprint of its input, all checked when it is read. Then
+ * comes the state itself, as the analysis saved it. The integers are stored
+ * with 7 bits per byte, so that the small ones only take a byte. The file is
+ * written under a temporary name and renamed, so that a crash while saving
+ * leaves the previous checkpoint intact.
+ *
+ * The state of a complete analysis is saved the same way by the cache, see
+ * cache.h.
+ */
+
+
+#include <sys/types.h>
+
+#include "array.h"
+
+
+/* Magic string at the start of a checkpoint file, and format version. */
+#define CKPT_MAGIC "UNVGCKPT"
+#define CKPT_VERSION 1
+
+/* Default number of seconds between two checkpoints. */
+#define CKPT_DEFAULT_INTERVAL 60
+
+
+enum ckpt_kind {
+	CKPT_KASISKI,
+	CKPT_BRUTE,
+	CKPT_DICT,
+	CKPT_IOC,
+	CKPT_FREQ,
+	CKPT_LAST
+};
+
+
+struct ckpt {
+	enum ckpt_kind kind;
+
+	/* Fingerprint of the input of the analysis, see ckpt_hash. A file is
+	 * only read back into a checkpoint with the same one. */
+	unsigned long fingerprint;
+
+	/* The saved state, and the position of the next value to get. */
+	ARRAY_DECL(unsigned char, data);
+	size_t pos;
+};
+
+
+
+/* Initialize an empty checkpoint of an analysis of the given kind. */
+int ckpt_init(struct ckpt *c, enum ckpt_kind kind, unsigned long fingerprint);
+
+/* Deinitialize a checkpoint. */
+void ckpt_fini(struct ckpt *c);
+
+/* Forget the state saved, to save a new one. */
+void ckpt_clear(struct ckpt *c);
+
+/* Return the hash of the len bytes of data combined with the hash h of what
+ * came before. The first h should be 0. */
+unsigned long ckpt_hash(unsigned long h, const void *data, size_t len);
+
+/* Append an integer or len raw bytes to the state. */
+int ckpt_put(struct ckpt *c, size_t value);
+int ckpt_put_bytes(struct ckpt *c, const void *data, size_t len);
+
+/* Read back the next integer or len raw bytes of the state.
+ * Return ERR_FORMAT if there isn't that much left. */
+int ckpt_get(struct ckpt *c, size_t *value);
+int ckpt_get_bytes(struct ckpt *c, void *data, size_t len);
+
+/* Write the checkpoint to a file.
+ * Return ERR_IO with errno set when a system call fails. */
+int ckpt_write(const struct ckpt *c, const char *filename);
+
+/*
+ * Replace the state with the one read from a file.
+ * Return ERR_IO with errno set when a system call fails, and ERR_FORMAT if the
+ * file isn't a checkpoint of the same kind of analysis with the same
+ * fingerprint.
+ */
+int ckpt_read(struct ckpt *c, const char *filename);
+
+#endif
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "getopthelp.h"
+#include "libunvigenere.h"
+#include "misc.h"
+
+
+/*
+ * Client of the server mode of unvigenere, see unvigenere --serve.
+ * Send the input to the server to be encrypted, decrypted or cracked, and
+ * write the result like unvigenere itself would.
+ */
+
+
+enum option_id {
+	OPT_STATS = 256,
+	OPT_LAST
+};
+
+
+static const struct goh_option opt_desc[] = {
+	{"socket", 's', GOH_ARG_REQUIRED, 's',
+		"Unix socket the server listens on."},
+	{"input", 'i', GOH_ARG_REQUIRED, 'i',
+		"Input file. May be - for stdin. Default to stdin."},
+	{"output", 'o', GOH_ARG_REQUIRED, 'o',
+		"Output file. May be - for stdout. Default to stdout."},
+	{"encrypt", 'e', GOH_ARG_REFUSED, 'e',
+		"Encrypt the data with the given key."},
+	{"decrypt", 'd', GOH_ARG_REFUSED, 'd',
+		"Decrypt the data with the given key."},
+	{"key", 'k', GOH_ARG_REQUIRED, 'k',
+		"Key used for encryption / decryption."},
+	{"key-length", 'l', GOH_ARG_REQUIRED, 'l',
+		"Length of the key to crack."},
+	{"stats", '\0', GOH_ARG_REFUSED, OPT_STATS,
+		"Write the statistics of the request measured by the server "
+		"on stderr."}
+};
+
+
+
+int main(int argc, char **argv) {
+	struct goh_state st;
+	struct proto_msg req, resp;
+	struct io_buf text;
+	const char *socketpath = NULL;
+	const char *filenamein = "-";
+	const char *filenameout = "-";
+	const char *key = NULL;
+	enum proto_op op = PROTO_CRACK;
+	size_t klen = 0;
+	int showstats = 0;
+	int opt;
+	int err;
+	int fd;
+
+	goh_init(&st, opt_desc, ARRAY_LENGTH(opt_desc), argc, argv, 1);
+	st.usagehelp = "[options]\n";
+
+	while ((opt = goh_nextoption(&st)) >= 0) {
+		switch (opt) {
+		case 's':
+			socketpath = st.argval;
+			break;
+
+		case 'i':
+			filenamein = st.argval;
+			break;
+
+		case 'o':
+			filenameout = st.argval;
+			break;
+
+		case 'e':
+			op = PROTO_ENCRYPT;
+			break;
+
+		case 'd':
+			op = PROTO_DECRYPT;
+			break;
+
+		case 'k':
+			key = st.argval;
+			break;
+
+		case 'l':
+			klen = atoi(st.argval);
+			break;
+
+		case OPT_STATS:
+			showstats = 1;
+			break;
+
+		default:
+			custom_error("Unrecognized option (shouldn't happen)");
+			break;
+		}
+	}
+
+	if (st.argidx != argc)
+		custom_error("Useless argument %s", argv[st.argidx]);
+
+	goh_fini(&st);
+
+	if (socketpath == NULL)
+		custom_error("The --socket of the server is needed");
+
+	if (op != PROTO_CRACK && key == NULL)
+		custom_error("Encryption and decryption take a --key");
+
+	if (op == PROTO_CRACK && key != NULL)
+		custom_error("--key need either --encrypt or --decrypt");
+
+	if (op != PROTO_CRACK && klen != 0)
+		custom_error("--key-length can only be used in cracking mode");
+
+	err = io_read(&text, filenamein);
+	if (err == ERR_IO)
+		system_error(filenamein);
+	check(err, filenamein);
+
+	err = proto_connect(socketpath, &fd);
+	if (err == ERR_INVAL)
+		custom_error("%s: Path too long for a socket", socketpath);
+	if (err == ERR_IO)
+		system_error(socketpath);
+
+	proto_init(&req);
+	req.op = op;
+	req.param = klen;
+	req.key = key;
+	req.key_len = key != NULL ? strlen(key) : 0;
+	req.text = text.data;
+	req.text_len = text.len;
+
+	err = proto_write(fd, &req);
+	if (err == ERR_IO)
+		system_error(socketpath);
+	check(err, "Request");
+
+	proto_init(&resp);
+	err = proto_read(fd, &resp);
+	if (err == ERR_IO)
+		system_error(socketpath);
+	if (err == ERR_OK && resp.closed)
+		custom_error("%s: The server closed the connection",
+		             socketpath);
+	check(err, "Response");
+	io_close(fd);
+
+	if (showstats)
+		fwrite(resp.stats, 1, resp.stats_len, stderr);
+
+	if (resp.op >= ERR_LAST)
+		custom_error("Server: Unknown error %lu", resp.op);
+	check(resp.op, "Server");
+
+	if (op == PROTO_CRACK && resp.param)
+		custom_warn("Time budget exceeded, the key is the best one "
+		            "found in time");
+	if (op == PROTO_CRACK)
+		printf("Found key: %.*s\n", (int)resp.key_len, resp.key);
+
+	/* io_write doesn't go through stdio, keep the messages first. */
+	fflush(stdout);
+
+	err = io_write(filenameout, resp.text, resp.text_len);
+	if (err == ERR_IO)
+		system_error(filenameout);
+	check(err, filenameout);
+
+	proto_fini(&resp);
+	io_release(&text);
+
+	return EXIT_SUCCESS;
+}
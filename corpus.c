@@ -0,0 +1,81 @@
+#include <stddef.h>
+
+#include "corpus.h"
+
+
+
+/*
+ * Mostly opening paragraphs of a few public domain novels. Each string stays
+ * below the 509 characters an ANSI C compiler has to support.
+ */
+const char *const corpus_en[] = {
+	"It is a truth universally acknowledged, that a single man in "
+	"possession of a good fortune, must be in want of a wife. However "
+	"little known the feelings or views of such a man may be on his "
+	"first entering a neighbourhood, this truth is so well fixed in the "
+	"minds of the surrounding families, that he is considered the "
+	"rightful property of some one or other of their daughters.",
+	"My dear Mr. Bennet, said his lady to him one day, have you heard "
+	"that Netherfield Park is let at last? Mr. Bennet replied that he "
+	"had not. But it is, returned she; for Mrs. Long has just been "
+	"here, and she told me all about it. Mr. Bennet made no answer. Do "
+	"you not want to know who has taken it? cried his wife impatiently. "
+	"You want to tell me, and I have no objection to hearing it.",
+	"Call me Ishmael. Some years ago, never mind how long precisely, "
+	"having little or no money in my purse, and nothing particular to "
+	"interest me on shore, I thought I would sail about a little and "
+	"see the watery part of the world. It is a way I have of driving "
+	"off the spleen and regulating the circulation.",
+	"Whenever I find myself growing grim about the mouth; whenever it "
+	"is a damp, drizzly November in my soul; whenever I find myself "
+	"involuntarily pausing before coffin warehouses, and bringing up "
+	"the rear of every funeral I meet; then, I account it high time to "
+	"get to sea as soon as I can. This is my substitute for pistol and "
+	"ball.",
+	"Alice was beginning to get very tired of sitting by her sister on "
+	"the bank, and of having nothing to do: once or twice she had "
+	"peeped into the book her sister was reading, but it had no "
+	"pictures or conversations in it, and what is the use of a book, "
+	"thought Alice, without pictures or conversations?",
+	"So she was considering in her own mind, as well as she could, for "
+	"the hot day made her feel very sleepy and stupid, whether the "
+	"pleasure of making a daisy chain would be worth the trouble of "
+	"getting up and picking the daisies, when suddenly a White Rabbit "
+	"with pink eyes ran close by her.",
+	"It was the best of times, it was the worst of times, it was the "
+	"age of wisdom, it was the age of foolishness, it was the epoch of "
+	"belief, it was the epoch of incredulity, it was the season of "
+	"Light, it was the season of Darkness, it was the spring of hope, "
+	"it was the winter of despair.",
+	"We had everything before us, we had nothing before us, we were all "
+	"going direct to Heaven, we were all going direct the other way. In "
+	"short, the period was so far like the present period, that some of "
+	"its noisiest authorities insisted on its being received, for good "
+	"or for evil, in the superlative degree of comparison only.",
+	"In my younger and more vulnerable years my father gave me some "
+	"advice that I have been turning over in my mind ever since. "
+	"Whenever you feel like criticizing any one, he told me, just "
+	"remember that all the people in this world have not had the "
+	"advantages that you have had.",
+	"Happy families are all alike; every unhappy family is unhappy in "
+	"its own way. Everything was in confusion in the house. The wife had "
+	"discovered that the husband was carrying on an intrigue with a "
+	"French girl, who had been a governess in their family.",
+	"There was no possibility of taking a walk that day. We had been "
+	"wandering, indeed, in the leafless shrubbery an hour in the "
+	"morning; but since dinner the cold winter wind had brought with it "
+	"clouds so sombre, and a rain so penetrating, that further outdoor "
+	"exercise was now out of the question.",
+	"Mr. Sherlock Holmes, who was usually very late in the mornings, "
+	"save upon those not infrequent occasions when he was up all night, "
+	"was seated at the breakfast table. I stood upon the hearth rug and "
+	"picked up the stick which our visitor had left behind him the "
+	"night before.",
+	"The quick brown fox jumps over the lazy dog while the village "
+	"watched from behind their windows. Messages were carried from town "
+	"to town by riders who knew every road, every river and every "
+	"bridge between the mountains and the sea, and who never asked what "
+	"was written in the letters they carried."
+};
+
+const size_t corpus_en_count = sizeof(corpus_en) / sizeof(*corpus_en);
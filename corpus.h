@@ -0,0 +1,14 @@
+#ifndef CORPUS_H__
+#define CORPUS_H__
+
+/*
+ * A small sample of English text to build language models from.
+ */
+
+#include <sys/types.h>
+
+
+extern const char *const corpus_en[];
+extern const size_t corpus_en_count;
+
+#endif
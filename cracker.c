@@ -3,70 +3,264 @@
 #include <sys/types.h>
 #include <assert.h>
 
-#include "misc.h"
+#include "error.h"
 #include "filtered_string.h"
 #include "mfreq_analysis.h"
 #include "kasiski.h"
+#include "ioc.h"
+#include "beam.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "deadline.h"
+#include "checkpoint.h"
+#include "cache.h"
 #include "cracker.h"
 
 
 
+static const char *const estimator_names[CK_EST_LAST] = {
+	"kasiski",
+	"ioc"
+};
+
+
+
 /* Initialize a struct cracker. */
-void ck_init(struct cracker *state, struct fs_ctx *str) {
+void ck_init(struct cracker *state, const struct fs_ctx *str) {
 	memset(state, 0, sizeof(*state));
 	state->str = str;
+	arena_init(&state->arena, 0);
 
+	state->estimator = CK_EST_KASISKI;
 	state->ka_minlen = 3;
+	state->ioc_maxlen = IOC_DEFAULT_MAXLEN;
+	state->beam_ntop = 1;
 }
 
 
 
-/* Free everything one of the ck_* function allocated */
-void ck_fini(struct cracker *state) {
-	if (state->key != NULL)
-		free(state->key);
-
+/* Free the results of the analyses, but keep the settings. */
+static void release_results(struct cracker *state) {
 	if (state->ka_done)
 		ka_fini(&state->ka);
 
+	if (state->ioc_done)
+		ioc_fini(&state->ioc);
+
+	if (state->beam_done)
+		beam_fini(&state->beam);
+
 	if (state->mfa_done)
 		mfa_fini(&state->mfa);
 
+	state->key = NULL;
+	state->klen = 0;
+	state->ka_done = 0;
+	state->ioc_done = 0;
+	state->mfa_done = 0;
+	state->beam_done = 0;
+	state->expired = 0;
+}
+
+
+
+/* Free everything one of the ck_* function allocated */
+void ck_fini(struct cracker *state) {
+	release_results(state);
+	arena_fini(&state->arena);
 	memset(state, 0, sizeof(*state));
 }
 
 
 
-void ck_set_length(struct cracker *state, size_t len) {
+/* Forget everything about the previous text. */
+void ck_reset(struct cracker *state) {
+	release_results(state);
+	arena_reset(&state->arena);
+	state->str = NULL;
+}
+
+
+
+void ck_set_text(struct cracker *state, const struct fs_ctx *str) {
+	state->str = str;
+}
+
+
+
+int ck_set_length(struct cracker *state, size_t len) {
+	char *key;
+
+	if (len == 0)
+		return ERR_INVAL;
+
+	key = arena_alloc(&state->arena, (len + 1) * sizeof(*key));
+	if (key == NULL)
+		return ERR_NOMEM;
+
+	memset(key, 0, (len + 1) * sizeof(*key));
+
+	state->key = key;
 	state->klen = len;
+	return ERR_OK;
+}
+
+
+
+const char *ck_estimator_name(enum ck_estimator est) {
+	if (est >= CK_EST_LAST)
+		return NULL;
+
+	return estimator_names[est];
+}
+
+
 
-	if (state->key != NULL)
-		free(state->key);
+enum ck_estimator ck_estimator_from_name(const char *name) {
+	size_t i;
+
+	for (i = 0; i < CK_EST_LAST; i++) {
+		if (strcmp(estimator_names[i], name) == 0)
+			return i;
+	}
+
+	return CK_EST_LAST;
+}
+
+
+
+/* Restore the result of an analysis from the cache. Return whether it was
+ * there. */
+static int cache_get(struct cracker *state, enum ckpt_kind kind, size_t param) {
+	struct ckpt c;
+	int err;
+
+	if (state->cache == NULL)
+		return 0;
 
-	state->key = malloc((len + 1) * sizeof(*state->key));
-	if (state->key == NULL)
-		system_error("malloc");
+	err = ckpt_init(&c, kind, state->cache->hash);
+	if (err == ERR_OK)
+		err = cache_load(state->cache, &c, param);
 
-	memset(state->key, 0, (len + 1) * sizeof(*state->key));
+	if (err == ERR_OK) {
+		switch (kind) {
+		case CKPT_KASISKI:
+			err = ka_restore(&state->ka, &c);
+			break;
+
+		case CKPT_IOC:
+			err = ioc_restore(&state->ioc, &c);
+			break;
+
+		default:
+			err = mfa_restore(&state->mfa, &c);
+			break;
+		}
+	}
+
+	ckpt_fini(&c);
+
+	/* A missing or stale result is just computed again. */
+	return err == ERR_OK;
 }
 
 
 
-void ck_length(struct cracker *state) {
+/* Store the result of an analysis in the cache. */
+static void cache_put(struct cracker *state, enum ckpt_kind kind,
+                      size_t param) {
+	struct ckpt c;
+	int err;
+
+	if (state->cache == NULL)
+		return;
+
+	err = ckpt_init(&c, kind, state->cache->hash);
+	if (err == ERR_OK) {
+		switch (kind) {
+		case CKPT_KASISKI:
+			err = ka_save(&state->ka, &c);
+			break;
+
+		case CKPT_IOC:
+			err = ioc_save(&state->ioc, &c);
+			break;
+
+		default:
+			err = mfa_save(&state->mfa, &c);
+			break;
+		}
+	}
+
+	if (err == ERR_OK)
+		err = cache_store(state->cache, &c, param);
+
+	ckpt_fini(&c);
+
+	if (err != ERR_OK)
+		state->cache_err = err;
+}
+
+
+
+static int length_kasiski(struct cracker *state) {
 	size_t i, nlen;
 	size_t bestlength, bestscore;
+	int cached;
+	int err;
 
-	nlen = strlen(state->str->norm);
-	if (nlen < 3)
-		custom_error("Can't break key length of a text with only %lu "
-		             "signficant characters", nlen);
+	nlen = state->str->nlen;
 
 	/* Restart the kasiski analysis if specifically asked to. */
 	if (state->ka_done)
 		ka_fini(&state->ka);
+	state->ka_done = 0;
+
+	err = ka_init(&state->ka, state->str->norm, nlen, state->ka_minlen,
+	              &state->arena);
+	if (err != ERR_OK)
+		return err;
+
+	state->ka.trace = state->trace;
+
+	/* A complete analysis restored has no offset left to analyze. */
+	cached = cache_get(state, CKPT_KASISKI, state->ka_minlen);
+
+	if (!cached && state->ka_ckpt != NULL &&
+	    state->ka_ckpt->data_size > 0) {
+		err = ka_restore(&state->ka, state->ka_ckpt);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	/* Stop every ckpt_interval seconds to save the progress. */
+	for (;;) {
+		state->ka.deadline = state->deadline;
+		if (state->ckpt_file != NULL) {
+			double d = deadline_after(state->ckpt_interval);
+			if (state->deadline == 0 || d < state->deadline)
+				state->ka.deadline = d;
+		}
 
-	ka_init(&state->ka, state->str->norm, state->ka_minlen);
-	ka_analyze(&state->ka);
+		ka_analyze(&state->ka);
+
+		if (state->ka.expired && state->ckpt_file != NULL) {
+			ckpt_clear(state->ka_ckpt);
+			err = ka_save(&state->ka, state->ka_ckpt);
+			if (err == ERR_OK)
+				err = ckpt_write(state->ka_ckpt, state->ckpt_file);
+			if (err != ERR_OK)
+				return err;
+		}
+
+		if (!state->ka.expired || deadline_passed(state->deadline))
+			break;
+	}
+	state->expired |= state->ka.expired;
+
+	if (!cached && !state->ka.expired)
+		cache_put(state, CKPT_KASISKI, state->ka_minlen);
 
 	bestlength = 2;
 	bestscore = state->ka.score[bestlength];
@@ -79,8 +273,131 @@ void ck_length(struct cracker *state) {
 		}
 	}
 
-	ck_set_length(state, bestlength);
 	state->ka_done = 1;
+	return ck_set_length(state, bestlength);
+}
+
+
+
+static int length_ioc(struct cracker *state) {
+	int err;
+
+	if (state->ioc_done)
+		ioc_fini(&state->ioc);
+	state->ioc_done = 0;
+
+	err = ioc_init(&state->ioc, state->str->norm, state->str->nlen,
+	               state->ioc_maxlen, state->str->charset, &state->arena);
+	if (err != ERR_OK)
+		return err;
+
+	state->ioc_done = 1;
+	state->ioc.deadline = state->deadline;
+
+	if (!cache_get(state, CKPT_IOC, state->ioc.maxlen)) {
+		err = ioc_analyze(&state->ioc);
+		if (err != ERR_OK)
+			return err;
+
+		state->expired |= state->ioc.expired;
+		if (!state->ioc.expired)
+			cache_put(state, CKPT_IOC, state->ioc.maxlen);
+	}
+
+	return ck_set_length(state, ioc_best_length(&state->ioc));
+}
+
+
+
+int ck_length(struct cracker *state) {
+	double t;
+	int err;
+
+	if (state->str->nlen < 3)
+		return ERR_TOOSHORT;
+
+	stats_begin(state->stats, &state->arena);
+	t = trace_begin(state->trace);
+
+	switch (state->estimator) {
+	case CK_EST_KASISKI:
+		err = length_kasiski(state);
+		trace_end(state->trace, t, "kasiski", NULL, state->klen);
+		stats_end(state->stats, STATS_KASISKI, state->str->nlen);
+		return err;
+
+	case CK_EST_IOC:
+		err = length_ioc(state);
+		trace_end(state->trace, t, "ioc", NULL, state->klen);
+		stats_end(state->stats, STATS_IOC, state->str->nlen);
+		return err;
+
+	default:
+		return ERR_INVAL;
+	}
+}
+
+
+
+/* Sift idx[root] down a heap of n indexes whose root has the lowest score. */
+static void sift_down(size_t *idx, size_t root, size_t n, const size_t *score) {
+	for (;;) {
+		size_t child = 2 * root + 1;
+		size_t tmp;
+
+		if (child >= n)
+			return;
+
+		/* The root of the heap hold the lowest score. */
+		if (child + 1 < n && score[idx[child + 1]] < score[idx[child]])
+			child++;
+
+		if (score[idx[root]] <= score[idx[child]])
+			return;
+
+		tmp = idx[root];
+		idx[root] = idx[child];
+		idx[child] = tmp;
+		root = child;
+	}
+}
+
+
+
+int ck_ka_lengths(const struct cracker *state, size_t **lengths,
+                  size_t *count) {
+	size_t *idx;
+	size_t i, n;
+	const size_t *score;
+
+	if (!state->ka_done)
+		return ERR_NOLENGTH;
+
+	n = state->ka.str_len;
+	score = state->ka.score;
+
+	idx = malloc(n * sizeof(*idx));
+	if (idx == NULL)
+		return ERR_NOMEM;
+
+	for (i = 0; i < n; i++)
+		idx[i] = i;
+
+	/* Heap sort by decreasing score. Unlike qsort, it doesn't need the
+	 * score table to be put in a global variable. */
+	for (i = n / 2; i-- > 0;)
+		sift_down(idx, i, n, score);
+
+	for (i = n; i-- > 1;) {
+		size_t tmp = idx[0];
+		idx[0] = idx[i];
+		idx[i] = tmp;
+		sift_down(idx, 0, i, score);
+	}
+
+	*lengths = idx;
+	*count = n;
+	return ERR_OK;
 }
 
 
@@ -102,28 +419,100 @@ static void key_from_mfa_shift(struct cracker *state) {
 
 
 
-void ck_freq(struct cracker *state) {
+int ck_freq(struct cracker *state) {
+	double t;
+	int err;
+
 	if (state->klen == 0)
-		custom_error("Call either ck_length or ck_set_length "
-		             "before calling ck_freq.");
+		return ERR_NOLENGTH;
 
 	/* Restart the multi-freq analysis if specifically asked to. */
 	if (state->mfa_done)
 		mfa_fini(&state->mfa);
+	state->mfa_done = 0;
+
+	stats_begin(state->stats, &state->arena);
+	t = trace_begin(state->trace);
+
+	err = mfa_init(&state->mfa, state->str->norm, state->str->nlen,
+	               state->klen, state->str->charset, freq_en,
+	               &state->arena);
+	if (err == ERR_OK) {
+		int cached = cache_get(state, CKPT_FREQ, state->klen);
+
+		state->mfa_done = 1;
+		state->mfa.trace = state->trace;
+		state->mfa.deadline = state->deadline;
+		err = mfa_analyze(&state->mfa);
+		state->expired |= state->mfa.expired;
+
+		if (err == ERR_OK && !cached && !state->mfa.expired)
+			cache_put(state, CKPT_FREQ, state->klen);
+	}
 
-	mfa_init(&state->mfa, state->str->norm, state->klen, state->str->charset, freq_en);
-	state->mfa_done = 1;
+	trace_end(state->trace, t, "freq", NULL, state->klen);
+	stats_end(state->stats, STATS_FREQ, state->str->nlen);
+
+	if (err != ERR_OK)
+		return err;
 
-	mfa_analyze(&state->mfa);
 	key_from_mfa_shift(state);
+
+	if (state->beam_width != 0)
+		return ck_beam(state);
+
+	return ERR_OK;
 }
 
 
 
-void ck_crack(struct cracker *state) {
-	if (state->klen == 0)
-		ck_length(state);
+int ck_beam(struct cracker *state) {
+	double t;
+	int err;
 
 	if (!state->mfa_done)
-		ck_freq(state);
+		return ERR_NOLENGTH;
+
+	if (state->beam_done)
+		beam_fini(&state->beam);
+	state->beam_done = 0;
+
+	stats_begin(state->stats, &state->arena);
+	t = trace_begin(state->trace);
+
+	err = beam_init(&state->beam, &state->mfa, &state->arena);
+	if (err == ERR_OK) {
+		state->beam_done = 1;
+		state->beam.width = state->beam_width;
+		state->beam.ntop = state->beam_ntop;
+		state->beam.deadline = state->deadline;
+		err = beam_search(&state->beam);
+		state->expired |= state->beam.expired;
+	}
+
+	trace_end(state->trace, t, "beam", NULL, state->klen);
+	stats_end(state->stats, STATS_BEAM, state->str->nlen);
+
+	if (err != ERR_OK)
+		return err;
+
+	memcpy(state->key, beam_key(&state->beam, 0), state->klen);
+	return ERR_OK;
+}
+
+
+
+int ck_crack(struct cracker *state) {
+	int err;
+
+	if (state->klen == 0) {
+		err = ck_length(state);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	if (!state->mfa_done)
+		return ck_freq(state);
+
+	return ERR_OK;
 }
@@ -6,16 +6,29 @@
  * Namely, it curently uses:
  * - Multi-frequency-analysis
  * - Kasiski analysis
+ * - Index of coincidence analysis
+ * - Beam search over the best shifts of every column (optional)
  *
  * And will use:
  * - Friedman test
- * - Index of coincidence analysis
  * - Wordlist attack
  * - Autocorrelation (with or without a FFT)
  * - Fourier Transform variation for text
  *
  * This module's API (will) also give access various statistics about the text
  * being cracked.
+ *
+ * A struct cracker only references its own data and the text it works on.
+ * Several crackers may thus run concurrently in different threads, and a
+ * single one may be reused for several texts with ck_reset.
+ *
+ * All the scratch memory of the analyses is taken from the cracker's arena.
+ * It is recycled by ck_reset instead of being freed, which makes a batch of
+ * short messages cheap to crack with the same struct cracker:
+ *   ck_reset(&ck);
+ *   fs_init(&s, text, len, &cs, &ck.arena);
+ *   ck_set_text(&ck, &s);
+ *   ck_crack(&ck);
  */
 
 #include <sys/types.h>
@@ -23,6 +36,22 @@
 #include "filtered_string.h"
 #include "mfreq_analysis.h"
 #include "kasiski.h"
+#include "ioc.h"
+#include "beam.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "cache.h"
+
+
+
+/* The methods available to find the key length. */
+enum ck_estimator {
+	CK_EST_KASISKI,
+	CK_EST_IOC,
+	CK_EST_LAST
+};
 
 
 
@@ -31,35 +60,122 @@ struct cracker {
 	size_t klen;
 	char *key;
 
+	/* Method used by ck_length. Default to CK_EST_KASISKI. */
+	enum ck_estimator estimator;
+
 	/* Argument to be given to ka_init */
 	size_t ka_minlen;
 
+	/* Argument to be given to ioc_init */
+	size_t ioc_maxlen;
+
 	struct kasiski ka;
 	int ka_done;
 
+	struct ioc ioc;
+	int ioc_done;
+
 	struct mfreq mfa;
 	int mfa_done;
+
+	/* Width of the beam search refining the frequency analysis, 0 to skip
+	 * it, which is the default. And the number of keys it keeps. */
+	size_t beam_width;
+	size_t beam_ntop;
+
+	struct beam beam;
+	int beam_done;
+
+	struct arena arena;
+
+	/* Where to record the cost of the analyses. NULL by default. */
+	struct stats *stats;
+
+	/* Where to trace the analyses. NULL by default. */
+	struct trace_buf *trace;
+
+	/* When the analyses must stop, see deadline.h. 0 by default. expired is
+	 * set when one of them stopped early, the key is then the best one
+	 * found in time. */
+	double deadline;
+	int expired;
+
+	/* Checkpoint of the Kasiski analysis, of kind CKPT_KASISKI. NULL by
+	 * default. If it holds a state, the analysis resumes from it. If
+	 * ckpt_file isn't NULL, neither must ka_ckpt be, and the state is saved
+	 * to that file every ckpt_interval seconds and when the deadline
+	 * passes. */
+	struct ckpt *ka_ckpt;
+	const char *ckpt_file;
+	double ckpt_interval;
+
+	/* Where to look for the Kasiski scores, the indexes of coincidence and
+	 * the column frequencies before computing them, and to store them
+	 * after. NULL by default. The analyses cut short by the deadline are
+	 * not stored. */
+	const struct cache *cache;
+
+	/* Error of the last store to the cache that failed, ERR_OK if none.
+	 * The analyses go on without it. */
+	int cache_err;
 };
 
 
 
 /*
- * Initialize a struct cracker. */
-void ck_init(struct cracker *state, struct fs_ctx *str);
+ * Initialize a struct cracker. str may be NULL and be given later with
+ * ck_set_text. */
+void ck_init(struct cracker *state, const struct fs_ctx *str);
 
 /* Free everything one of the ck_* function allocated. */
 void ck_fini(struct cracker *state);
 
+/*
+ * Drop the results computed for the previous text and recycle the arena.
+ * Anything allocated in the arena becomes invalid. The settings like
+ * ka_minlen are kept.
+ */
+void ck_reset(struct cracker *state);
+
+/* Set the text to work on. */
+void ck_set_text(struct cracker *state, const struct fs_ctx *str);
+
 /* Set the key length. */
-void ck_set_length(struct cracker *state, size_t len);
+int ck_set_length(struct cracker *state, size_t len);
+
+/* Return the name of an estimator, or NULL if it doesn't exist. */
+const char *ck_estimator_name(enum ck_estimator est);
+
+/* Return the estimator with the given name, or CK_EST_LAST if none. */
+enum ck_estimator ck_estimator_from_name(const char *name);
+
+/*
+ * Crack the key length with the selected estimator.
+ * Return ERR_TOOSHORT if the text has less than 3 significant characters.
+ */
+int ck_length(struct cracker *state);
 
-/* Crack the key length. */
-void ck_length(struct cracker *state);
+/*
+ * Crack the password using frequency analysis.
+ * Return ERR_NOLENGTH if the key length hasn't been set or cracked before.
+ */
+int ck_freq(struct cracker *state);
 
-/* Crack the password using frequency analysis. */
-void ck_freq(struct cracker *state);
+/*
+ * Refine the key of the frequency analysis with a beam search. Called by
+ * ck_freq when beam_width is set.
+ * Return ERR_NOLENGTH if the frequency analysis hasn't been done before.
+ */
+int ck_beam(struct cracker *state);
 
 /* Crack the Vigenère cipher using all the implemented techniques. */
-void ck_crack(struct cracker *state);
+int ck_crack(struct cracker *state);
+
+/*
+ * Build a table of the key lengths sorted by decreasing Kasiski score.
+ * *lengths must be freed with free(). Only available after ck_length.
+ */
+int ck_ka_lengths(const struct cracker *state, size_t **lengths,
+                  size_t *count);
 
 #endif
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "array.h"
+#include "charset.h"
+#include "arena.h"
+#include "crib.h"
+
+
+
+int crib_init(struct crib *cr, const char *str, size_t len, const char *crib,
+              const struct charset *charset, struct arena *arena) {
+	size_t i, n;
+
+	memset(cr, 0, sizeof(*cr));
+	cr->str = str;
+	cr->str_len = len;
+	cr->charset = charset;
+	cr->minchecks = CRIB_DEFAULT_CHECKS;
+	cr->arena = arena;
+
+	n = 0;
+	for (i = 0; crib[i] != '\0'; i++)
+		n += cs_belong(charset, crib[i]);
+
+	if (n == 0)
+		return ERR_INVAL;
+
+	cr->crib = arena_alloc(arena, n);
+	if (cr->crib == NULL)
+		return ERR_NOMEM;
+
+	for (i = 0; crib[i] != '\0'; i++) {
+		if (cs_belong(charset, crib[i]))
+			cr->crib[cr->crib_len++] = CS_TABLE_ORD(charset, crib[i]);
+	}
+
+	return ERR_OK;
+}
+
+
+
+void crib_fini(struct crib *cr) {
+	size_t i;
+
+	for (i = 0; i < cr->hits_size; i++)
+		arena_free(cr->arena, cr->hits[i].key);
+
+	if (cr->hits != NULL)
+		ARRAY_FREE(cr->hits);
+
+	arena_free(cr->arena, cr->crib);
+	memset(cr, 0, sizeof(*cr));
+}
+
+
+
+/* diff[i] = ord[i] - ord[i + klen] modulo n, for the len - klen first i. */
+static void period_diff(unsigned char *diff, const unsigned char *ord,
+                        size_t len, size_t klen, size_t n) {
+	size_t i;
+
+	for (i = 0; i + klen < len; i++) {
+		unsigned d = ord[i] + n - ord[i + klen];
+		diff[i] = d >= n ? d - n : d;
+	}
+}
+
+
+
+/* Record the key implied by the crib at position pos. */
+static int add_hit(struct crib *cr, const unsigned char *ord, size_t pos,
+                   size_t klen) {
+	const struct charset *cs = cr->charset;
+	size_t n = cs->length;
+	struct crib_hit hit;
+	size_t j;
+	int err;
+
+	hit.pos = pos;
+	hit.klen = klen;
+	hit.key = arena_alloc(cr->arena, klen + 1);
+	if (hit.key == NULL)
+		return ERR_NOMEM;
+
+	/* The crib is at least klen long, every key character is known. */
+	for (j = 0; j < klen; j++) {
+		unsigned k = ord[pos + j] + n - cr->crib[j];
+		hit.key[(pos + j) % klen] = cs_chr(cs, k >= n ? k - n : k);
+	}
+	hit.key[klen] = '\0';
+
+	if (cr->hits == NULL) {
+		err = ARRAY_ALLOC(cr->hits, 16);
+		if (err != ERR_OK) {
+			arena_free(cr->arena, hit.key);
+			return err;
+		}
+	}
+
+	err = ARRAY_APPEND(cr->hits, hit);
+	if (err != ERR_OK)
+		arena_free(cr->arena, hit.key);
+
+	return err;
+}
+
+
+
+int crib_analyze(struct crib *cr) {
+	const struct charset *cs = cr->charset;
+	size_t m = cr->crib_len;
+	size_t npos, minlen, maxlen;
+	unsigned char *ord, *diff, *cdiff;
+	char *found;
+	size_t klen, i;
+	int err = ERR_OK;
+
+	if (m <= cr->minchecks)
+		return ERR_TOOSHORT;
+
+	/* A key length needs minchecks characters of the crib found again one
+	 * period later. */
+	minlen = 1;
+	maxlen = m - cr->minchecks;
+	if (cr->klen != 0 && cr->klen > maxlen)
+		return ERR_TOOSHORT;
+
+	if (cr->klen != 0)
+		minlen = maxlen = cr->klen;
+
+	if (cr->str_len < m)
+		return ERR_OK;
+
+	npos = cr->str_len - m + 1;
+
+	ord = arena_alloc(cr->arena, cr->str_len);
+	diff = arena_alloc(cr->arena, cr->str_len);
+	cdiff = arena_alloc(cr->arena, m);
+	found = arena_alloc(cr->arena, npos);
+	if (ord == NULL || diff == NULL || cdiff == NULL || found == NULL) {
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < cr->str_len; i++)
+		ord[i] = CS_TABLE_ORD(cs, cr->str[i]);
+
+	memset(found, 0, npos);
+
+	for (klen = minlen; klen <= maxlen; klen++) {
+		size_t nchecks = m - klen;
+
+		period_diff(diff, ord, cr->str_len, klen, cs->length);
+		period_diff(cdiff, cr->crib, m, klen, cs->length);
+
+		for (i = 0; i < npos; i++) {
+			if (found[i] || diff[i] != cdiff[0] ||
+			    memcmp(diff + i, cdiff, nchecks) != 0)
+				continue;
+
+			/* Multiples of klen would match as well. */
+			found[i] = 1;
+			err = add_hit(cr, ord, i, klen);
+			if (err != ERR_OK)
+				goto out;
+		}
+	}
+
+out:
+	arena_free(cr->arena, found);
+	arena_free(cr->arena, cdiff);
+	arena_free(cr->arena, diff);
+	arena_free(cr->arena, ord);
+	return err;
+}
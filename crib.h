@@ -0,0 +1,93 @@
+#ifndef CRIB_H__
+#define CRIB_H__
+
+/*
+ * This module recover the key from a known fragment of the plaintext, the
+ * crib. At every position of the ciphertext, the crib imply a key fragment:
+ * the difference between the ciphertext and the crib. The crib can only be
+ * there if this fragment repeat itself with the period of the key, which is
+ * then known as soon as the crib is longer than the key.
+ *
+ * Two key characters one period apart are equal exactly when the difference
+ * between the two ciphertext characters equal the difference between the two
+ * crib characters. So for every period, the differences are computed once for
+ * the whole text and the crib is searched among them with memcmp.
+ *
+ * Positions are counted in the filtered text, the characters out of the
+ * charset being ignored both in the text and the crib.
+ */
+
+
+#include <sys/types.h>
+
+#include "array.h"
+#include "charset.h"
+#include "arena.h"
+
+
+/*
+ * Number of key characters that must be found twice for a position to be
+ * reported. Every check has a chance of one in the charset length to succeed
+ * by accident.
+ */
+#define CRIB_DEFAULT_CHECKS 4
+
+
+
+struct crib_hit {
+	/* Position of the crib in the filtered text. */
+	size_t pos;
+
+	/* Shortest period of the implied key. */
+	size_t klen;
+
+	/* Key of length klen, nul-terminated, aligned on the start of the
+	 * text. */
+	char *key;
+};
+
+
+
+struct crib {
+	const char *str;
+	size_t str_len;
+	const struct charset *charset;
+
+	/* Positions in the charset of the filtered crib. */
+	unsigned char *crib;
+	size_t crib_len;
+
+	/* Only test this key length if not 0. */
+	size_t klen;
+
+	/* Key characters checked twice to accept a position. */
+	size_t minchecks;
+
+	/* Filled by crib_analyze, by increasing key length then position.
+	 * A position is only reported with its shortest key length. */
+	ARRAY_DECL(struct crib_hit, hits);
+
+	struct arena *arena;
+};
+
+
+
+/*
+ * Initialize a struct crib to look for crib in the len bytes of the filtered
+ * text str. arena may be NULL to use malloc.
+ * Return ERR_INVAL if the crib has no character from the charset.
+ */
+int crib_init(struct crib *cr, const char *str, size_t len, const char *crib,
+              const struct charset *charset, struct arena *arena);
+
+/* Deinitialize a struct crib. */
+void crib_fini(struct crib *cr);
+
+/*
+ * Find every position where the crib imply a periodic key.
+ * Return ERR_TOOSHORT if the crib is too short to check minchecks key
+ * characters for any key length tested.
+ */
+int crib_analyze(struct crib *cr);
+
+#endif
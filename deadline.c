@@ -0,0 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include "deadline.h"
+
+
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+double deadline_after(double seconds) {
+	return now() + seconds;
+}
+
+
+
+int deadline_passed(double deadline) {
+	return deadline != 0 && now() >= deadline;
+}
@@ -0,0 +1,19 @@
+#ifndef DEADLINE_H__
+#define DEADLINE_H__
+
+/*
+ * This module bound the time taken by the analyses.
+ * A deadline is a time of the monotonic clock, in seconds, or 0 for none. The
+ * long loops check it every so often and stop early once it passed, keeping
+ * what they computed so far. They then set their expired flag so that the
+ * caller knows the results are only the best found in time.
+ */
+
+
+/* Return the deadline seconds from now. */
+double deadline_after(double seconds);
+
+/* Tell whether the deadline passed. Never true for a deadline of 0. */
+int deadline_passed(double deadline);
+
+#endif
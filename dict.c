@@ -0,0 +1,638 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "mfreq_analysis.h"
+#include "arena.h"
+#include "deadline.h"
+#include "checkpoint.h"
+#include "dict.h"
+
+
+
+/* Number of candidates tried between two looks at the deadline. */
+#define CHECK_EVERY 4096
+
+/* Number of candidates of a chunk, the unit of work of the threads. */
+#define CHUNK_SIZE (64 * 1024)
+
+
+
+/* What one thread does. */
+struct dict_job {
+	const struct dict *d;
+
+	/* Next chunk to take, shared by all the threads. */
+	size_t *next;
+
+	/* Tables shared by all the threads, see dict_crack. */
+	float *const *col;
+	float *const *rest;
+
+	/* partial[t] is the score of the t first characters of the current
+	 * candidate. */
+	float *partial;
+
+	/* Best candidate of this job, d->nwords if none. */
+	size_t best;
+	float score;
+
+	/* Whether the deadline stopped it. */
+	int expired;
+
+	pthread_t thread;
+};
+
+
+
+int dict_init(struct dict *d, const char *str, size_t len,
+              const struct charset *charset, struct arena *arena) {
+	memset(d, 0, sizeof(*d));
+	d->str = str;
+	d->str_len = len;
+	d->charset = charset;
+	d->sample = DICT_DEFAULT_SAMPLE;
+	d->maxlen = DICT_DEFAULT_MAXLEN;
+	d->reffreq = freq_en;
+	d->arena = arena;
+
+	/* The reference frequencies only cover A to Z. */
+	if (charset->length != CS_ALPHA_LEN)
+		return ERR_CHARSET;
+
+	return ERR_OK;
+}
+
+
+
+void dict_fini(struct dict *d) {
+	arena_free(d->arena, d->resume);
+	arena_free(d->arena, d->key);
+	arena_free(d->arena, d->ords);
+	arena_free(d->arena, d->words);
+	memset(d, 0, sizeof(*d));
+}
+
+
+
+/*
+ * Stable counting sort of the n words of src into dst with respect to the
+ * character of their prefix at position pos, or their length if pos is
+ * (size_t)-1. Both are
+ * lower than nkeys, count must have room for nkeys + 1 elements.
+ */
+static void counting_sort(struct dict_word *dst, const struct dict_word *src,
+                          size_t n, size_t pos, size_t nkeys, size_t *count) {
+	size_t i, k, sum;
+
+	memset(count, 0, (nkeys + 1) * sizeof(*count));
+	for (i = 0; i < n; i++) {
+		k = pos == (size_t)-1 ? src[i].klen : src[i].prefix[pos];
+		count[k + 1]++;
+	}
+
+	sum = 0;
+	for (k = 0; k <= nkeys; k++) {
+		sum += count[k];
+		count[k] = sum;
+	}
+
+	for (i = 0; i < n; i++) {
+		k = pos == (size_t)-1 ? src[i].klen : src[i].prefix[pos];
+		dst[count[k]++] = src[i];
+	}
+}
+
+
+
+/*
+ * Sort the words by length, then by the characters of their prefix. This is a
+ * radix sort: by length first, then every group of the same length is sorted
+ * from the last character of the prefix to the first one. The sort is
+ * stable, so the equivalent words keep the order of the wordlist.
+ */
+static int sort_words(struct dict *d) {
+	size_t n = d->charset->length;
+	struct dict_word *tmp, *src, *dst, *w;
+	size_t first, last, t, klen;
+	size_t *count;
+
+	tmp = arena_alloc(d->arena, d->nwords * sizeof(*tmp));
+	count = arena_alloc(d->arena, (d->maxlen + n + 2) * sizeof(*count));
+	if (tmp == NULL || count == NULL) {
+		arena_free(d->arena, tmp);
+		arena_free(d->arena, count);
+		return ERR_NOMEM;
+	}
+
+	counting_sort(tmp, d->words, d->nwords, (size_t)-1, d->maxlen + 1,
+	              count);
+
+	for (first = 0; first < d->nwords; first = last) {
+		klen = tmp[first].klen;
+		for (last = first; last < d->nwords; last++) {
+			if (tmp[last].klen != klen)
+				break;
+		}
+
+		src = tmp + first;
+		dst = d->words + first;
+		for (t = klen < DICT_PREFIX ? klen : DICT_PREFIX; t-- > 0;) {
+			counting_sort(dst, src, last - first, t, n, count);
+			w = src;
+			src = dst;
+			dst = w;
+		}
+
+		/* The result must end up in d->words. */
+		if (src != d->words + first)
+			memcpy(d->words + first, src,
+			       (last - first) * sizeof(*src));
+	}
+
+	arena_free(d->arena, count);
+	arena_free(d->arena, tmp);
+	return ERR_OK;
+}
+
+
+
+int dict_load(struct dict *d, const char *list, size_t len) {
+	const struct charset *cs = d->charset;
+	const char *p, *end, *eol;
+	unsigned char *o;
+	size_t nlines;
+
+	arena_free(d->arena, d->resume);
+	arena_free(d->arena, d->ords);
+	arena_free(d->arena, d->words);
+	d->resume = NULL;
+	d->words = NULL;
+	d->ords = NULL;
+	d->nwords = 0;
+
+	nlines = 0;
+	for (p = list, end = list + len; p < end; p = eol + 1) {
+		eol = memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		nlines++;
+	}
+
+	if (nlines == 0)
+		return ERR_INVAL;
+
+	d->words = arena_alloc(d->arena, nlines * sizeof(*d->words));
+	d->ords = arena_alloc(d->arena, len);
+	if (d->words == NULL || d->ords == NULL)
+		return ERR_NOMEM;
+
+	o = d->ords;
+	for (p = list; p < end; p = eol + 1) {
+		struct dict_word *w = &d->words[d->nwords];
+		size_t i;
+
+		eol = memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+
+		w->word = p;
+		w->len = eol - p;
+		if (w->len > 0 && p[w->len - 1] == '\r')
+			w->len--;
+
+		w->ord = o;
+		w->klen = 0;
+		for (i = 0; i < w->len; i++) {
+			short c = CS_TABLE_ORD(cs, p[i]);
+
+			if (c >= 0)
+				o[w->klen++] = c;
+		}
+
+		if (w->klen == 0 || w->klen > d->maxlen ||
+		    (d->klen != 0 && w->klen != d->klen))
+			continue;
+
+		memcpy(w->prefix, o, w->klen < DICT_PREFIX ? w->klen :
+		       DICT_PREFIX);
+		o += w->klen;
+		d->nwords++;
+	}
+
+	if (d->nwords == 0)
+		return ERR_INVAL;
+
+	return sort_words(d);
+}
+
+
+
+/*
+ * Fill col with the score of every character at every position of a key of
+ * length klen: col[t * n + k] is the log-likelihood of the column t of the
+ * sample decrypted with the character k. rest[t] is the best possible score
+ * of the characters from t to the end of the key.
+ */
+static void length_tables(const struct dict *d, const unsigned char *ord,
+                          size_t slen, const float *logp, size_t klen,
+                          float *col, float *rest) {
+	size_t n = d->charset->length;
+	size_t count[256];
+	size_t t, i, k, c;
+
+	for (t = 0; t < klen; t++) {
+		float *row = col + t * n;
+
+		memset(count, 0, n * sizeof(*count));
+		for (i = t; i < slen; i += klen)
+			count[ord[i]]++;
+
+		for (k = 0; k < n; k++) {
+			float s = 0;
+
+			for (c = 0; c < n; c++)
+				s += count[c] * logp[(c + n - k) % n];
+			row[k] = s;
+		}
+	}
+
+	rest[klen] = 0;
+	for (t = klen; t-- > 0;) {
+		float best = -FLT_MAX;
+
+		for (k = 0; k < n; k++) {
+			if (col[t * n + k] > best)
+				best = col[t * n + k];
+		}
+
+		rest[t] = rest[t + 1] + best;
+	}
+}
+
+
+
+/* Try the candidates of a chunk from d->resume[c] on. Return 0 if the deadline
+ * stopped it, and set d->resume[c] to where it did. */
+static int dict_chunk(struct dict_job *job, size_t c, size_t *steps) {
+	const struct dict *d = job->d;
+	size_t n = d->charset->length;
+	const struct dict_word *prev = NULL;
+	float *partial = job->partial;
+	size_t valid = 0;
+	size_t i, t, end;
+
+	end = (c + 1) * CHUNK_SIZE;
+	if (end > d->nwords)
+		end = d->nwords;
+
+	partial[0] = 0;
+	i = d->resume[c];
+	while (i < end) {
+		const struct dict_word *w = &d->words[i];
+		const float *col = job->col[w->klen];
+		const float *rest = job->rest[w->klen];
+		size_t klen = w->klen;
+
+		/* Some candidates are always tried, so that every run makes
+		 * some progress. */
+		if (++*steps % CHECK_EVERY == 0 && deadline_passed(d->deadline)) {
+			d->resume[c] = i;
+			return 0;
+		}
+
+		/* Reuse the partial scores of the prefix shared with the
+		 * previous candidate. */
+		t = 0;
+		if (prev != NULL && prev->klen == klen) {
+			while (t < valid && prev->ord[t] == w->ord[t])
+				t++;
+		}
+
+		for (; t < klen; t++) {
+			partial[t + 1] = partial[t] + col[t * n + w->ord[t]];
+			if (partial[t + 1] + rest[t + 1] <= job->score)
+				break;
+		}
+
+		prev = w;
+		i++;
+
+		if (t < klen) {
+			/* Skip every candidate sharing the hopeless prefix. */
+			valid = t + 1;
+			while (i < end && d->words[i].klen == klen &&
+			       memcmp(d->words[i].ord, w->ord, valid) == 0)
+				i++;
+			continue;
+		}
+
+		valid = klen;
+		if (partial[klen] > job->score) {
+			job->score = partial[klen];
+			job->best = i - 1;
+		}
+	}
+
+	d->resume[c] = end;
+	return 1;
+}
+
+
+
+/* Start a new run, from the first candidate of every chunk. */
+static int start_chunks(struct dict *d) {
+	size_t c;
+
+	d->nchunks = (d->nwords + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	d->resume = arena_alloc(d->arena, d->nchunks * sizeof(*d->resume));
+	if (d->resume == NULL)
+		return ERR_NOMEM;
+
+	for (c = 0; c < d->nchunks; c++)
+		d->resume[c] = c * CHUNK_SIZE;
+
+	d->best = d->nwords;
+	return ERR_OK;
+}
+
+
+
+/* Copy the best candidate to d->key. */
+static int set_key(struct dict *d) {
+	const struct dict_word *w = &d->words[d->best];
+
+	arena_free(d->arena, d->key);
+	d->key = arena_alloc(d->arena, w->len + 1);
+	if (d->key == NULL)
+		return ERR_NOMEM;
+
+	memcpy(d->key, w->word, w->len);
+	d->key[w->len] = '\0';
+	return ERR_OK;
+}
+
+
+
+static void *dict_worker(void *arg) {
+	struct dict_job *job = arg;
+	const struct dict *d = job->d;
+	size_t steps = 0;
+	size_t c;
+
+	/* The best candidate of the previous runs prunes from the start. */
+	job->best = d->best;
+	job->score = d->best < d->nwords ? d->score : -FLT_MAX;
+	job->expired = 0;
+
+	/* The chunks are taken in order, so the earliest candidate of a job
+	 * wins its ties. */
+	while ((c = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED)) <
+	       d->nchunks) {
+		if (!dict_chunk(job, c, &steps)) {
+			job->expired = 1;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+int dict_crack(struct dict *d) {
+	const struct charset *cs = d->charset;
+	size_t n = cs->length;
+	size_t slen, maxklen, nthreads, nstarted;
+	unsigned char *ord = NULL;
+	float **col = NULL, **rest = NULL;
+	float *tables = NULL, *partials = NULL;
+	float logp[256];
+	struct dict_job *jobs = NULL;
+	size_t tsize, i, klen, next, best;
+	long ncpus;
+	int err = ERR_OK;
+
+	if (d->str_len == 0)
+		return ERR_TOOSHORT;
+
+	if (d->nwords == 0)
+		return ERR_INVAL;
+
+	slen = d->str_len < d->sample ? d->str_len : d->sample;
+	maxklen = d->words[d->nwords - 1].klen;
+
+	nthreads = d->nthreads;
+	if (nthreads == 0) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+
+	/* Continue the previous run if it was cut short with the same
+	 * candidates. */
+	if (d->resume != NULL && d->nchunks !=
+	    (d->nwords + CHUNK_SIZE - 1) / CHUNK_SIZE) {
+		arena_free(d->arena, d->resume);
+		d->resume = NULL;
+	}
+
+	if (d->resume == NULL) {
+		err = start_chunks(d);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	if (nthreads > d->nchunks)
+		nthreads = d->nchunks;
+
+	/* The tables of every key length, one after the other. */
+	tsize = 0;
+	for (klen = 1; klen <= maxklen; klen++)
+		tsize += klen * n + klen + 1;
+
+	ord = arena_alloc(d->arena, slen);
+	col = arena_alloc(d->arena, (maxklen + 1) * sizeof(*col));
+	rest = arena_alloc(d->arena, (maxklen + 1) * sizeof(*rest));
+	tables = arena_alloc(d->arena, tsize * sizeof(*tables));
+	partials = arena_alloc(d->arena,
+	                       nthreads * (maxklen + 1) * sizeof(*partials));
+	jobs = arena_alloc(d->arena, nthreads * sizeof(*jobs));
+	if (ord == NULL || col == NULL || rest == NULL || tables == NULL ||
+	    partials == NULL || jobs == NULL) {
+		err = ERR_NOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < slen; i++)
+		ord[i] = CS_TABLE_ORD(cs, d->str[i]);
+
+	/* Unseen characters still get a finite penalty. */
+	for (i = 0; i < n; i++)
+		logp[i] = log(d->reffreq[i] + 1e-4);
+
+	/* Only the lengths of some candidates need their tables. */
+	col[0] = rest[0] = NULL;
+	for (klen = 1; klen <= maxklen; klen++)
+		col[klen] = NULL;
+
+	tsize = 0;
+	for (i = 0; i < d->nwords; i++) {
+		klen = d->words[i].klen;
+		if (col[klen] != NULL)
+			continue;
+
+		col[klen] = tables + tsize;
+		rest[klen] = col[klen] + klen * n;
+		tsize += klen * n + klen + 1;
+		length_tables(d, ord, slen, logp, klen, col[klen], rest[klen]);
+	}
+
+	next = 0;
+	for (nstarted = 0; nstarted < nthreads; nstarted++) {
+		struct dict_job *job = &jobs[nstarted];
+
+		job->d = d;
+		job->next = &next;
+		job->col = col;
+		job->rest = rest;
+		job->partial = partials + nstarted * (maxklen + 1);
+
+		if (pthread_create(&job->thread, NULL, dict_worker, job) != 0)
+			break;
+	}
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(jobs[i].thread, NULL);
+
+	if (nstarted == 0) {
+		err = ERR_THREAD;
+		goto out;
+	}
+
+	/* The earliest candidate wins the ties, whatever the threads. */
+	d->expired = 0;
+	best = d->nwords;
+	for (i = 0; i < nstarted; i++) {
+		d->expired |= jobs[i].expired;
+
+		if (jobs[i].best == d->nwords)
+			continue;
+
+		if (best == d->nwords || jobs[i].score > d->score ||
+		    (jobs[i].score == d->score && jobs[i].best < best)) {
+			best = jobs[i].best;
+			d->score = jobs[i].score;
+		}
+	}
+
+	if (!d->expired) {
+		arena_free(d->arena, d->resume);
+		d->resume = NULL;
+	}
+
+	d->best = best;
+	if (best < d->nwords)
+		err = set_key(d);
+
+out:
+	arena_free(d->arena, jobs);
+	arena_free(d->arena, partials);
+	arena_free(d->arena, tables);
+	arena_free(d->arena, rest);
+	arena_free(d->arena, col);
+	arena_free(d->arena, ord);
+	return err;
+}
+
+
+
+int dict_save(const struct dict *d, struct ckpt *c) {
+	size_t nchunks, i;
+	int err;
+
+	nchunks = d->resume != NULL ? d->nchunks : 0;
+
+	err = ckpt_put(c, d->nwords);
+	if (err == ERR_OK)
+		err = ckpt_put(c, nchunks);
+
+	/* Only the progress within the chunk, which is small. */
+	for (i = 0; i < nchunks && err == ERR_OK; i++)
+		err = ckpt_put(c, d->resume[i] - i * CHUNK_SIZE);
+
+	if (err == ERR_OK)
+		err = ckpt_put(c, d->best);
+	if (err == ERR_OK)
+		err = ckpt_put_bytes(c, &d->score, sizeof(d->score));
+
+	return err;
+}
+
+
+
+int dict_restore(struct dict *d, struct ckpt *c) {
+	size_t nwords, nchunks, best, off, end, i;
+	double score;
+	int err;
+
+	err = ckpt_get(c, &nwords);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &nchunks);
+	if (err != ERR_OK)
+		return err;
+
+	if (nwords != d->nwords || (nchunks != 0 && nchunks !=
+	    (d->nwords + CHUNK_SIZE - 1) / CHUNK_SIZE))
+		return ERR_FORMAT;
+
+	arena_free(d->arena, d->resume);
+	d->resume = NULL;
+
+	/* Before or after the search, there's no progress to restore, only
+	 * the best key. */
+	if (nchunks != 0) {
+		err = start_chunks(d);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	for (i = 0; i < nchunks && err == ERR_OK; i++) {
+		err = ckpt_get(c, &off);
+
+		end = (i + 1) * CHUNK_SIZE;
+		if (end > nwords)
+			end = nwords;
+		if (err == ERR_OK && off > end - i * CHUNK_SIZE)
+			err = ERR_FORMAT;
+
+		d->resume[i] += off;
+	}
+
+	if (err == ERR_OK)
+		err = ckpt_get(c, &best);
+	if (err == ERR_OK)
+		err = ckpt_get_bytes(c, &score, sizeof(score));
+	if (err == ERR_OK && best > nwords)
+		err = ERR_FORMAT;
+
+	if (err != ERR_OK) {
+		arena_free(d->arena, d->resume);
+		d->resume = NULL;
+		return err;
+	}
+
+	d->best = best;
+	d->score = score;
+	if (best < nwords)
+		err = set_key(d);
+
+	return err;
+}
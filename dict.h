@@ -0,0 +1,143 @@
+#ifndef DICT_H__
+#define DICT_H__
+
+/*
+ * This module try every word of a wordlist as the key.
+ *
+ * Every candidate is scored on a sample taken from the start of the filtered
+ * text by the log-likelihood of its decryption with respect to the reference
+ * frequencies. This score is the sum of the scores of the key characters, each
+ * one only depending on its column of the sample. So the score of every
+ * character at every position of a key of every length is computed once, and
+ * a candidate only costs one addition per key character.
+ *
+ * The candidates are sorted so that the ones sharing a prefix are next to each
+ * other, as in a walk through a trie. The partial score of the prefix shared
+ * with the previous candidate is reused, and a prefix whose score can't beat
+ * the best candidate anymore, even with the best characters after it, is
+ * skipped along with all the candidates sharing it.
+ *
+ * The candidates are split in chunks among several threads. Every chunk
+ * remembers how far it has been tried, so that a run cut short by its deadline
+ * can be continued, possibly after a restart through a checkpoint, see
+ * checkpoint.h.
+ */
+
+#include <sys/types.h>
+
+#include "charset.h"
+#include "arena.h"
+#include "checkpoint.h"
+
+
+/* Number of characters of the text used to score the candidates. */
+#define DICT_DEFAULT_SAMPLE 4096
+
+/* Longer words are ignored. */
+#define DICT_DEFAULT_MAXLEN 64
+
+/*
+ * The candidates are only sorted on this many first characters, kept in
+ * struct dict_word to sort without chasing pointers. Beyond that, they stay in
+ * the order of the wordlist, which only cost some reuse of partial scores.
+ */
+#define DICT_PREFIX 8
+
+
+
+struct dict_word {
+	/* The word as found in the wordlist, not nul-terminated. */
+	const char *word;
+	size_t len;
+
+	/* Positions in the charset of its characters that belong to it. */
+	const unsigned char *ord;
+	size_t klen;
+
+	/* Copy of the first ones. */
+	unsigned char prefix[DICT_PREFIX];
+};
+
+
+
+struct dict {
+	const char *str;
+	size_t str_len;
+	const struct charset *charset;
+
+	/* Settings, may be changed before dict_load. */
+	size_t sample;
+	size_t maxlen;
+
+	/* Only try the keys of this length if not 0. */
+	size_t klen;
+
+	/* Number of threads, 0 for one per CPU. */
+	size_t nthreads;
+
+	/* Frequencies of the plaintext characters. freq_en by default. */
+	const float *reffreq;
+
+	/* Candidates loaded by dict_load, sorted by length then characters. */
+	struct dict_word *words;
+	size_t nwords;
+	unsigned char *ords;
+
+	/* Best key found by dict_crack, nul-terminated, its score and its
+	 * index in words. */
+	char *key;
+	double score;
+	size_t best;
+
+	struct arena *arena;
+
+	/* When to stop, see deadline.h. 0 by default. The key is then the best
+	 * of the candidates tried. */
+	double deadline;
+	int expired;
+
+	/* Index of the next candidate to try in every chunk, kept while a run
+	 * cut short by the deadline has some left. Running dict_crack again
+	 * then only tries those, and keeps the best key if none is better. */
+	size_t *resume;
+	size_t nchunks;
+};
+
+
+
+/*
+ * Initialize a struct dict to crack the len bytes of the filtered text str.
+ * arena may be NULL to use malloc.
+ * Return ERR_CHARSET if the charset doesn't have the length of the reference
+ * frequencies.
+ */
+int dict_init(struct dict *d, const char *str, size_t len,
+              const struct charset *charset, struct arena *arena);
+
+/* Deinitialize a struct dict. */
+void dict_fini(struct dict *d);
+
+/*
+ * Load the words of a wordlist made of the len bytes of list, one word per
+ * line. The list must outlive the struct dict.
+ * Return ERR_INVAL if no word is usable as a key.
+ */
+int dict_load(struct dict *d, const char *list, size_t len);
+
+/*
+ * Find the candidate whose decryption looks the most like the reference
+ * language.
+ * Return ERR_TOOSHORT if the text is empty, ERR_THREAD if no thread could be
+ * started. Set expired if the deadline passed before the end.
+ */
+int dict_crack(struct dict *d);
+
+/* Save the progress of the candidates and the best key so far to a checkpoint
+ * of kind CKPT_DICT. */
+int dict_save(const struct dict *d, struct ckpt *c);
+
+/* Restore what dict_save saved, after dict_load. Return ERR_FORMAT if the
+ * number of candidates differ. */
+int dict_restore(struct dict *d, struct ckpt *c);
+
+#endif
@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver.h"
+#include "misc.h"
+
+
+#ifndef BENCH_VERSION
+# define BENCH_VERSION "unknown"
+#endif
+
+
+
+double driver_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+size_t driver_parse_list(const char *str, size_t *list, size_t max) {
+	size_t n = 0;
+	char *end;
+
+	while (*str != '\0' && n < max) {
+		list[n++] = strtoul(str, &end, 10);
+		if (end == str || (*end != ',' && *end != '\0'))
+			custom_error("Invalid list of numbers: %s", str);
+
+		str = *end == ',' ? end + 1 : end;
+	}
+
+	return n;
+}
+
+
+
+void driver_set_format(struct driver_report *r, const char *name) {
+	if (strcmp(name, "csv") == 0)
+		r->format = DRIVER_CSV;
+	else if (strcmp(name, "json") == 0)
+		r->format = DRIVER_JSON;
+	else
+		custom_error("Unknown format %s", name);
+}
+
+
+
+void driver_open(struct driver_report *r, const char *filename) {
+	r->out = stdout;
+	if (strcmp(filename, "-") != 0) {
+		r->out = fopen(filename, "w");
+		if (r->out == NULL)
+			system_error(filename);
+	}
+}
+
+
+
+void driver_result(struct driver_report *r, const char *csv_header) {
+	if (r->format == DRIVER_CSV && r->nresults == 0)
+		fprintf(r->out, "%s\n", csv_header);
+	else if (r->format == DRIVER_JSON && r->nresults == 0)
+		fprintf(r->out, "{\"version\": \"%s\", \"results\": [\n",
+		        BENCH_VERSION);
+	else if (r->format == DRIVER_JSON)
+		fprintf(r->out, ",\n");
+
+	r->nresults++;
+}
+
+
+
+void driver_close(struct driver_report *r, const char *filename) {
+	if (r->format == DRIVER_JSON && r->nresults > 0)
+		fprintf(r->out, "\n]}\n");
+	else if (r->format == DRIVER_JSON)
+		fprintf(r->out, "{\"version\": \"%s\", \"results\": []}\n",
+		        BENCH_VERSION);
+
+	if (r->out != stdout && fclose(r->out) != 0)
+		system_error(filename);
+}
@@ -0,0 +1,50 @@
+#ifndef DRIVER_H__
+#define DRIVER_H__
+
+/*
+ * Helpers shared by the drivers measuring the library, unvigenere-bench and
+ * unvigenere-accuracy. Both run a grid of combinations and print a result for
+ * every one of them, as CSV or JSON, tagged with the version being measured.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+
+enum driver_format {
+	DRIVER_CSV,
+	DRIVER_JSON
+};
+
+struct driver_report {
+	FILE *out;
+	enum driver_format format;
+	size_t nresults;
+};
+
+
+
+/* Return the time of the monotonic clock in seconds. */
+double driver_now(void);
+
+/* Parse a comma separated list of at most max integers. Return the number of
+ * them. Abort on an invalid list. */
+size_t driver_parse_list(const char *str, size_t *list, size_t max);
+
+/* Set the format of the report from its name. Abort if it's unknown. */
+void driver_set_format(struct driver_report *r, const char *name);
+
+/* Open the output of the report. The filename may be "-" for stdout. */
+void driver_open(struct driver_report *r, const char *filename);
+
+/*
+ * Start a new result. Print what comes before it: the csv_header line before
+ * the first CSV result, the opening of the JSON document or the separator
+ * from the previous result. The caller then prints the result itself.
+ */
+void driver_result(struct driver_report *r, const char *csv_header);
+
+/* Print the end of the report and close its output. */
+void driver_close(struct driver_report *r, const char *filename);
+
+#endif
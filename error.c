@@ -0,0 +1,24 @@
+#include "error.h"
+
+
+
+static const char *const err_msg[] = {
+	"Success",
+	"Out of memory",
+	"Invalid argument",
+	"All the charsets must have the same length",
+	"Not enough significant characters",
+	"The key length must be known first",
+	"Input / output error",
+	"Thread creation failed",
+	"Invalid or mismatching file format"
+};
+
+
+
+const char *err_str(int err) {
+	if (err < 0 || err >= ERR_LAST)
+		return "Unknown error";
+
+	return err_msg[err];
+}
@@ -0,0 +1,31 @@
+#ifndef ERROR_H__
+#define ERROR_H__
+
+/*
+ * Error codes returned by the library functions.
+ * None of the library functions exit the process or print anything. They all
+ * return ERR_OK on success and one of these codes otherwise, leaving it to the
+ * caller to decide what to do about it.
+ */
+
+
+
+enum err_code {
+	ERR_OK = 0,
+	ERR_NOMEM,    /* A memory allocation failed. */
+	ERR_INVAL,    /* Invalid argument. */
+	ERR_CHARSET,  /* Charset strings do not have the same length. */
+	ERR_TOOSHORT, /* Not enough significant characters to work with. */
+	ERR_NOLENGTH, /* The key length is not known yet. */
+	ERR_IO,       /* A system call failed. errno tells why. */
+	ERR_THREAD,   /* A thread couldn't be created. */
+	ERR_FORMAT,   /* A file or a message isn't in the expected format. */
+	ERR_LAST
+};
+
+
+
+/* Return a static human-readable description of an error code. */
+const char *err_str(int err);
+
+#endif
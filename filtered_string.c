@@ -2,8 +2,9 @@
 #include <string.h>
 #include <sys/types.h>
 
-#include "misc.h"
+#include "error.h"
 #include "charset.h"
+#include "arena.h"
 #include "filtered_string.h"
 
 
@@ -12,32 +13,39 @@
  * character lookup is faster.
  */
 
-void fs_init(struct fs_ctx *ctx, char *str, const struct charset *charset) {
+int fs_init(struct fs_ctx *ctx, char *str, size_t len,
+            const struct charset *charset, struct arena *arena) {
 	size_t nlen = 0;
-	ssize_t i;
+	size_t i;
 
 	memset(ctx, 0, sizeof(*ctx));
 	ctx->str = str;
 	ctx->charset = charset;
-	ctx->len = strlen(str);
-
-	for (i = fs_pidx(ctx, 0); i >= 0; i = fs_next(ctx, i))
-		nlen++;
-
-	ctx->norm = malloc((nlen + 1) * sizeof(*ctx->norm));
-	if (ctx->norm == NULL)
-		system_error("malloc");
+	ctx->arena = arena;
+	ctx->len = len;
+
+	if (charset->alpha) {
+		for (i = 0; i < len; i++)
+			nlen += CS_ALPHA_ORD(charset, str[i]) < CS_ALPHA_LEN;
+	} else {
+		for (i = 0; i < len; i++)
+			nlen += CS_TABLE_ORD(charset, str[i]) >= 0;
+	}
 
-	ctx->norm[nlen] = '\0';
+	ctx->nlen = nlen;
+	ctx->norm = arena_alloc(arena, nlen * sizeof(*ctx->norm));
+	if (ctx->norm == NULL && nlen > 0)
+		return ERR_NOMEM;
 
 	/* Will reconstruct the content of ctx->norm based on ctx->str. */
 	fs_update_all(ctx);
+	return ERR_OK;
 }
 
 
 
 void fs_fini(struct fs_ctx *ctx) {
-	free(ctx->norm);
+	arena_free(ctx->arena, ctx->norm);
 	memset(ctx, 0, sizeof(*ctx));
 }
 
@@ -45,11 +53,13 @@ void fs_fini(struct fs_ctx *ctx) {
 
 ssize_t fs_pidx(const struct fs_ctx *ctx, size_t n) {
 	const char *p;
+	const char *end;
 
-	p = cs_strpbrk(ctx->charset, ctx->str);
+	end = ctx->str + ctx->len;
+	p = cs_mempbrk(ctx->charset, ctx->str, ctx->len);
 
 	while (n > 0 && p != NULL) {
-		p = cs_strpbrk(ctx->charset, p + 1);
+		p = cs_mempbrk(ctx->charset, p + 1, end - p - 1);
 		n--;
 	}
 
@@ -67,7 +77,7 @@ ssize_t fs_next(const struct fs_ctx *ctx, size_t n) {
 	if (n >= ctx->len)
 		return -1;
 
-	p = cs_strpbrk(ctx->charset, ctx->str + n + 1);
+	p = cs_mempbrk(ctx->charset, ctx->str + n + 1, ctx->len - n - 1);
 
 	if (p == NULL)
 		return -1;
@@ -87,16 +97,28 @@ char fs_char(const struct fs_ctx *ctx, size_t n) {
 
 
 
-void fs_replace(struct fs_ctx *ctx, const char *norm) {
-	ssize_t i;
+int fs_replace(struct fs_ctx *ctx, const char *norm, size_t nlen) {
+	const struct charset *cs = ctx->charset;
+	size_t i;
 
-	if (strlen(norm) != strlen(ctx->norm))
-		custom_error("fs_replace called with unapplyable new string");
+	if (nlen != ctx->nlen)
+		return ERR_INVAL;
 
-	strcpy(ctx->norm, norm);
+	memcpy(ctx->norm, norm, nlen);
 
-	for (i = fs_pidx(ctx, 0); i >= 0; i = fs_next(ctx, i))
-		ctx->str[i] = *norm++;
+	if (cs->alpha) {
+		for (i = 0; i < ctx->len; i++) {
+			if (CS_ALPHA_ORD(cs, ctx->str[i]) < CS_ALPHA_LEN)
+				ctx->str[i] = *norm++;
+		}
+	} else {
+		for (i = 0; i < ctx->len; i++) {
+			if (CS_TABLE_ORD(cs, ctx->str[i]) >= 0)
+				ctx->str[i] = *norm++;
+		}
+	}
+
+	return ERR_OK;
 }
 
 
@@ -108,9 +130,19 @@ void fs_update(struct fs_ctx *ctx, size_t n) {
 
 
 void fs_update_all(struct fs_ctx *ctx) {
-	ssize_t i;
+	const struct charset *cs = ctx->charset;
+	size_t i;
 	size_t j = 0;
 
-	for (i = fs_pidx(ctx, 0); i >= 0; i = fs_next(ctx, i))
-		ctx->norm[j++] = ctx->str[i];
+	if (cs->alpha) {
+		for (i = 0; i < ctx->len; i++) {
+			if (CS_ALPHA_ORD(cs, ctx->str[i]) < CS_ALPHA_LEN)
+				ctx->norm[j++] = ctx->str[i];
+		}
+	} else {
+		for (i = 0; i < ctx->len; i++) {
+			if (CS_TABLE_ORD(cs, ctx->str[i]) >= 0)
+				ctx->norm[j++] = ctx->str[i];
+		}
+	}
 }
@@ -4,20 +4,34 @@
 #include <sys/types.h>
 
 #include "charset.h"
+#include "arena.h"
 
 
 
+/*
+ * Neither str nor norm are nul-terminated, their lengths are len and nlen.
+ * They may contain any byte.
+ */
 struct fs_ctx {
 	char *str;
 	const struct charset *charset;
 	size_t len;
 	char *norm;
+	size_t nlen;
+
+	/* Where norm is allocated. May be NULL. */
+	struct arena *arena;
 };
 
 
 
-/* initialize ctx with the given information */
-void fs_init(struct fs_ctx *ctx, char *str, const struct charset *charset);
+/*
+ * initialize ctx with the given information
+ * str is len bytes long and doesn't need to be nul-terminated.
+ * The memory is taken from arena, which may be NULL to use malloc.
+ */
+int fs_init(struct fs_ctx *ctx, char *str, size_t len,
+            const struct charset *charset, struct arena *arena);
 
 void fs_fini(struct fs_ctx *ctx);
 
@@ -43,8 +57,9 @@ char fs_char(const struct fs_ctx *ctx, size_t n);
 
 /*
  * Remplace all the non-filtered chars in the string with these ones.
+ * Return ERR_INVAL if nlen is not the length of ctx->norm.
  */
-void fs_replace(struct fs_ctx *ctx, const char *norm);
+int fs_replace(struct fs_ctx *ctx, const char *norm, size_t nlen);
 
 /*
  * Function to call to tell the filtered string a given char has been modified.
@@ -2,64 +2,74 @@
 #include <string.h>
 #include <sys/types.h>
 
-#include "misc.h"
+#include "error.h"
 #include "charset.h"
+#include "arena.h"
 #include "freq.h"
 
 
 
 
 /* Initialize a struct freq. */
-void freq_init(struct freq *f, const struct charset *charset) {
+int freq_init(struct freq *f, const struct charset *charset,
+              struct arena *arena) {
 	memset(f, 0, sizeof(*f));
 
 	f->charset = charset;
-	f->freq = malloc(sizeof(*f->freq) * charset->length);
+	f->arena = arena;
+	f->freq = arena_alloc(arena, sizeof(*f->freq) * charset->length);
 	if (f->freq == NULL)
-		system_error("malloc");
+		return ERR_NOMEM;
 
 	memset(f->freq, 0, sizeof(*f->freq) * charset->length);
+	return ERR_OK;
 }
 
 
 
 /* Deinitialize a struct freq. */
 void freq_fini(struct freq *f) {
-	free(f->freq);
+	arena_free(f->arena, f->freq);
 	memset(f, 0, sizeof(*f));
 }
 
 
 
 /*
- * Compute the frequency of the string str with repect to the charset given in
- * the initialization, but only take one character every n characters of str.
+ * Compute the frequency of the len bytes of str with repect to the charset
+ * given in the initialization, but only take one character every n characters
+ * of str.
  */
-void freq_compute_stride(struct freq *f, const char *str, size_t n) {
+int freq_compute_stride(struct freq *f, const char *str, size_t len, size_t n) {
 	/* Use a temporary array "count" so that float errors won't disturb the
 	 * result. */
 	size_t *count;
 	size_t i;
 	size_t total;
-	size_t nlen;
 	const struct charset *cs; /* shorthand */
 
 	cs = f->charset;
-	nlen = strlen(str);
 
-	count = malloc(sizeof(*count) * cs->length);
+	count = arena_alloc(f->arena, sizeof(*count) * cs->length);
 	if (count == NULL)
-		system_error("malloc");
+		return ERR_NOMEM;
 
 	memset(count, 0, sizeof(*count) * cs->length);
 
-	for (i = 0; i < nlen; i += n) {
-		int o = cs_ord(cs, str[i]);
+	if (cs->alpha) {
+		for (i = 0; i < len; i += n) {
+			unsigned o = CS_ALPHA_ORD(cs, str[i]);
 
-		if (o == -1)
-			continue;
+			if (o < CS_ALPHA_LEN)
+				count[o]++;
+		}
+	} else {
+		for (i = 0; i < len; i += n) {
+			int o = CS_TABLE_ORD(cs, str[i]);
 
-		count[o]++;
+			if (o != -1)
+				count[o]++;
+		}
 	}
 
 	total = 0;
@@ -69,15 +79,16 @@ void freq_compute_stride(struct freq *f, const char *str, size_t n) {
 	for (i = 0; i < cs->length; i++)
 		f->freq[i] = count[i] / (float)total;
 
-	free(count);
+	arena_free(f->arena, count);
+	return ERR_OK;
 }
 
 
 
 /*
- * Compute the frequency of the string str with repect to the charset given in
- * the initialization.
+ * Compute the frequency of the len bytes of str with repect to the charset
+ * given in the initialization.
  */
-void freq_compute(struct freq *f, const char *str) {
-	freq_compute_stride(f, str, 1);
+int freq_compute(struct freq *f, const char *str, size_t len) {
+	return freq_compute_stride(f, str, len, 1);
 }
@@ -9,32 +9,36 @@
 #include <sys/types.h>
 
 #include "charset.h"
+#include "arena.h"
 
 
 struct freq {
 	const struct charset *charset;
 	float *freq;
+	struct arena *arena;
 };
 
 
 
-/* Initialize a struct freq. */
-void freq_init(struct freq *f, const struct charset *charset);
+/* Initialize a struct freq. arena may be NULL to use malloc. */
+int freq_init(struct freq *f, const struct charset *charset,
+              struct arena *arena);
 
 /* Deinitialize a struct freq. */
 void freq_fini(struct freq *f);
 
 /*
- * Compute the frequency of the string str with repect to the charset given in
- * the initialization, but only take one character every n characters of str.
+ * Compute the frequency of the len bytes of str with repect to the charset
+ * given in the initialization, but only take one character every n characters
+ * of str.
  */
-void freq_compute_stride(struct freq *f, const char *str, size_t n);
+int freq_compute_stride(struct freq *f, const char *str, size_t len, size_t n);
 
 /*
- * Compute the frequency of the string str with repect to the charset given in
- * the initialization.
+ * Compute the frequency of the len bytes of str with repect to the charset
+ * given in the initialization.
  */
-void freq_compute(struct freq *f, const char *str);
+int freq_compute(struct freq *f, const char *str, size_t len);
 
 
 #endif
@@ -76,8 +76,11 @@ static char *build_shortopt(const struct goh_option *opts, size_t cnt,
 	/* At least one char for the \0. */
 	shortopt_sz = 1;
 	for (o = opts; o < opts + cnt; o++) {
-		if (o->abbr != '\0')
-			shortopt_sz++;
+		/* Long-only options don't appear in the short options. */
+		if (o->abbr == '\0')
+			continue;
+
+		shortopt_sz++;
 
 		if (o->arg == GOH_ARG_REQUIRED)
 			shortopt_sz++;
@@ -98,8 +101,10 @@ static char *build_shortopt(const struct goh_option *opts, size_t cnt,
 
 	ptr = shortopt;
 	for (o = opts; o < opts + cnt; o++) {
-		if (o->abbr != '\0')
-			*ptr++ = o->abbr;
+		if (o->abbr == '\0')
+			continue;
+
+		*ptr++ = o->abbr;
 
 		/* REQUIRED or OPTIONAL need at least one colon
 		 * OPTIONAL needs a second colon. */
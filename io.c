@@ -0,0 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "error.h"
+#include "io.h"
+
+
+
+/* Size of the extra buffer given to readv when the main one is full. */
+#define BOUNCE_SIZE (64 * 1024)
+
+
+
+static int map_fd(struct io_buf *buf, int fd, size_t len) {
+	void *p;
+
+	/* Private writable mapping: modifying the text in place only copies
+	 * the pages touched. */
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+		return ERR_IO;
+
+	buf->data = p;
+	buf->len = len;
+	buf->mem = len;
+	buf->mapped = 1;
+
+	return ERR_OK;
+}
+
+
+
+/* Make room for at least need bytes in buf. */
+static int grow_buf(struct io_buf *buf, size_t need) {
+	size_t mem = buf->mem;
+	char *p;
+
+	while (mem < need) {
+		if (mem > (size_t)-1 / 2)
+			return ERR_NOMEM;
+		mem *= 2;
+	}
+
+	p = realloc(buf->data, mem);
+	if (p == NULL)
+		return ERR_NOMEM;
+
+	buf->data = p;
+	buf->mem = mem;
+
+	return ERR_OK;
+}
+
+
+
+/*
+ * Read everything from fd into a buffer of hint bytes, grown as needed.
+ * readv fills the spare room of the buffer and then a bounce buffer, so that
+ * the buffer only grows when the data doesn't fit, and never needs a second
+ * system call to find out it was too small.
+ */
+static int read_all(struct io_buf *buf, int fd, size_t hint) {
+	char bounce[BOUNCE_SIZE];
+	struct iovec iov[2];
+	ssize_t nr;
+	int err;
+
+	buf->mem = hint > 0 ? hint : IO_DEFAULT_SIZE;
+	buf->len = 0;
+	buf->mapped = 0;
+	buf->data = malloc(buf->mem);
+	if (buf->data == NULL)
+		return ERR_NOMEM;
+
+	for (;;) {
+		size_t room = buf->mem - buf->len;
+
+		iov[0].iov_base = buf->data + buf->len;
+		iov[0].iov_len = room;
+		iov[1].iov_base = bounce;
+		iov[1].iov_len = sizeof(bounce);
+
+		nr = readv(fd, iov, 2);
+		if (nr < 0 && errno == EINTR)
+			continue;
+
+		if (nr < 0) {
+			err = ERR_IO;
+			goto err_read;
+		}
+
+		if (nr == 0)
+			break;
+
+		if ((size_t)nr <= room) {
+			buf->len += nr;
+			continue;
+		}
+
+		buf->len = buf->mem;
+		nr -= room;
+
+		err = grow_buf(buf, buf->len + nr);
+		if (err != ERR_OK)
+			goto err_read;
+
+		memcpy(buf->data + buf->len, bounce, nr);
+		buf->len += nr;
+	}
+
+	return ERR_OK;
+
+err_read:
+	free(buf->data);
+	memset(buf, 0, sizeof(*buf));
+	return err;
+}
+
+
+
+int io_read_fd(struct io_buf *buf, int fd) {
+	struct stat st;
+	size_t hint = 0;
+	off_t off;
+
+	memset(buf, 0, sizeof(*buf));
+
+	if (fstat(fd, &st) == -1)
+		return ERR_IO;
+
+	/* Like read, start at the current position, which isn't 0 when the
+	 * beginning of stdin was consumed by another process. Only a whole
+	 * file gets mapped. */
+	off = S_ISREG(st.st_mode) ? lseek(fd, 0, SEEK_CUR) : 0;
+	if (off == -1)
+		return ERR_IO;
+
+	if (S_ISREG(st.st_mode) && st.st_size > off) {
+		if (off == 0 && map_fd(buf, fd, st.st_size) == ERR_OK)
+			return ERR_OK;
+
+		/* Some filesystems can't mmap, still use the known size. */
+		hint = st.st_size - off;
+	}
+
+	return read_all(buf, fd, hint);
+}
+
+
+
+int io_read(struct io_buf *buf, const char *filename) {
+	int fd;
+	int err;
+	int saved_errno;
+
+	fd = io_open_read(filename);
+	if (fd == -1)
+		return ERR_IO;
+
+	err = io_read_fd(buf, fd);
+
+	/* The mapping stays valid after the file is closed. */
+	saved_errno = errno;
+	io_close(fd);
+	errno = saved_errno;
+
+	return err;
+}
+
+
+
+void io_release(struct io_buf *buf) {
+	if (buf->mapped)
+		munmap(buf->data, buf->mem);
+	else
+		free(buf->data);
+
+	memset(buf, 0, sizeof(*buf));
+}
+
+
+
+int io_write_fd(int fd, const char *data, size_t len) {
+	while (len > 0) {
+		ssize_t nw = write(fd, data, len);
+
+		if (nw < 0 && errno == EINTR)
+			continue;
+
+		if (nw < 0)
+			return ERR_IO;
+
+		data += nw;
+		len -= nw;
+	}
+
+	return ERR_OK;
+}
+
+
+
+int io_write(const char *filename, const char *data, size_t len) {
+	int fd;
+	int err;
+
+	fd = io_open_write(filename);
+	if (fd == -1)
+		return ERR_IO;
+
+	err = io_write_fd(fd, data, len);
+
+	if (io_close(fd) == -1 && err == ERR_OK)
+		err = ERR_IO;
+
+	return err;
+}
+
+
+
+int io_open_read(const char *filename) {
+	if (strcmp(filename, "-") == 0)
+		return STDIN_FILENO;
+
+	return open(filename, O_RDONLY);
+}
+
+
+
+int io_open_write(const char *filename) {
+	if (strcmp(filename, "-") == 0)
+		return STDOUT_FILENO;
+
+	return open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+
+
+ssize_t io_read_some(int fd, char *data, size_t len) {
+	ssize_t nr;
+
+	do {
+		nr = read(fd, data, len);
+	} while (nr < 0 && errno == EINTR);
+
+	return nr;
+}
+
+
+
+int io_close(int fd) {
+	if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+		return 0;
+
+	return close(fd);
+}
+
+
+
+static int stat_name(const char *filename, int stdfd, struct stat *st) {
+	if (strcmp(filename, "-") == 0)
+		return fstat(stdfd, st);
+
+	return stat(filename, st);
+}
+
+
+
+int io_same_file(const char *filenamein, const char *filenameout) {
+	struct stat st1, st2;
+
+	if (stat_name(filenamein, STDIN_FILENO, &st1) == -1)
+		return 0;
+
+	if (stat_name(filenameout, STDOUT_FILENO, &st2) == -1)
+		return 0;
+
+	return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+}
+
+
+
+int io_detach(struct io_buf *buf) {
+	char *p;
+
+	if (!buf->mapped)
+		return ERR_OK;
+
+	p = malloc(buf->len);
+	if (p == NULL)
+		return ERR_NOMEM;
+
+	memcpy(p, buf->data, buf->len);
+	munmap(buf->data, buf->mem);
+
+	buf->data = p;
+	buf->mem = buf->len;
+	buf->mapped = 0;
+
+	return ERR_OK;
+}
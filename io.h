@@ -0,0 +1,82 @@
+#ifndef IO_H__
+#define IO_H__
+
+/*
+ * This module load and store whole files.
+ * Regular files are mapped in memory rather than copied. Other files like
+ * pipes are read into a buffer pre-sized as much as possible.
+ * The data loaded is not nul-terminated, its length is given alongside.
+ */
+
+#include <sys/types.h>
+
+
+/* Size of the buffer allocated to read a file of unknown size. */
+#define IO_DEFAULT_SIZE (1024 * 1024)
+
+
+struct io_buf {
+	char *data;
+	size_t len;
+
+	/* Size of the mapping or of the allocated buffer. */
+	size_t mem;
+	int mapped;
+};
+
+
+
+/*
+ * Load a file. The filename may be "-" to read from stdin.
+ * The data is private to the process and may be modified in place, the
+ * modifications never reach the file.
+ * Return ERR_IO with errno set when a system call fails.
+ */
+int io_read(struct io_buf *buf, const char *filename);
+
+/* Same as io_read, but from an already opened file descriptor. */
+int io_read_fd(struct io_buf *buf, int fd);
+
+/* Release the data loaded by io_read. */
+void io_release(struct io_buf *buf);
+
+/*
+ * Write len bytes of data to a file. The filename may be "-" to write to
+ * stdout.
+ * Return ERR_IO with errno set when a system call fails.
+ */
+int io_write(const char *filename, const char *data, size_t len);
+
+/* Same as io_write, but to an already opened file descriptor. */
+int io_write_fd(int fd, const char *data, size_t len);
+
+/*
+ * Open a file for reading or writing. The filename may be "-" for stdin or
+ * stdout. Return -1 with errno set on error.
+ */
+int io_open_read(const char *filename);
+int io_open_write(const char *filename);
+
+/*
+ * Read at most len bytes from fd, retrying when interrupted by a signal.
+ * Return the number of bytes read, 0 at the end of the file, or -1 with errno
+ * set on error.
+ */
+ssize_t io_read_some(int fd, char *data, size_t len);
+
+/* Close a file opened by io_open_*, unless it's stdin or stdout. */
+int io_close(int fd);
+
+/*
+ * Tell whether the two file names refer to the same file. "-" refers to
+ * stdin or stdout.
+ */
+int io_same_file(const char *filenamein, const char *filenameout);
+
+/*
+ * Make sure the data doesn't depend on the file anymore, by copying it if it
+ * is mapped. Needed before truncating the file it was read from.
+ */
+int io_detach(struct io_buf *buf);
+
+#endif
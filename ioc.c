@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "charset.h"
+#include "arena.h"
+#include "deadline.h"
+#include "checkpoint.h"
+#include "ioc.h"
+
+
+
+int ioc_init(struct ioc *ic, const char *str, size_t len, size_t maxlen,
+             const struct charset *charset, struct arena *arena) {
+	memset(ic, 0, sizeof(*ic));
+	ic->str = str;
+	ic->str_len = len;
+	ic->charset = charset;
+	ic->arena = arena;
+
+	/* Every column need at least two characters to have an index of
+	 * coincidence. */
+	if (maxlen > len / 2)
+		maxlen = len / 2;
+	ic->maxlen = maxlen;
+
+	ic->score = arena_alloc(arena, (maxlen + 1) * sizeof(*ic->score));
+	if (ic->score == NULL)
+		return ERR_NOMEM;
+
+	memset(ic->score, 0, (maxlen + 1) * sizeof(*ic->score));
+	return ERR_OK;
+}
+
+
+
+void ioc_fini(struct ioc *ic) {
+	arena_free(ic->arena, ic->score);
+	memset(ic, 0, sizeof(*ic));
+}
+
+
+
+/* Index of coincidence of one column given its character counts. */
+static float column_ioc(const size_t *count, size_t n, size_t total) {
+	double sum = 0;
+	size_t i;
+
+	if (total < 2)
+		return 0;
+
+	for (i = 0; i < n; i++)
+		sum += (double)count[i] * (count[i] - 1);
+
+	return sum / ((double)total * (total - 1));
+}
+
+
+
+int ioc_analyze(struct ioc *ic) {
+	const struct charset *cs = ic->charset;
+	unsigned char *ord;
+	size_t *count;
+	size_t klen, col, i;
+
+	ord = arena_alloc(ic->arena, ic->str_len * sizeof(*ord) + 1);
+	count = arena_alloc(ic->arena, cs->length * sizeof(*count));
+	if (ord == NULL || count == NULL) {
+		arena_free(ic->arena, ord);
+		arena_free(ic->arena, count);
+		return ERR_NOMEM;
+	}
+
+	/* The characters are looked up only once for all the key lengths. */
+	for (i = 0; i < ic->str_len; i++)
+		ord[i] = CS_TABLE_ORD(cs, ic->str[i]);
+
+	for (klen = 1; klen <= ic->maxlen; klen++) {
+		double sum = 0;
+
+		if (deadline_passed(ic->deadline)) {
+			ic->expired = 1;
+			break;
+		}
+
+		for (col = 0; col < klen; col++) {
+			size_t total = 0;
+
+			memset(count, 0, cs->length * sizeof(*count));
+			for (i = col; i < ic->str_len; i += klen) {
+				count[ord[i]]++;
+				total++;
+			}
+
+			sum += column_ioc(count, cs->length, total);
+		}
+
+		ic->score[klen] = sum / klen * cs->length;
+	}
+
+	arena_free(ic->arena, count);
+	arena_free(ic->arena, ord);
+	return ERR_OK;
+}
+
+
+
+size_t ioc_best_length(const struct ioc *ic) {
+	return ioc_best_score(ic->score, ic->maxlen);
+}
+
+
+
+size_t ioc_best_score(const float *score, size_t maxlen) {
+	float best = 0;
+	float threshold;
+	size_t i;
+
+	for (i = 1; i <= maxlen; i++) {
+		if (score[i] > best)
+			best = score[i];
+	}
+
+	/* Random text score 1. Take the first length that gets most of the way
+	 * from there to the best score. */
+	threshold = 1 + (best - 1) * 0.8;
+
+	for (i = 1; i <= maxlen; i++) {
+		if (score[i] >= threshold)
+			return i;
+	}
+
+	return 1;
+}
+
+
+
+int ioc_save(const struct ioc *ic, struct ckpt *c) {
+	int err;
+
+	err = ckpt_put(c, ic->str_len);
+	if (err == ERR_OK)
+		err = ckpt_put(c, ic->maxlen);
+	if (err == ERR_OK)
+		err = ckpt_put_bytes(c, ic->score + 1,
+		                     ic->maxlen * sizeof(*ic->score));
+
+	return err;
+}
+
+
+
+int ioc_restore(struct ioc *ic, struct ckpt *c) {
+	size_t len, maxlen;
+	int err;
+
+	err = ckpt_get(c, &len);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &maxlen);
+	if (err != ERR_OK)
+		return err;
+
+	if (len != ic->str_len || maxlen != ic->maxlen)
+		return ERR_FORMAT;
+
+	return ckpt_get_bytes(c, ic->score + 1,
+	                      ic->maxlen * sizeof(*ic->score));
+}
@@ -0,0 +1,78 @@
+#ifndef IOC_H__
+#define IOC_H__
+
+/*
+ * This module estimate the key length with the index of coincidence.
+ * For every candidate length, the text is split into as many columns, one for
+ * each key letter. When the length is right, every column has been shifted by
+ * the same amount and keep the index of coincidence of the language. When it's
+ * wrong, the columns look like random text.
+ */
+
+
+#include <sys/types.h>
+
+#include "charset.h"
+#include "arena.h"
+#include "checkpoint.h"
+
+
+/* Longest key length tested by default. */
+#define IOC_DEFAULT_MAXLEN 40
+
+
+
+struct ioc {
+	const char *str;
+	size_t str_len;
+	size_t maxlen;
+	const struct charset *charset;
+
+	/* ioc_analyze fill this array so that score[klen] is the mean index
+	 * of coincidence of the klen columns, multiplied by the charset length.
+	 * Random text is thus around 1 and English text around 1.7. score[0]
+	 * is unused. */
+	float *score;
+
+	struct arena *arena;
+
+	/* When to stop, see deadline.h. 0 by default. The key lengths not
+	 * analyzed in time keep a score of 0. */
+	double deadline;
+	int expired;
+};
+
+
+
+/* Initialize a struct ioc to analyze the len bytes of str with key lengths up
+ * to maxlen. arena may be NULL to use malloc. */
+int ioc_init(struct ioc *ic, const char *str, size_t len, size_t maxlen,
+             const struct charset *charset, struct arena *arena);
+
+/* Deinitialize a struct ioc. */
+void ioc_fini(struct ioc *ic);
+
+/* Compute the score of every key length. Set expired if the deadline passed
+ * before the end. */
+int ioc_analyze(struct ioc *ic);
+
+/* Save the scores to a checkpoint of kind CKPT_IOC. */
+int ioc_save(const struct ioc *ic, struct ckpt *c);
+
+/* Restore the scores saved by ioc_save instead of running ioc_analyze.
+ * Return ERR_FORMAT if they were saved for another text length or maxlen, the
+ * scores are then left untouched. */
+int ioc_restore(struct ioc *ic, struct ckpt *c);
+
+/*
+ * Return the most probable key length. That's the shortest one whose score
+ * is close to the best one, since the multiples of the key length score as
+ * well as the key length itself.
+ */
+size_t ioc_best_length(const struct ioc *ic);
+
+/* Same as ioc_best_length for a table of scores computed elsewhere, score[1]
+ * to score[maxlen]. */
+size_t ioc_best_score(const float *score, size_t maxlen);
+
+#endif
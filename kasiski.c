@@ -2,28 +2,36 @@
 #include <string.h>
 #include <sys/types.h>
 
-#include "misc.h"
+#include "error.h"
+#include "arena.h"
+#include "trace.h"
+#include "deadline.h"
+#include "checkpoint.h"
 #include "kasiski.h"
 
 
 
-void ka_init(struct kasiski *k, const char *str, size_t minlen) {
+int ka_init(struct kasiski *k, const char *str, size_t len, size_t minlen,
+            struct arena *arena) {
 	memset(k, 0, sizeof(*k));
 	k->str = str;
-	k->str_len = strlen(str);
+	k->str_len = len;
 	k->minlen = minlen;
+	k->arena = arena;
+	k->next = minlen;
 
-	k->score = malloc(k->str_len * sizeof(*k->score));
-	if (k->score == NULL)
-		system_error("malloc");
+	k->score = arena_alloc(arena, k->str_len * sizeof(*k->score));
+	if (k->score == NULL && len > 0)
+		return ERR_NOMEM;
 
 	memset(k->score, 0, k->str_len * sizeof(*k->score));
+	return ERR_OK;
 }
 
 
 
 void ka_fini(struct kasiski *k) {
-	free(k->score);
+	arena_free(k->arena, k->score);
 	memset(k, 0, sizeof(*k));
 }
 
@@ -36,7 +44,7 @@ static size_t analyze_offset_count(struct kasiski *k, size_t off) {
 	ssize_t match_start = -1;
 	size_t i;
 
-	for (i = off; k->str[i] != '\0'; i++) {
+	for (i = off; i < k->str_len; i++) {
 		char c1 = k->str[i];
 		char c2 = k->str[i - off];
 
@@ -77,8 +85,82 @@ static void analyze_offset(struct kasiski *k, size_t off) {
 
 
 void ka_analyze(struct kasiski *k) {
-	size_t i;
+	size_t i, first, end;
+	double t;
+
+	k->expired = 0;
+	for (first = k->next; first < k->str_len; first = end) {
+		end = first + KA_TRACE_RANGE;
+		if (end > k->str_len)
+			end = k->str_len;
+
+		t = trace_begin(k->trace);
+		for (i = first; i < end; i++) {
+			/* An offset alone may take a while on a long text. */
+			if (deadline_passed(k->deadline)) {
+				k->expired = 1;
+				break;
+			}
+
+			analyze_offset(k, i);
+			k->next = i + 1;
+		}
+		trace_end(k->trace, t, "kasiski offsets", NULL, first);
+
+		if (k->expired)
+			break;
+	}
+}
+
+
+
+int ka_save(const struct kasiski *k, struct ckpt *c) {
+	size_t i, end;
+	int err;
+
+	err = ckpt_put(c, k->str_len);
+	if (err == ERR_OK)
+		err = ckpt_put(c, k->minlen);
+	if (err == ERR_OK)
+		err = ckpt_put(c, k->next);
+
+	/* The offsets not analyzed yet have added nothing to the scores from
+	 * k->next on. */
+	end = k->next < k->str_len ? k->next : k->str_len;
+	for (i = 0; i < end && err == ERR_OK; i++)
+		err = ckpt_put(c, k->score[i]);
+
+	return err;
+}
+
+
+
+int ka_restore(struct kasiski *k, struct ckpt *c) {
+	size_t len, minlen, next;
+	size_t i, end;
+	int err;
+
+	err = ckpt_get(c, &len);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &minlen);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &next);
+	if (err != ERR_OK)
+		return err;
+
+	if (len != k->str_len || minlen != k->minlen || next < minlen)
+		return ERR_FORMAT;
+
+	end = next < len ? next : len;
+	for (i = 0; i < end && err == ERR_OK; i++)
+		err = ckpt_get(c, &k->score[i]);
+
+	/* Back to a fresh start rather than half restored. */
+	if (err != ERR_OK) {
+		memset(k->score, 0, k->str_len * sizeof(*k->score));
+		return err;
+	}
 
-	for (i = k->minlen; i < k->str_len; i++)
-		analyze_offset(k, i);
+	k->next = next;
+	return ERR_OK;
 }
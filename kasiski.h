@@ -11,6 +11,14 @@
 
 #include <sys/types.h>
 
+#include "arena.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+
+/* Number of offsets analyzed in a single trace span. */
+#define KA_TRACE_RANGE 256
+
 
 
 
@@ -22,18 +30,43 @@ struct kasiski {
 	/* ka_analyze will fill this array so that score[klen] is the number of
 	 * substring of str that has been found at n*klen distance. */
 	size_t *score;
+
+	struct arena *arena;
+
+	/* Where to record the progress of the analysis. NULL by default. */
+	struct trace_buf *trace;
+
+	/* When to stop, see deadline.h. 0 by default. The offsets are analyzed
+	 * in increasing order, so the scores then only count the repetitions
+	 * closer than the last offset analyzed. */
+	double deadline;
+	int expired;
+
+	/* Next offset to analyze. Running ka_analyze again continues from
+	 * there. */
+	size_t next;
 };
 
 
 
-/* Initialize a kasiski structure. minlen is the minimal length of the
- * substrings to match. */
-void ka_init(struct kasiski *k, const char *str, size_t minlen);
+/* Initialize a kasiski structure to analyze the len bytes of str. minlen is
+ * the minimal length of the substrings to match. arena may be NULL to use
+ * malloc. */
+int ka_init(struct kasiski *k, const char *str, size_t len, size_t minlen,
+            struct arena *arena);
 
 /* Deinitialize a kasiski structure. */
 void ka_fini(struct kasiski *k);
 
-/* Perform a Kasiski analysis. */
+/* Perform a Kasiski analysis. Set expired if the deadline passed before the
+ * end, and clear it otherwise. */
 void ka_analyze(struct kasiski *k);
 
+/* Save the progress of the analysis to a checkpoint of kind CKPT_KASISKI. */
+int ka_save(const struct kasiski *k, struct ckpt *c);
+
+/* Restore the progress saved by ka_save. Return ERR_FORMAT if it was saved for
+ * another text length or minlen, the analysis then starts from scratch. */
+int ka_restore(struct kasiski *k, struct ckpt *c);
+
 #endif
@@ -0,0 +1,54 @@
+#ifndef LIBUNVIGENERE_H__
+#define LIBUNVIGENERE_H__
+
+/*
+ * Public header of libunvigenere.
+ *
+ * The library never exits the process nor print anything: every function that
+ * may fail returns an error code from error.h. It has no global mutable state.
+ * A struct charset is read-only once built and may be shared between threads,
+ * whereas a struct fs_ctx or a struct cracker must only be used by one thread
+ * at a time.
+ *
+ * Typical use to crack a text:
+ *   cs_init(&cs); cs_add(&cs, CHARSET_UPPER); cs_add(&cs, CHARSET_LOWER);
+ *   fs_init(&s, text, len, &cs, NULL);
+ *   ck_init(&ck, &s);
+ *   ck_crack(&ck);
+ *   vig_decrypt(&s, ck.key);
+ */
+
+#include "error.h"
+#include "arena.h"
+#include "perf.h"
+#include "stats.h"
+#include "trace.h"
+#include "deadline.h"
+#include "checkpoint.h"
+#include "cache.h"
+#include "charset.h"
+#include "filtered_string.h"
+#include "freq.h"
+#include "kasiski.h"
+#include "ioc.h"
+#include "crib.h"
+#include "dict.h"
+#include "corpus.h"
+#include "ngram.h"
+#include "brute.h"
+#include "beam.h"
+#include "mfreq_analysis.h"
+#include "cracker.h"
+#include "online.h"
+#include "vigenere.h"
+#include "bytes.h"
+#include "bytecrack.h"
+#include "io.h"
+#include "pipeline.h"
+#include "aio.h"
+#include "batch.h"
+#include "proto.h"
+#include "server.h"
+#include "records.h"
+
+#endif
@@ -2,20 +2,24 @@
 #include <string.h>
 #include <float.h>
 
-#include "misc.h"
+#include "error.h"
 #include "charset.h"
 #include "freq.h"
+#include "arena.h"
+#include "trace.h"
+#include "deadline.h"
+#include "checkpoint.h"
 #include "mfreq_analysis.h"
 
 
 
-float freq_en[] = {
+const float freq_en[] = {
 	0.0808, 0.0167, 0.0318, 0.0399, 0.1256, 0.0217, 0.0180, 0.0527, 0.0724,
 	0.0014, 0.0063, 0.0404, 0.0260, 0.0738, 0.0747, 0.0191, 0.0009, 0.0642,
 	0.0659, 0.0915, 0.0279, 0.0100, 0.0189, 0.0021, 0.0165, 0.0007
 };
 
-float freq_fr[] = {
+const float freq_fr[] = {
 	0.0920, 0.0102, 0.0264, 0.0339, 0.1587, 0.0095, 0.0104, 0.0077, 0.0841,
 	0.0089, 0.0000, 0.0534, 0.0324, 0.0715, 0.0514, 0.0286, 0.0106, 0.0646,
 	0.0790, 0.0726, 0.0624, 0.0215, 0.0000, 0.0030, 0.0024, 0.0032
@@ -26,43 +30,68 @@ float freq_fr[] = {
 
 
 
-void mfa_init(struct mfreq *mfa, const char *str, size_t klen,
-              const struct charset *charset, const float *reffreq) {
+int mfa_init(struct mfreq *mfa, const char *str, size_t len, size_t klen,
+             const struct charset *charset, const float *reffreq,
+             struct arena *arena) {
 	size_t i;
+	int err;
 
 	memset(mfa, 0, sizeof(*mfa));
 
 	mfa->str = str;
+	mfa->str_len = len;
 	mfa->klen = klen;
 	mfa->charset = charset;
+	mfa->arena = arena;
 
 	if (reffreq != NULL)
 		mfa->reffreq = reffreq;
 	else
 		mfa->reffreq = freq_en;
 
-	mfa->freq = malloc(sizeof(*mfa->freq) * klen);
+	mfa->freq = arena_alloc(arena, sizeof(*mfa->freq) * klen);
 	if (mfa->freq == NULL)
-		system_error("malloc");
+		goto err_freq;
 
-	for (i = 0; i < klen; i++)
-		freq_init(&mfa->freq[i], charset);
+	for (i = 0; i < klen; i++) {
+		err = freq_init(&mfa->freq[i], charset, arena);
+		if (err != ERR_OK)
+			goto err_freq_init;
+	}
 
-	mfa->shift = malloc(sizeof(*mfa->shift) * klen);
+	mfa->shift = arena_alloc(arena, sizeof(*mfa->shift) * klen);
 	if (mfa->shift == NULL)
-		system_error("malloc");
+		goto err_freq_init;
+
+	mfa->dist = arena_alloc(arena, sizeof(*mfa->dist) * klen *
+	                        charset->length);
+	if (mfa->dist == NULL)
+		goto err_dist;
+
+	return ERR_OK;
+
+err_dist:
+	arena_free(arena, mfa->shift);
+err_freq_init:
+	while (i-- > 0)
+		freq_fini(&mfa->freq[i]);
+	arena_free(arena, mfa->freq);
+err_freq:
+	memset(mfa, 0, sizeof(*mfa));
+	return ERR_NOMEM;
 }
 
 
 
 void mfa_fini(struct mfreq *mfa) {
 	size_t i;
-	free(mfa->shift);
+	arena_free(mfa->arena, mfa->dist);
+	arena_free(mfa->arena, mfa->shift);
 
 	for (i = 0; i < mfa->klen; i++)
 		freq_fini(&mfa->freq[i]);
 
-	free(mfa->freq);
+	arena_free(mfa->arena, mfa->freq);
 
 	memset(mfa, 0, sizeof(*mfa));
 }
@@ -95,14 +124,16 @@ static float freq_distance_shift(const struct mfreq *mfa, size_t off,
 
 /* Compute the best shift for a given array of frequencies.
  * The "best shift" is defined as the one that makes the frequency the closer to
- * the wanted frequencies. */
+ * the wanted frequencies. The distance of every shift is kept in mfa->dist. */
 static size_t best_shift(const struct mfreq *mfa, size_t n) {
+	float *dist = mfa->dist + n * mfa->charset->length;
 	float bd = FLT_MAX;
 	size_t bs;
 	size_t i;
 
 	for (i = 0; i < mfa->charset->length; i++) {
 		float d = freq_distance_shift(mfa, n, i);
+		dist[i] = d;
 		if (d < bd) {
 			bd = d;
 			bs = i;
@@ -115,13 +146,100 @@ static size_t best_shift(const struct mfreq *mfa, size_t n) {
 
 
 /* Compute the frequencies and the best shifts. */
-void mfa_analyze(struct mfreq *mfa) {
+int mfa_analyze(struct mfreq *mfa) {
 	size_t i;
+	int err;
 
 	memset(mfa->shift, 0, sizeof(*mfa->shift) * mfa->klen);
 
 	for (i = 0; i < mfa->klen; i++) {
-		freq_compute_stride(&mfa->freq[i], mfa->str + i, mfa->klen);
+		size_t len = mfa->str_len > i ? mfa->str_len - i : 0;
+		double t = trace_begin(mfa->trace);
+
+		if (!mfa->freq_done && !mfa->expired &&
+		    deadline_passed(mfa->deadline))
+			mfa->expired = 1;
+
+		if (mfa->expired && len > MFA_LATE_SAMPLE)
+			len = MFA_LATE_SAMPLE;
+
+		if (!mfa->freq_done) {
+			err = freq_compute_stride(&mfa->freq[i], mfa->str + i,
+			                          len, mfa->klen);
+			if (err != ERR_OK)
+				return err;
+		}
+
 		mfa->shift[i] = best_shift(mfa, i);
+		trace_end(mfa->trace, t, "freq column", NULL, i);
 	}
+
+	return ERR_OK;
+}
+
+
+
+void mfa_candidates(const struct mfreq *mfa, size_t col, size_t n,
+                    size_t *shifts) {
+	const float *dist = mfa->dist + col * mfa->charset->length;
+	size_t i, j;
+
+	/* Insertion sort of the n best, the earlier shift wins the ties. */
+	for (i = 0; i < mfa->charset->length; i++) {
+		for (j = i < n ? i : n; j > 0; j--) {
+			if (dist[shifts[j - 1]] <= dist[i])
+				break;
+			if (j < n)
+				shifts[j] = shifts[j - 1];
+		}
+
+		if (j < n)
+			shifts[j] = i;
+	}
+}
+
+
+
+int mfa_save(const struct mfreq *mfa, struct ckpt *c) {
+	size_t n = mfa->charset->length;
+	size_t i;
+	int err;
+
+	err = ckpt_put(c, mfa->str_len);
+	if (err == ERR_OK)
+		err = ckpt_put(c, mfa->klen);
+	if (err == ERR_OK)
+		err = ckpt_put(c, n);
+
+	for (i = 0; i < mfa->klen && err == ERR_OK; i++)
+		err = ckpt_put_bytes(c, mfa->freq[i].freq,
+		                     n * sizeof(*mfa->freq[i].freq));
+
+	return err;
+}
+
+
+
+int mfa_restore(struct mfreq *mfa, struct ckpt *c) {
+	size_t n = mfa->charset->length;
+	size_t len, klen, cslen, i;
+	int err;
+
+	err = ckpt_get(c, &len);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &klen);
+	if (err == ERR_OK)
+		err = ckpt_get(c, &cslen);
+	if (err != ERR_OK)
+		return err;
+
+	if (len != mfa->str_len || klen != mfa->klen || cslen != n)
+		return ERR_FORMAT;
+
+	for (i = 0; i < klen && err == ERR_OK; i++)
+		err = ckpt_get_bytes(c, mfa->freq[i].freq,
+		                     n * sizeof(*mfa->freq[i].freq));
+
+	mfa->freq_done = err == ERR_OK;
+	return err;
 }
@@ -11,17 +11,26 @@
 
 #include "charset.h"
 #include "freq.h"
+#include "arena.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+
+/* Number of characters of the text the columns are still analyzed on once the
+ * deadline passed. */
+#define MFA_LATE_SAMPLE 16384
 
 
 /* The frequencies for letters A..Z for several pre-defined languages. */
-extern float freq_en[];
-extern float freq_fr[];
+extern const float freq_en[];
+extern const float freq_fr[];
 
 
 
 
 struct mfreq {
 	const char *str;
+	size_t str_len;
 	size_t klen;
 
 	const struct charset *charset;
@@ -32,19 +41,59 @@ struct mfreq {
 
 	/* Best shifts. */
 	size_t *shift;
+
+	/* Distance to the reference frequencies of every shift of every
+	 * column: dist[i * charset->length + s] for the shift s of the column
+	 * i. Lower is better. */
+	float *dist;
+
+	struct arena *arena;
+
+	/* Where to record the analysis of every column. NULL by default. */
+	struct trace_buf *trace;
+
+	/* When to hurry, see deadline.h. 0 by default. */
+	double deadline;
+	int expired;
+
+	/* Whether freq already holds the frequencies of the columns, set by
+	 * mfa_restore. mfa_analyze then only computes the shifts. */
+	int freq_done;
 };
 
 
 
-/* Initialize a struct mfreq. */
-void mfa_init(struct mfreq *mfa, const char *str, size_t klen,
-              const struct charset *charset, const float *reffreq);
+/* Initialize a struct mfreq to analyze the len bytes of str. arena may be
+ * NULL to use malloc. */
+int mfa_init(struct mfreq *mfa, const char *str, size_t len, size_t klen,
+             const struct charset *charset, const float *reffreq,
+             struct arena *arena);
 
 /* Deinitialize a struct mfreq. */
 void mfa_fini(struct mfreq *mfa);
 
-/* Compute the frequencies and the best shifts. */
-void mfa_analyze(struct mfreq *mfa);
+/*
+ * Compute the frequencies and the best shifts.
+ * Once the deadline passed, the remaining columns are only analyzed on the
+ * first MFA_LATE_SAMPLE characters of the text and expired is set. Every
+ * column thus still gets a shift.
+ */
+int mfa_analyze(struct mfreq *mfa);
+
+/* Save the frequencies of the columns to a checkpoint of kind CKPT_FREQ. Only
+ * available after mfa_analyze. */
+int mfa_save(const struct mfreq *mfa, struct ckpt *c);
+
+/* Restore the frequencies saved by mfa_save. Return ERR_FORMAT if they were
+ * saved for another text length, key length or charset length. */
+int mfa_restore(struct mfreq *mfa, struct ckpt *c);
+
+/*
+ * Fill shifts with the n best shifts of the column col, best first. n must not
+ * be more than the charset length. Only available after mfa_analyze.
+ */
+void mfa_candidates(const struct mfreq *mfa, size_t col, size_t n,
+                    size_t *shifts);
 
 /* TODO: Change the shift of the n-th element and return the new distance to
  * language frequencies. */
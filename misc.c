@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include "error.h"
 #include "misc.h"
 
 
@@ -45,6 +46,13 @@ void custom_error(const char *format, ...) {
 
 
 
+void check(int err, const char *what) {
+	if (err != ERR_OK)
+		custom_error("%s: %s", what, err_str(err));
+}
+
+
+
 int asprintf(char **str, const char *format, ...) {
 	va_list ap;
 	int ret;
@@ -25,6 +25,13 @@ __printf_fmt(1,2) void custom_warn(const char *format, ...);
 __printf_fmt(1,2) void custom_error(const char *format, ...);
 
 
+/*
+ * Print what failed and the message of the error code on stderr and abort(),
+ * unless err is ERR_OK
+ */
+void check(int err, const char *what);
+
+
 /*
  * sprintf that allocate the buffer to write in
  * The buffer must be freed with free()
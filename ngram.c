@@ -0,0 +1,123 @@
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+
+#include "corpus.h"
+#include "ngram.h"
+
+
+
+/* Added to every count so that the unseen bigrams are not impossible. */
+#define NGRAM_SMOOTHING 0.5
+
+
+
+/* Position of a letter of the corpus, -1 for anything else. */
+static int letter_of(char c) {
+	if (c >= 'a' && c <= 'z')
+		return c - 'a';
+
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+
+	return -1;
+}
+
+
+
+void ngram_train_en(struct ngram *m) {
+	double uni[NGRAM_NSYM];
+	double bi[NGRAM_NSYM][NGRAM_NSYM];
+	double total, row;
+	size_t i;
+	int a, b;
+
+	memset(uni, 0, sizeof(uni));
+	memset(bi, 0, sizeof(bi));
+
+	for (i = 0; i < corpus_en_count; i++) {
+		const char *p;
+
+		/* The texts are filtered, the bigrams span over the words. */
+		a = -1;
+		for (p = corpus_en[i]; *p != '\0'; p++) {
+			b = letter_of(*p);
+			if (b == -1)
+				continue;
+
+			uni[b]++;
+			if (a != -1)
+				bi[a][b]++;
+			a = b;
+		}
+	}
+
+	total = 0;
+	for (a = 0; a < NGRAM_NSYM; a++)
+		total += uni[a] + NGRAM_SMOOTHING;
+
+	for (a = 0; a < NGRAM_NSYM; a++) {
+		m->uni[a] = log((uni[a] + NGRAM_SMOOTHING) / total);
+
+		row = 0;
+		for (b = 0; b < NGRAM_NSYM; b++)
+			row += bi[a][b] + NGRAM_SMOOTHING;
+
+		for (b = 0; b < NGRAM_NSYM; b++)
+			m->bi[a * NGRAM_NSYM + b] =
+				log((bi[a][b] + NGRAM_SMOOTHING) / row);
+	}
+}
+
+
+
+float ngram_score(const struct ngram *m, const unsigned char *ord, size_t len) {
+	float s;
+	size_t i;
+
+	if (len == 0)
+		return 0;
+
+	s = m->uni[ord[0]];
+	for (i = 1; i < len; i++)
+		s += m->bi[ord[i - 1] * NGRAM_NSYM + ord[i]];
+
+	return s;
+}
+
+
+
+void ngram_pair_tables(const struct ngram *m, const unsigned char *ord,
+                       size_t len, size_t klen, float *tab, size_t *count) {
+	const size_t n = NGRAM_NSYM;
+	size_t i, t, c0, c1, a, c;
+
+	/* Count the bigrams of every column first, there are much less
+	 * distinct ones than bigrams in a long sample. */
+	memset(count, 0, klen * n * n * sizeof(*count));
+	for (i = 0; i + 1 < len; i++)
+		count[((i % klen) * n + ord[i]) * n + ord[i + 1]]++;
+
+	memset(tab, 0, klen * n * n * sizeof(*tab));
+	for (t = 0; t < klen; t++) {
+		for (c0 = 0; c0 < n; c0++) {
+			for (c1 = 0; c1 < n; c1++) {
+				size_t cnt = count[(t * n + c0) * n + c1];
+
+				if (cnt == 0)
+					continue;
+
+				for (a = 0; a < n; a++) {
+					const float *r;
+					float *dst;
+
+					r = m->bi + ((c0 + n - a) % n) * n;
+					dst = tab + (t * n + a) * n;
+					for (c = 0; c < n; c++)
+						dst[c] += cnt *
+						          r[(c1 + n - c) % n];
+				}
+			}
+		}
+	}
+}
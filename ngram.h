@@ -0,0 +1,51 @@
+#ifndef NGRAM_H__
+#define NGRAM_H__
+
+/*
+ * This module provide a letter bigram model of a language: the probability of
+ * every letter and of every letter following another one. Letters are the
+ * positions 0 to NGRAM_NSYM - 1 of a charset like CHARSET_UPPER, in a text
+ * filtered from its spaces and punctuation.
+ *
+ * Unlike the letter frequencies, a bigram spans two key characters, so it can
+ * tell apart keys whose columns decrypt to equally plausible letters.
+ */
+
+#include <sys/types.h>
+
+#include "charset.h"
+
+
+#define NGRAM_NSYM CS_ALPHA_LEN
+
+
+struct ngram {
+	/* uni[a] is log P(a) and bi[a * NGRAM_NSYM + b] is log P(b | a). */
+	float uni[NGRAM_NSYM];
+	float bi[NGRAM_NSYM * NGRAM_NSYM];
+};
+
+
+
+/* Build the model from the English corpus. */
+void ngram_train_en(struct ngram *m);
+
+/*
+ * Return the log-likelihood of the len letters of ord, which must all be
+ * lower than NGRAM_NSYM.
+ */
+float ngram_score(const struct ngram *m, const unsigned char *ord, size_t len);
+
+/*
+ * Score the bigrams of the len letters of ord once decrypted by a Vigenere
+ * key of length klen, for every pair of consecutive key characters.
+ * tab[(t * NGRAM_NSYM + a) * NGRAM_NSYM + c] is the log-likelihood of the
+ * bigrams starting in the column t when this column is decrypted with the key
+ * character a and the next one with c. The score of a whole key is the sum of
+ * its klen pairs, the last character being followed by the first one.
+ * tab and count must have room for klen * NGRAM_NSYM * NGRAM_NSYM elements.
+ */
+void ngram_pair_tables(const struct ngram *m, const unsigned char *ord,
+                       size_t len, size_t klen, float *tab, size_t *count);
+
+#endif
@@ -0,0 +1,523 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <sys/types.h>
+
+#include "error.h"
+#include "array.h"
+#include "charset.h"
+#include "mfreq_analysis.h"
+#include "ioc.h"
+#include "cracker.h"
+#include "deadline.h"
+#include "online.h"
+
+
+/* Number of hash chains of the substrings, a power of two. */
+#define HASH_SIZE (64 * 1024)
+
+/* End of a hash chain. */
+#define NONE ((size_t)-1)
+
+/* Initial size of the arrays that grow with the text. */
+#define INITIAL_SIZE 4096
+
+/* The deadline is checked every time the text grows by this many characters, a
+ * power of two. */
+#define CHECK_EVERY (64 * 1024)
+
+
+
+int online_init(struct online *ol, const struct charset *charset,
+                size_t maxlen, size_t minlen) {
+	size_t ncols = maxlen * (maxlen + 1) / 2;
+	size_t i;
+
+	memset(ol, 0, sizeof(*ol));
+	ol->charset = charset;
+	ol->maxlen = maxlen;
+	ol->minlen = minlen;
+	ol->window = ONLINE_DEFAULT_WINDOW;
+	ol->estimator = CK_EST_KASISKI;
+
+	if (maxlen == 0 || minlen == 0)
+		return ERR_INVAL;
+
+	if (ARRAY_ALLOC(ol->text, INITIAL_SIZE) != ERR_OK)
+		goto err_text;
+
+	if (ARRAY_ALLOC(ol->prev, INITIAL_SIZE) != ERR_OK)
+		goto err_prev;
+
+	if (ARRAY_ALLOC(ol->repeats, INITIAL_SIZE) != ERR_OK)
+		goto err_repeats;
+
+	if (ARRAY_ALLOC(ol->scored, INITIAL_SIZE) != ERR_OK)
+		goto err_scored;
+
+	if (ARRAY_ALLOC(ol->dirty, INITIAL_SIZE) != ERR_OK)
+		goto err_dirty;
+
+	ol->head = malloc(HASH_SIZE * sizeof(*ol->head));
+	ol->ka_score = calloc(maxlen + 1, sizeof(*ol->ka_score));
+	ol->count = calloc(ncols * charset->length, sizeof(*ol->count));
+	ol->coinc = calloc(ncols, sizeof(*ol->coinc));
+	ol->col = calloc(maxlen + 1, sizeof(*ol->col));
+	ol->ioc_score = calloc(maxlen + 1, sizeof(*ol->ioc_score));
+	ol->key = calloc(maxlen + 1, sizeof(*ol->key));
+	if (ol->head == NULL || ol->ka_score == NULL || ol->count == NULL ||
+	    ol->coinc == NULL || ol->col == NULL || ol->ioc_score == NULL ||
+	    ol->key == NULL)
+		goto err_tables;
+
+	for (i = 0; i < HASH_SIZE; i++)
+		ol->head[i] = NONE;
+
+	return ERR_OK;
+
+err_tables:
+	free(ol->key);
+	free(ol->ioc_score);
+	free(ol->col);
+	free(ol->coinc);
+	free(ol->count);
+	free(ol->ka_score);
+	free(ol->head);
+	ARRAY_FREE(ol->dirty);
+err_dirty:
+	ARRAY_FREE(ol->scored);
+err_scored:
+	ARRAY_FREE(ol->repeats);
+err_repeats:
+	ARRAY_FREE(ol->prev);
+err_prev:
+	ARRAY_FREE(ol->text);
+err_text:
+	memset(ol, 0, sizeof(*ol));
+	return ERR_NOMEM;
+}
+
+
+
+void online_fini(struct online *ol) {
+	free(ol->key);
+	free(ol->ioc_score);
+	free(ol->col);
+	free(ol->coinc);
+	free(ol->count);
+	free(ol->ka_score);
+	free(ol->head);
+	ARRAY_FREE(ol->dirty);
+	ARRAY_FREE(ol->scored);
+	ARRAY_FREE(ol->repeats);
+	ARRAY_FREE(ol->prev);
+	ARRAY_FREE(ol->text);
+	memset(ol, 0, sizeof(*ol));
+}
+
+
+
+/* Make room for one more character in the arrays that follow the text. */
+static int reserve(struct online *ol) {
+	int err;
+
+	if (ol->text_size == ol->text_mem) {
+		err = ARRAY_GROW(ol->text);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	if (ol->text_size == ol->prev_mem) {
+		err = ARRAY_GROW(ol->prev);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	if (ol->text_size == ol->repeats_mem) {
+		err = ARRAY_GROW(ol->repeats);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	if (ol->text_size == ol->scored_mem) {
+		err = ARRAY_GROW(ol->scored);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return ERR_OK;
+}
+
+
+
+/* Count one more repeated substring at the distance off. */
+static int add_repeat(struct online *ol, size_t off) {
+	int err;
+
+	if (ol->repeats[off] == ol->scored[off]) {
+		err = ARRAY_APPEND(ol->dirty, off);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	ol->repeats[off]++;
+	return ERR_OK;
+}
+
+
+
+/*
+ * Bring the Kasiski scores up to date with the distances whose count changed,
+ * the way ka_analyze computes them from the count of every distance.
+ */
+static void update_scores(struct online *ol) {
+	size_t d, i;
+
+	for (d = 0; d < ol->dirty_size; d++) {
+		size_t off = ol->dirty[d];
+		size_t old = ol->scored[off];
+		size_t new = ol->repeats[off];
+		size_t end = off / 2;
+
+		if (end > ol->maxlen)
+			end = ol->maxlen;
+
+		for (i = 1; i <= end; i++) {
+			if (old % i == 0)
+				ol->ka_score[i] -= old;
+			if (new % i == 0)
+				ol->ka_score[i] += new;
+		}
+
+		if (off <= ol->maxlen)
+			ol->ka_score[off] += new - old;
+
+		ol->scored[off] = new;
+	}
+
+	ol->dirty_size = 0;
+}
+
+
+
+/* Look for the earlier occurrences of the substring that ends with the last
+ * character received. */
+static int index_substring(struct online *ol) {
+	const unsigned char *text = ol->text;
+	size_t p = ol->text_size - ol->minlen;
+	size_t h = 0;
+	size_t q, i;
+	int err;
+
+	for (i = 0; i < ol->minlen; i++)
+		h = h * 31 + text[p + i];
+	h &= HASH_SIZE - 1;
+
+	for (q = ol->head[h]; q != NONE; q = ol->prev[q]) {
+		/* The chains go backward, the rest is even farther. */
+		if (ol->window != 0 && p - q > ol->window)
+			break;
+
+		/* Like ka_analyze, ignore the overlapping substrings. */
+		if (p - q < ol->minlen)
+			continue;
+
+		if (memcmp(text + q, text + p, ol->minlen) != 0)
+			continue;
+
+		/* Only count the start of a repetition, the substrings of
+		 * a longer one are part of the same match. */
+		if (q != 0 && text[q - 1] == text[p - 1])
+			continue;
+
+		err = add_repeat(ol, p - q);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	ol->prev[p] = ol->head[h];
+	ol->head[h] = p;
+	return ERR_OK;
+}
+
+
+
+/* Add the character at position o of the charset to the columns. */
+static void count_char(struct online *ol, unsigned char o) {
+	size_t cslen = ol->charset->length;
+	size_t klen;
+
+	for (klen = 1; klen <= ol->maxlen; klen++) {
+		size_t c = klen * (klen - 1) / 2 + ol->col[klen];
+		size_t *n = &ol->count[c * cslen + o];
+
+		/* (n + 1) * n - n * (n - 1) */
+		ol->coinc[c] += 2.0 * *n;
+		(*n)++;
+
+		if (++ol->col[klen] == klen)
+			ol->col[klen] = 0;
+	}
+}
+
+
+
+int online_append(struct online *ol, const char *data, size_t len) {
+	const struct charset *cs = ol->charset;
+	size_t i;
+	int err;
+
+	for (i = 0; i < len; i++) {
+		short o = CS_TABLE_ORD(cs, data[i]);
+
+		if (o < 0)
+			continue;
+
+		/* Keep the first characters whatever the time. */
+		if (ol->text_size % CHECK_EVERY == 0 && ol->text_size != 0 &&
+		    deadline_passed(ol->deadline)) {
+			ol->expired = 1;
+			break;
+		}
+
+		err = reserve(ol);
+		if (err != ERR_OK)
+			return err;
+
+		ol->text[ol->text_size] = o;
+		ol->repeats[ol->text_size] = 0;
+		ol->scored[ol->text_size] = 0;
+		ol->text_size++;
+
+		count_char(ol, o);
+		if (ol->text_size < ol->minlen)
+			continue;
+
+		err = index_substring(ol);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	return ERR_OK;
+}
+
+
+
+size_t online_size(const struct online *ol) {
+	return ol->text_size;
+}
+
+
+
+float online_ioc(const struct online *ol, size_t klen) {
+	double sum = 0;
+	size_t c;
+
+	for (c = 0; c < klen; c++) {
+		/* Number of characters in the column c. */
+		size_t total = (ol->text_size + klen - 1 - c) / klen;
+
+		if (total >= 2)
+			sum += ol->coinc[klen * (klen - 1) / 2 + c] /
+			       ((double)total * (total - 1));
+	}
+
+	return sum / klen * ol->charset->length;
+}
+
+
+
+static size_t length_kasiski(struct online *ol) {
+	size_t end = ol->maxlen;
+	size_t best = 2;
+	size_t i;
+
+	if (end > ol->text_size - 1)
+		end = ol->text_size - 1;
+
+	if (end < best)
+		return end;
+
+	update_scores(ol);
+
+	for (i = 3; i <= end; i++) {
+		if (ol->ka_score[i] > ol->ka_score[best])
+			best = i;
+	}
+
+	return best;
+}
+
+
+
+static size_t length_ioc(struct online *ol) {
+	size_t maxlen = ol->maxlen;
+	size_t i;
+
+	/* Same limit as ioc_init. */
+	if (maxlen > ol->text_size / 2)
+		maxlen = ol->text_size / 2;
+
+	for (i = 1; i <= maxlen; i++)
+		ol->ioc_score[i] = online_ioc(ol, i);
+
+	return ioc_best_score(ol->ioc_score, maxlen);
+}
+
+
+
+size_t online_length(struct online *ol) {
+	if (ol->text_size < 3)
+		return 0;
+
+	if (ol->estimator == CK_EST_IOC)
+		return length_ioc(ol);
+
+	return length_kasiski(ol);
+}
+
+
+
+int online_key(struct online *ol, size_t klen) {
+	const struct charset *cs = ol->charset;
+	size_t c, s, i;
+
+	if (klen == 0 || klen > ol->maxlen)
+		return ERR_INVAL;
+
+	if (ol->text_size < klen)
+		return ERR_TOOSHORT;
+
+	/* The reference frequencies are the English ones. */
+	if (cs->length != CS_ALPHA_LEN)
+		return ERR_CHARSET;
+
+	for (c = 0; c < klen; c++) {
+		const size_t *count = ol->count +
+		                      (klen * (klen - 1) / 2 + c) * cs->length;
+		size_t total = (ol->text_size + klen - 1 - c) / klen;
+		float bd = FLT_MAX;
+		size_t bs = 0;
+
+		/* Same distance as the multi frequency analysis. */
+		for (s = 0; s < cs->length; s++) {
+			float d = 0;
+
+			for (i = 0; i < cs->length; i++) {
+				float diff = (float)count[i] / total -
+				             freq_en[(i + s) % cs->length];
+				d += diff * diff;
+			}
+
+			if (d < bd) {
+				bd = d;
+				bs = s;
+			}
+		}
+
+		/* Substract because we're undoing a Vigenère. */
+		ol->key[c] = cs_chr(cs, (cs->length - bs) % cs->length);
+	}
+
+	ol->key[klen] = '\0';
+	ol->klen = klen;
+	return ERR_OK;
+}
+
+
+
+int online_crack(struct online *ol) {
+	size_t klen = online_length(ol);
+
+	if (klen == 0)
+		return ERR_TOOSHORT;
+
+	return online_key(ol, klen);
+}
+
+
+
+/* Return the number of bytes of data holding its first nchars significant
+ * characters. */
+static size_t span_chars(const struct charset *cs, const char *data,
+                         size_t nchars) {
+	size_t i;
+
+	for (i = 0; nchars > 0; i++) {
+		if (CS_TABLE_ORD(cs, data[i]) >= 0)
+			nchars--;
+	}
+
+	return i;
+}
+
+
+
+int online_sample(struct online *ol, const char *data, size_t len,
+                  size_t klen, size_t rounds, size_t *used) {
+	size_t next = ONLINE_SAMPLE_START;
+	size_t stable = 0;
+	size_t prevlen = 0;
+	size_t pos = 0;
+	char *prev;
+	int err = ERR_OK;
+
+	if (rounds == 0)
+		return ERR_INVAL;
+
+	prev = malloc(ol->maxlen + 1);
+	if (prev == NULL)
+		return ERR_NOMEM;
+
+	while (pos < len) {
+		/* Every byte adds at most one character, this never gets past
+		 * the check. */
+		size_t n = next - online_size(ol);
+		size_t before = online_size(ol);
+
+		if (n > len - pos)
+			n = len - pos;
+
+		err = online_append(ol, data + pos, n);
+		if (err != ERR_OK)
+			break;
+
+		/* Only part of the data was appended. */
+		if (ol->expired) {
+			pos += span_chars(ol->charset, data + pos,
+			                  online_size(ol) - before);
+			break;
+		}
+		pos += n;
+
+		if (online_size(ol) < next)
+			continue;
+		next *= 2;
+
+		err = klen != 0 ? online_key(ol, klen) : online_crack(ol);
+		if (err == ERR_TOOSHORT)
+			continue;
+		if (err != ERR_OK)
+			break;
+
+		if (ol->klen == prevlen && memcmp(prev, ol->key, ol->klen) == 0)
+			stable++;
+		else
+			stable = 1;
+
+		if (stable == rounds)
+			break;
+
+		prevlen = ol->klen;
+		memcpy(prev, ol->key, ol->klen);
+	}
+
+	free(prev);
+	*used = pos;
+
+	if (stable == rounds || (err != ERR_OK && err != ERR_TOOSHORT))
+		return err;
+
+	/* The whole data has been analyzed. */
+	return klen != 0 ? online_key(ol, klen) : online_crack(ol);
+}
@@ -0,0 +1,160 @@
+#ifndef ONLINE_H__
+#define ONLINE_H__
+
+/*
+ * This module crack a text that arrives piece by piece.
+ * Instead of running the Kasiski, index of coincidence and frequency analyses
+ * again on the whole text every time some data is received, it keeps their
+ * intermediate results up to date:
+ * - An index of the substrings of length minlen, whose repetitions give the
+ *   Kasiski scores.
+ * - The character counts of every column for every key length up to maxlen,
+ *   which give the indexes of coincidence and the frequency analysis.
+ *
+ * Appending a character costs O(maxlen) plus the number of repetitions of the
+ * substring it ends in the last window characters. Asking for the key length
+ * or the key costs O(maxlen^2), plus O(maxlen) for every distance between
+ * repetitions found since the previous time.
+ *
+ * With an unlimited window, the Kasiski scores are the ones ka_analyze would
+ * compute for the same text, except that the characters are compared through
+ * the charset, so that equivalent characters match, and that a repetition
+ * still running at the end of the text is already counted.
+ *
+ * The memory grows with the text and is taken from malloc.
+ */
+
+
+#include <sys/types.h>
+
+#include "array.h"
+#include "charset.h"
+#include "cracker.h"
+
+
+/* Default distance up to which the repetitions are looked for. */
+#define ONLINE_DEFAULT_WINDOW (16 * 1024)
+
+/* Number of significant characters of the first check of online_sample, and
+ * the default number of checks the key must stay the same for. */
+#define ONLINE_SAMPLE_START 1024
+#define ONLINE_DEFAULT_ROUNDS 3
+
+
+struct online {
+	const struct charset *charset;
+	size_t maxlen;
+	size_t minlen;
+
+	/* Longest distance between two repeated substrings taken into account
+	 * by the Kasiski scores, 0 for no limit. Default to
+	 * ONLINE_DEFAULT_WINDOW. Long texts would otherwise make every
+	 * character cost as much as the number of times it has been seen. */
+	size_t window;
+
+	/* Method used by online_length. Default to CK_EST_KASISKI. */
+	enum ck_estimator estimator;
+
+	/* When to stop appending, see deadline.h. 0 by default. */
+	double deadline;
+	int expired;
+
+	/* The significant characters received so far, as their position in the
+	 * charset. */
+	ARRAY_DECL(unsigned char, text);
+
+	/* Hash chains of the substrings of length minlen. head[h] is the last
+	 * position of a substring whose hash is h, and prev[i] the position
+	 * before i with the same hash. */
+	size_t *head;
+	ARRAY_DECL(size_t, prev);
+
+	/* Number of repeated substrings at every distance, and that number
+	 * when ka_score was last updated. */
+	ARRAY_DECL(size_t, repeats);
+	ARRAY_DECL(size_t, scored);
+
+	/* Distances whose number of repetitions changed since then. */
+	ARRAY_DECL(size_t, dirty);
+
+	/* ka_score[klen] is the Kasiski score of klen, for klen up to maxlen.
+	 * Only up to date after online_length. */
+	size_t *ka_score;
+
+	/* Character counts of the columns of all the key lengths. The klen
+	 * columns of the length klen start at the column klen * (klen - 1) / 2,
+	 * each one has charset->length counts. */
+	size_t *count;
+
+	/* Sum of count * (count - 1) of every column, and the column the next
+	 * character goes to for every key length. */
+	double *coinc;
+	size_t *col;
+
+	/* Scratch table of online_length. */
+	float *ioc_score;
+
+	/* Result of the last online_key. */
+	size_t klen;
+	char *key;
+};
+
+
+
+/*
+ * Initialize a struct online tracking the key lengths up to maxlen and the
+ * repeated substrings of at least minlen characters.
+ * Return ERR_INVAL if maxlen or minlen is 0.
+ */
+int online_init(struct online *ol, const struct charset *charset,
+                size_t maxlen, size_t minlen);
+
+/* Deinitialize a struct online. */
+void online_fini(struct online *ol);
+
+/* Add the len bytes of data to the text. The characters out of the charset are
+ * skipped. On error, only part of the data may have been added, as well as
+ * when the deadline passed, which sets expired. */
+int online_append(struct online *ol, const char *data, size_t len);
+
+/* Return the number of significant characters received so far. */
+size_t online_size(const struct online *ol);
+
+/* Return the mean index of coincidence of the klen columns, normalized like
+ * struct ioc's score. klen must not be more than maxlen. */
+float online_ioc(const struct online *ol, size_t klen);
+
+/*
+ * Return the most probable key length with the selected estimator, or 0 if the
+ * text has less than 3 significant characters.
+ */
+size_t online_length(struct online *ol);
+
+/*
+ * Compute the key of the given length with a frequency analysis. It is stored
+ * in ol->key.
+ * Return ERR_INVAL if klen is 0 or more than maxlen, ERR_TOOSHORT if there are
+ * less characters than klen, and ERR_CHARSET if the charset isn't 26
+ * characters long.
+ */
+int online_key(struct online *ol, size_t klen);
+
+/* Estimate the key length and compute the key. Return ERR_TOOSHORT if there
+ * isn't enough text yet. */
+int online_crack(struct online *ol);
+
+/*
+ * Crack a long text under a single key by only analyzing as much of it as
+ * needed. A growing prefix of the len bytes of data is appended, and the key
+ * is checked every time the number of significant characters doubled, from
+ * ONLINE_SAMPLE_START on. It stops once the key length and the key have been
+ * the same for rounds consecutive checks, or at the end of the data.
+ * The key length is estimated unless klen isn't 0. *used is set to the number
+ * of bytes of data analyzed. If the deadline passes, the key is the one of the
+ * data appended so far.
+ * Return ERR_INVAL if rounds is 0, and the errors of online_key.
+ */
+int online_sample(struct online *ol, const char *data, size_t len,
+                  size_t klen, size_t rounds, size_t *used);
+
+#endif
@@ -0,0 +1,178 @@
+/* syscall() and perf_event_open are Linux specific. */
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#ifdef SYS_perf_event_open
+# include <linux/perf_event.h>
+#endif
+
+#include "error.h"
+#include "perf.h"
+
+
+
+static const char *const counter_names[PERF_LAST] = {
+	"cycles",
+	"instructions",
+	"cache_misses",
+	"branch_misses"
+};
+
+
+
+const char *perf_counter_name(enum perf_counter c) {
+	if (c >= PERF_LAST)
+		return NULL;
+
+	return counter_names[c];
+}
+
+
+
+int perf_has(const struct perf_group *pg, enum perf_counter c) {
+	return c < PERF_LAST && pg->fd[c] != -1;
+}
+
+
+
+#ifdef SYS_perf_event_open
+
+static const unsigned long counter_config[PERF_LAST] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES
+};
+
+
+
+static int open_counter(enum perf_counter c, int group) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = counter_config[c];
+	attr.disabled = group == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+	                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+
+
+int perf_open(struct perf_group *pg) {
+	size_t i;
+
+	memset(pg, 0, sizeof(*pg));
+	for (i = 0; i < PERF_LAST; i++)
+		pg->fd[i] = -1;
+
+	pg->fd[PERF_CYCLES] = open_counter(PERF_CYCLES, -1);
+	if (pg->fd[PERF_CYCLES] == -1)
+		return ERR_IO;
+
+	pg->idx[PERF_CYCLES] = pg->nopen++;
+
+	for (i = PERF_CYCLES + 1; i < PERF_LAST; i++) {
+		pg->fd[i] = open_counter(i, pg->fd[PERF_CYCLES]);
+		if (pg->fd[i] != -1)
+			pg->idx[i] = pg->nopen++;
+	}
+
+	return ERR_OK;
+}
+
+
+
+void perf_close(struct perf_group *pg) {
+	size_t i;
+
+	/* Close the leader last. */
+	for (i = PERF_LAST; i-- > 0;) {
+		if (pg->fd[i] != -1)
+			close(pg->fd[i]);
+		pg->fd[i] = -1;
+	}
+}
+
+
+
+void perf_start(struct perf_group *pg) {
+	int leader = pg->fd[PERF_CYCLES];
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+
+
+int perf_stop(struct perf_group *pg, double values[PERF_LAST]) {
+	/* nr, time_enabled, time_running and one value per counter. */
+	__u64 buf[3 + PERF_LAST];
+	int leader = pg->fd[PERF_CYCLES];
+	double scale = 1;
+	size_t i;
+	ssize_t ret;
+
+	ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	memset(values, 0, PERF_LAST * sizeof(*values));
+
+	ret = read(leader, buf, sizeof(buf));
+	if (ret < (ssize_t)(3 * sizeof(*buf)) || buf[0] != pg->nopen)
+		return ERR_IO;
+
+	/* The group has been multiplexed with other events. */
+	if (buf[2] != 0 && buf[2] < buf[1])
+		scale = (double)buf[1] / buf[2];
+
+	for (i = 0; i < PERF_LAST; i++) {
+		if (pg->fd[i] != -1)
+			values[i] = buf[3 + pg->idx[i]] * scale;
+	}
+
+	return ERR_OK;
+}
+
+#else
+
+int perf_open(struct perf_group *pg) {
+	size_t i;
+
+	memset(pg, 0, sizeof(*pg));
+	for (i = 0; i < PERF_LAST; i++)
+		pg->fd[i] = -1;
+
+	return ERR_IO;
+}
+
+
+
+void perf_close(struct perf_group *pg) {
+	(void)pg;
+}
+
+
+
+void perf_start(struct perf_group *pg) {
+	(void)pg;
+}
+
+
+
+int perf_stop(struct perf_group *pg, double values[PERF_LAST]) {
+	(void)pg;
+	memset(values, 0, PERF_LAST * sizeof(*values));
+	return ERR_IO;
+}
+
+#endif
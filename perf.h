@@ -0,0 +1,64 @@
+#ifndef PERF_H__
+#define PERF_H__
+
+/*
+ * This module read the hardware performance counters of the calling thread
+ * with perf_event_open. All the counters are in a single group so that they
+ * are scheduled together and can be compared with each other.
+ *
+ * The counters may be missing: not on Linux, in a virtual machine without a
+ * PMU, or forbidden by /proc/sys/kernel/perf_event_paranoid. perf_open then
+ * fails and the caller should just go on without them. Some counters of the
+ * group may also be missing on their own, this is told by perf_has.
+ */
+
+#include <sys/types.h>
+
+
+enum perf_counter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_LAST
+};
+
+
+struct perf_group {
+	/* File descriptors of the counters. -1 if a counter isn't available.
+	 * fd[PERF_CYCLES] is the group leader. */
+	int fd[PERF_LAST];
+
+	/* Position of the counters in the values read from the group. */
+	size_t idx[PERF_LAST];
+	size_t nopen;
+};
+
+
+
+/*
+ * Open the counters of the calling thread. They're not counting yet.
+ * Return ERR_IO if the counters can't be used at all.
+ */
+int perf_open(struct perf_group *pg);
+
+/* Close the counters. */
+void perf_close(struct perf_group *pg);
+
+/* Return the name of a counter. */
+const char *perf_counter_name(enum perf_counter c);
+
+/* Return whether a counter is available. */
+int perf_has(const struct perf_group *pg, enum perf_counter c);
+
+/* Reset the counters and start counting. */
+void perf_start(struct perf_group *pg);
+
+/*
+ * Stop counting and store the counts into values, scaled if the counters
+ * couldn't be on the PMU the whole time. Unavailable counters are set to 0.
+ * Return ERR_IO if the counters can't be read.
+ */
+int perf_stop(struct perf_group *pg, double values[PERF_LAST]);
+
+#endif
@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "error.h"
+#include "io.h"
+#include "trace.h"
+#include "pipeline.h"
+
+
+
+struct slot {
+	char *data;
+	size_t len;
+};
+
+/*
+ * The buffers are used in a round-robin fashion. Slot n % nbufs holds the
+ * n-th piece of the input. The three counters only ever increase and tell
+ * how many pieces went through each stage.
+ */
+struct pipeline {
+	const struct pl_config *cfg;
+	int infd;
+	int outfd;
+	struct slot *slots;
+
+	pthread_mutex_t lock;
+	pthread_cond_t can_read;
+	pthread_cond_t can_transform;
+	pthread_cond_t can_write;
+
+	size_t nread;
+	size_t ntransformed;
+	size_t nwritten;
+	int eof;
+	int transform_done;
+
+	int err;
+	int err_errno;
+};
+
+
+
+/* Record the first error and wake everybody up. Called with the lock held. */
+static void set_error(struct pipeline *p, int err) {
+	if (p->err == ERR_OK) {
+		p->err = err;
+		p->err_errno = errno;
+	}
+
+	pthread_cond_broadcast(&p->can_read);
+	pthread_cond_broadcast(&p->can_transform);
+	pthread_cond_broadcast(&p->can_write);
+}
+
+
+
+static void *reader(void *arg) {
+	struct pipeline *p = arg;
+	size_t nbufs = p->cfg->nbufs;
+	struct trace_buf *tb = trace_thread(p->cfg->trace, "pipeline reader");
+
+	for (;;) {
+		struct slot *s;
+		ssize_t nr;
+		double t;
+
+		pthread_mutex_lock(&p->lock);
+		while (p->err == ERR_OK && p->nread - p->nwritten == nbufs)
+			pthread_cond_wait(&p->can_read, &p->lock);
+
+		if (p->err != ERR_OK) {
+			pthread_mutex_unlock(&p->lock);
+			return NULL;
+		}
+
+		s = &p->slots[p->nread % nbufs];
+		pthread_mutex_unlock(&p->lock);
+
+		t = trace_begin(tb);
+		do {
+			nr = read(p->infd, s->data, p->cfg->bufsize);
+		} while (nr < 0 && errno == EINTR);
+		trace_end(tb, t, "read", NULL, nr);
+
+		pthread_mutex_lock(&p->lock);
+		if (nr < 0) {
+			set_error(p, ERR_IO);
+		} else if (nr == 0) {
+			p->eof = 1;
+			pthread_cond_signal(&p->can_transform);
+		} else {
+			s->len = nr;
+			p->nread++;
+			pthread_cond_signal(&p->can_transform);
+		}
+		pthread_mutex_unlock(&p->lock);
+
+		if (nr <= 0)
+			return NULL;
+	}
+}
+
+
+
+static void *writer(void *arg) {
+	struct pipeline *p = arg;
+	size_t nbufs = p->cfg->nbufs;
+	struct trace_buf *tb = trace_thread(p->cfg->trace, "pipeline writer");
+
+	for (;;) {
+		struct slot *s;
+		int err;
+		double t;
+
+		pthread_mutex_lock(&p->lock);
+		while (p->err == ERR_OK && p->nwritten == p->ntransformed &&
+		       !p->transform_done)
+			pthread_cond_wait(&p->can_write, &p->lock);
+
+		if (p->err != ERR_OK || p->nwritten == p->ntransformed) {
+			pthread_mutex_unlock(&p->lock);
+			return NULL;
+		}
+
+		s = &p->slots[p->nwritten % nbufs];
+		pthread_mutex_unlock(&p->lock);
+
+		t = trace_begin(tb);
+		err = io_write_fd(p->outfd, s->data, s->len);
+		trace_end(tb, t, "write", NULL, s->len);
+
+		pthread_mutex_lock(&p->lock);
+		if (err != ERR_OK) {
+			set_error(p, err);
+		} else {
+			p->nwritten++;
+			pthread_cond_signal(&p->can_read);
+		}
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+
+
+static void transformer(struct pipeline *p) {
+	size_t nbufs = p->cfg->nbufs;
+	struct trace_buf *tb = trace_thread(p->cfg->trace,
+	                                    "pipeline transform");
+
+	for (;;) {
+		struct slot *s;
+		double t;
+
+		pthread_mutex_lock(&p->lock);
+		while (p->err == ERR_OK && p->ntransformed == p->nread &&
+		       !p->eof)
+			pthread_cond_wait(&p->can_transform, &p->lock);
+
+		if (p->err != ERR_OK || p->ntransformed == p->nread) {
+			p->transform_done = 1;
+			pthread_cond_signal(&p->can_write);
+			pthread_mutex_unlock(&p->lock);
+			return;
+		}
+
+		s = &p->slots[p->ntransformed % nbufs];
+		pthread_mutex_unlock(&p->lock);
+
+		t = trace_begin(tb);
+		p->cfg->transform(p->cfg->arg, s->data, s->len);
+		trace_end(tb, t, "transform", NULL, s->len);
+
+		pthread_mutex_lock(&p->lock);
+		p->ntransformed++;
+		pthread_cond_signal(&p->can_write);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+
+
+void pl_config_init(struct pl_config *cfg, pl_transform_fn *transform,
+                    void *arg) {
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->nbufs = PL_DEFAULT_BUFFERS;
+	cfg->bufsize = PL_DEFAULT_BUFSIZE;
+	cfg->transform = transform;
+	cfg->arg = arg;
+}
+
+
+
+int pl_run(const struct pl_config *cfg, int infd, int outfd) {
+	struct pipeline p;
+	pthread_t rd, wr;
+	char *mem;
+	size_t i;
+	int err;
+
+	if (cfg->nbufs == 0 || cfg->bufsize == 0 ||
+	    cfg->nbufs > (size_t)-1 / cfg->bufsize)
+		return ERR_INVAL;
+
+	memset(&p, 0, sizeof(p));
+	p.cfg = cfg;
+	p.infd = infd;
+	p.outfd = outfd;
+
+	p.slots = malloc(cfg->nbufs * sizeof(*p.slots));
+	mem = malloc(cfg->nbufs * cfg->bufsize);
+	if (p.slots == NULL || mem == NULL) {
+		free(p.slots);
+		free(mem);
+		return ERR_NOMEM;
+	}
+
+	for (i = 0; i < cfg->nbufs; i++)
+		p.slots[i].data = mem + i * cfg->bufsize;
+
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.can_read, NULL);
+	pthread_cond_init(&p.can_transform, NULL);
+	pthread_cond_init(&p.can_write, NULL);
+
+	err = ERR_OK;
+	if (pthread_create(&rd, NULL, reader, &p) != 0) {
+		err = ERR_THREAD;
+		goto err_reader;
+	}
+
+	if (pthread_create(&wr, NULL, writer, &p) != 0) {
+		pthread_mutex_lock(&p.lock);
+		set_error(&p, ERR_THREAD);
+		pthread_mutex_unlock(&p.lock);
+		pthread_join(rd, NULL);
+		err = ERR_THREAD;
+		goto err_reader;
+	}
+
+	transformer(&p);
+
+	pthread_join(rd, NULL);
+	pthread_join(wr, NULL);
+
+	err = p.err;
+	errno = p.err_errno;
+
+err_reader:
+	pthread_cond_destroy(&p.can_write);
+	pthread_cond_destroy(&p.can_transform);
+	pthread_cond_destroy(&p.can_read);
+	pthread_mutex_destroy(&p.lock);
+	free(mem);
+	free(p.slots);
+
+	return err;
+}
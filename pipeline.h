@@ -0,0 +1,47 @@
+#ifndef PIPELINE_H__
+#define PIPELINE_H__
+
+/*
+ * This module stream data from a file descriptor to another one while
+ * transforming it, so that the reads, the transformation and the writes
+ * overlap.
+ * A reader thread fills a ring of buffers, the calling thread transforms them
+ * in order and a writer thread writes them out. Each buffer goes back to the
+ * reader once written.
+ */
+
+#include <sys/types.h>
+
+#include "trace.h"
+
+
+#define PL_DEFAULT_BUFFERS 4
+#define PL_DEFAULT_BUFSIZE (256 * 1024)
+
+
+/* Function applied in place to every buffer, in the order of the input. */
+typedef void pl_transform_fn(void *arg, char *buf, size_t len);
+
+struct pl_config {
+	size_t nbufs;
+	size_t bufsize;
+	pl_transform_fn *transform;
+	void *arg;
+
+	/* Trace every chunk read, transformed and written. May be NULL. */
+	struct trace *trace;
+};
+
+
+
+/* Fill cfg with the default values for the given transformation. */
+void pl_config_init(struct pl_config *cfg, pl_transform_fn *transform,
+                    void *arg);
+
+/*
+ * Stream everything from infd to outfd through the transformation.
+ * Return ERR_IO with errno set if a read or a write failed.
+ */
+int pl_run(const struct pl_config *cfg, int infd, int outfd);
+
+#endif
@@ -0,0 +1,230 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "error.h"
+#include "io.h"
+#include "proto.h"
+
+
+
+/* Length of the integers, and of the fixed part of a message after its
+ * length. */
+#define INT_SIZE 4
+#define FIXED_SIZE (4 * INT_SIZE)
+
+
+
+void proto_init(struct proto_msg *m) {
+	memset(m, 0, sizeof(*m));
+}
+
+
+
+void proto_fini(struct proto_msg *m) {
+	free(m->buf);
+	memset(m, 0, sizeof(*m));
+}
+
+
+
+static void put_int(unsigned char *p, unsigned long v) {
+	p[0] = (v >> 24) & 0xff;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+
+
+static unsigned long get_int(const unsigned char *p) {
+	return (unsigned long)p[0] << 24 | (unsigned long)p[1] << 16 |
+	       (unsigned long)p[2] << 8 | p[3];
+}
+
+
+
+/* Read exactly len bytes. Set *got to the number read before the end of the
+ * connection. */
+static int read_full(int fd, char *data, size_t len, size_t *got) {
+	ssize_t nr;
+
+	*got = 0;
+	while (*got < len) {
+		nr = io_read_some(fd, data + *got, len - *got);
+		if (nr < 0)
+			return ERR_IO;
+		if (nr == 0)
+			return ERR_FORMAT;
+
+		*got += nr;
+	}
+
+	return ERR_OK;
+}
+
+
+
+/* Send len bytes. A peer gone away is an error rather than a SIGPIPE. */
+static int send_full(int fd, const char *data, size_t len) {
+	ssize_t nw;
+
+	while (len > 0) {
+		nw = send(fd, data, len, MSG_NOSIGNAL);
+		if (nw < 0 && errno == EINTR)
+			continue;
+		if (nw < 0)
+			return ERR_IO;
+
+		data += nw;
+		len -= nw;
+	}
+
+	return ERR_OK;
+}
+
+
+
+/* Take the field of len bytes at *pos out of the size bytes of body. */
+static int take(const char *body, size_t size, size_t *pos, size_t len,
+                const char **field) {
+	if (size - *pos < len)
+		return ERR_FORMAT;
+
+	*field = body + *pos;
+	*pos += len;
+	return ERR_OK;
+}
+
+
+
+int proto_read(int fd, struct proto_msg *m) {
+	unsigned char lenbuf[INT_SIZE];
+	const unsigned char *p;
+	const char *field;
+	size_t size, pos, got;
+	char *buf;
+	int err;
+
+	m->closed = 0;
+
+	err = read_full(fd, (char *)lenbuf, INT_SIZE, &got);
+	if (err == ERR_FORMAT && got == 0)
+		m->closed = 1;
+	if (err != ERR_OK)
+		return m->closed ? ERR_OK : err;
+
+	size = get_int(lenbuf);
+	if (size > PROTO_MAX_SIZE || size < FIXED_SIZE)
+		return ERR_FORMAT;
+
+	if (m->buf_mem < size) {
+		buf = realloc(m->buf, size);
+		if (buf == NULL)
+			return ERR_NOMEM;
+
+		m->buf = buf;
+		m->buf_mem = size;
+	}
+
+	err = read_full(fd, m->buf, size, &got);
+	if (err != ERR_OK)
+		return err;
+
+	p = (const unsigned char *)m->buf;
+	m->op = get_int(p);
+	m->param = get_int(p + INT_SIZE);
+
+	pos = 2 * INT_SIZE;
+	m->key_len = get_int(p + pos);
+	pos += INT_SIZE;
+	err = take(m->buf, size, &pos, m->key_len, &m->key);
+	if (err != ERR_OK)
+		return err;
+
+	err = take(m->buf, size, &pos, INT_SIZE, &field);
+	if (err != ERR_OK)
+		return err;
+
+	m->stats_len = get_int((const unsigned char *)field);
+	err = take(m->buf, size, &pos, m->stats_len, &m->stats);
+	if (err != ERR_OK)
+		return err;
+
+	m->text = m->buf + pos;
+	m->text_len = size - pos;
+	return ERR_OK;
+}
+
+
+
+int proto_write(int fd, const struct proto_msg *m) {
+	unsigned char *head;
+	size_t size, hlen;
+	int err;
+
+	if (m->key_len > PROTO_MAX_SIZE || m->stats_len > PROTO_MAX_SIZE ||
+	    m->text_len > PROTO_MAX_SIZE)
+		return ERR_INVAL;
+
+	size = FIXED_SIZE + m->key_len + m->stats_len + m->text_len;
+	if (size > PROTO_MAX_SIZE)
+		return ERR_INVAL;
+
+	/* Everything but the text, which may be large, in one write. */
+	hlen = INT_SIZE + size - m->text_len;
+	head = malloc(hlen);
+	if (head == NULL)
+		return ERR_NOMEM;
+
+	put_int(head, size);
+	put_int(head + INT_SIZE, m->op);
+	put_int(head + 2 * INT_SIZE, m->param);
+	put_int(head + 3 * INT_SIZE, m->key_len);
+	if (m->key_len > 0)
+		memcpy(head + 4 * INT_SIZE, m->key, m->key_len);
+	put_int(head + 4 * INT_SIZE + m->key_len, m->stats_len);
+	if (m->stats_len > 0)
+		memcpy(head + FIXED_SIZE + INT_SIZE + m->key_len, m->stats,
+		       m->stats_len);
+
+	err = send_full(fd, (const char *)head, hlen);
+	if (err == ERR_OK)
+		err = send_full(fd, m->text, m->text_len);
+
+	free(head);
+	return err;
+}
+
+
+
+int proto_connect(const char *path, int *fd) {
+	struct sockaddr_un addr;
+	int err;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return ERR_INVAL;
+
+	strcpy(addr.sun_path, path);
+
+	*fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (*fd == -1)
+		return ERR_IO;
+
+	if (connect(*fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		err = errno;
+		close(*fd);
+		errno = err;
+		return ERR_IO;
+	}
+
+	return ERR_OK;
+}
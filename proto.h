@@ -0,0 +1,85 @@
+#ifndef PROTO_H__
+#define PROTO_H__
+
+/*
+ * This module implement the protocol of the server mode, see server.h.
+ *
+ * A connection carries a sequence of requests, each one answered by a response
+ * before the next one is read. Both are messages with the same layout, where
+ * every integer is 4 bytes long, most significant byte first:
+ * - The length of the rest of the message.
+ * - The operation of a request, one of enum proto_op, or the error code of a
+ *   response, see error.h.
+ * - A parameter. In a crack request, the key length, 0 to estimate it. In the
+ *   response, 1 if the time budget ran out before the analysis was complete.
+ * - The length of the key, then the key. The one to encrypt or decrypt with,
+ *   or the one found by a crack.
+ * - The length of the statistics, then the statistics. Only in the responses,
+ *   the cost of every stage of the request as a JSON object, see stats.h. The
+ *   CPU time is the one of the whole server.
+ * - The text, up to the end of the message. The one to process, or the result.
+ */
+
+#include <sys/types.h>
+
+
+/* Longest message accepted. */
+#define PROTO_MAX_SIZE (256UL * 1024 * 1024)
+
+
+enum proto_op {
+	PROTO_ENCRYPT,
+	PROTO_DECRYPT,
+	PROTO_CRACK,
+	PROTO_LAST
+};
+
+
+struct proto_msg {
+	unsigned long op;
+	size_t param;
+
+	const char *key;
+	size_t key_len;
+
+	const char *stats;
+	size_t stats_len;
+
+	char *text;
+	size_t text_len;
+
+	/* Set by proto_read when the connection was closed before a message
+	 * started. */
+	int closed;
+
+	/* Memory of the last message read, which the fields point to. */
+	char *buf;
+	size_t buf_mem;
+};
+
+
+
+/* Initialize an empty message. */
+void proto_init(struct proto_msg *m);
+
+/* Free the memory of the messages read. */
+void proto_fini(struct proto_msg *m);
+
+/*
+ * Read a message from fd. The memory is reused from a message to the next.
+ * Return ERR_IO with errno set when a system call fails, and ERR_FORMAT when
+ * the message is longer than PROTO_MAX_SIZE or ends in the middle.
+ */
+int proto_read(int fd, struct proto_msg *m);
+
+/* Connect to the server listening on the Unix socket path. Return ERR_INVAL
+ * if the path is too long for a socket, and ERR_IO with errno set when a
+ * system call fails. */
+int proto_connect(const char *path, int *fd);
+
+/* Write a message to the socket fd. Return ERR_IO with errno set when a system
+ * call fails, including when the peer closed the connection, and ERR_INVAL
+ * when the message is longer than PROTO_MAX_SIZE. */
+int proto_write(int fd, const struct proto_msg *m);
+
+#endif
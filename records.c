@@ -0,0 +1,425 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "error.h"
+#include "array.h"
+#include "io.h"
+#include "trace.h"
+#include "records.h"
+
+
+
+/* Size of the output buffer of a block when it's first used. */
+#define OUT_MIN_SIZE 4096
+
+
+struct block {
+	/* Whole records, only the last one of the input may lack its
+	 * delimiter. */
+	ARRAY_DECL(char, in);
+
+	struct rec_out out;
+
+	/* Set once processed, until written. */
+	int done;
+};
+
+/*
+ * Block n % depth holds the n-th block of the input. Like in the pipeline
+ * module, the counters only ever increase and tell how many blocks went
+ * through each stage, the blocks being taken by the workers in order but
+ * possibly finished out of order.
+ */
+struct records {
+	const struct rec_config *cfg;
+	int infd;
+	int outfd;
+	struct block *blocks;
+
+	/* Beginning of a record read after the last delimiter of a block. */
+	ARRAY_DECL(char, carry);
+
+	pthread_mutex_t lock;
+	pthread_cond_t can_read;
+	pthread_cond_t can_work;
+	pthread_cond_t can_write;
+
+	size_t nread;
+	size_t ntaken;
+	size_t nwritten;
+	int eof;
+
+	int err;
+	int err_errno;
+};
+
+struct worker {
+	struct records *r;
+	size_t idx;
+	pthread_t thread;
+};
+
+
+
+/* Record the first error and wake everybody up. Called with the lock held. */
+static void set_error(struct records *r, int err) {
+	if (r->err == ERR_OK) {
+		r->err = err;
+		r->err_errno = errno;
+	}
+
+	pthread_cond_broadcast(&r->can_read);
+	pthread_cond_broadcast(&r->can_work);
+	pthread_cond_broadcast(&r->can_write);
+}
+
+
+
+/* Make room for len more bytes at the end of the array name. */
+#define RESERVE(name, len, err)                                    \
+	do {                                                       \
+		(err) = ERR_OK;                                    \
+		if ((name ## _mem) == 0)                           \
+			(err) = ARRAY_ALLOC(name, OUT_MIN_SIZE);   \
+		while ((err) == ERR_OK &&                          \
+		       (name ## _mem) - (name ## _size) < (len))   \
+			(err) = ARRAY_GROW(name);                  \
+	} while (0)
+
+
+
+int rec_emit(struct rec_out *out, const char *data, size_t len) {
+	int err;
+
+	RESERVE(out->data, len, err);
+	if (err != ERR_OK)
+		return err;
+
+	memcpy(out->data + out->data_size, data, len);
+	out->data_size += len;
+	return ERR_OK;
+}
+
+
+
+/*
+ * Read into the block until it ends with a delimiter, starting with what was
+ * carried from the previous one. What follows the last delimiter read is
+ * carried to the next block. Set *eof at the end of the input, the block then
+ * holds whatever is left.
+ */
+static int fill(struct records *r, struct block *b, struct trace_buf *tb,
+                int *eof) {
+	size_t bufsize = r->cfg->bufsize;
+	size_t i, rest;
+	ssize_t nr;
+	double t;
+	int err;
+
+	b->in_size = 0;
+	RESERVE(b->in, r->carry_size, err);
+	if (err != ERR_OK)
+		return err;
+
+	if (r->carry_size > 0)
+		memcpy(b->in, r->carry, r->carry_size);
+	b->in_size = r->carry_size;
+	r->carry_size = 0;
+
+	for (;;) {
+		RESERVE(b->in, bufsize, err);
+		if (err != ERR_OK)
+			return err;
+
+		t = trace_begin(tb);
+		nr = io_read_some(r->infd, b->in + b->in_size, bufsize);
+		trace_end(tb, t, "read", NULL, nr);
+
+		if (nr < 0)
+			return ERR_IO;
+
+		if (nr == 0) {
+			*eof = 1;
+			return ERR_OK;
+		}
+
+		/* Only the new data may hold a delimiter. */
+		for (i = b->in_size + nr; i > b->in_size; i--)
+			if (b->in[i - 1] == r->cfg->delim)
+				break;
+
+		if (i == b->in_size) {
+			b->in_size += nr;
+			continue;
+		}
+
+		rest = b->in_size + nr - i;
+		RESERVE(r->carry, rest, err);
+		if (err != ERR_OK)
+			return err;
+
+		memcpy(r->carry, b->in + i, rest);
+		r->carry_size = rest;
+		b->in_size = i;
+		return ERR_OK;
+	}
+}
+
+
+
+static void reader(struct records *r) {
+	size_t depth = r->cfg->depth;
+	struct trace_buf *tb = trace_thread(r->cfg->trace, "records reader");
+	struct block *b;
+	int eof = 0;
+	int err;
+
+	while (!eof) {
+		pthread_mutex_lock(&r->lock);
+		while (r->err == ERR_OK && r->nread - r->nwritten == depth)
+			pthread_cond_wait(&r->can_read, &r->lock);
+
+		if (r->err != ERR_OK) {
+			pthread_mutex_unlock(&r->lock);
+			return;
+		}
+
+		b = &r->blocks[r->nread % depth];
+		pthread_mutex_unlock(&r->lock);
+
+		err = fill(r, b, tb, &eof);
+
+		pthread_mutex_lock(&r->lock);
+		if (err != ERR_OK) {
+			set_error(r, err);
+			eof = 1;
+		} else if (b->in_size > 0) {
+			r->nread++;
+			pthread_cond_signal(&r->can_work);
+		}
+
+		/* The workers and the writer waiting for more can stop. */
+		if (eof) {
+			r->eof = 1;
+			pthread_cond_broadcast(&r->can_work);
+			pthread_cond_signal(&r->can_write);
+		}
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+
+
+/* Run the work function on every record of a block. */
+static int process(struct records *r, size_t idx, struct block *b) {
+	const struct rec_config *cfg = r->cfg;
+	char *p = b->in;
+	char *end = b->in + b->in_size;
+	char *delim;
+	int err;
+
+	b->out.data_size = 0;
+
+	while (p < end) {
+		delim = memchr(p, cfg->delim, end - p);
+		if (delim == NULL)
+			delim = end;
+
+		err = cfg->work(cfg->arg, idx, p, delim - p, &b->out);
+		if (err == ERR_OK && delim != end)
+			err = rec_emit(&b->out, &cfg->delim, 1);
+		if (err != ERR_OK)
+			return err;
+
+		p = delim + 1;
+	}
+
+	return ERR_OK;
+}
+
+
+
+static void *worker_main(void *arg) {
+	struct worker *w = arg;
+	struct records *r = w->r;
+	size_t depth = r->cfg->depth;
+	struct trace_buf *tb = trace_thread(r->cfg->trace, "records worker");
+	struct block *b;
+	double t;
+	int err;
+
+	for (;;) {
+		pthread_mutex_lock(&r->lock);
+		while (r->err == ERR_OK && r->ntaken == r->nread && !r->eof)
+			pthread_cond_wait(&r->can_work, &r->lock);
+
+		if (r->err != ERR_OK || r->ntaken == r->nread) {
+			pthread_mutex_unlock(&r->lock);
+			return NULL;
+		}
+
+		b = &r->blocks[r->ntaken % depth];
+		r->ntaken++;
+		pthread_mutex_unlock(&r->lock);
+
+		t = trace_begin(tb);
+		err = process(r, w->idx, b);
+		trace_end(tb, t, "block", NULL, b->in_size);
+
+		pthread_mutex_lock(&r->lock);
+		if (err != ERR_OK) {
+			set_error(r, err);
+		} else {
+			b->done = 1;
+			pthread_cond_signal(&r->can_write);
+		}
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+
+
+/* Write the blocks in order as soon as they're processed. */
+static void *writer(void *arg) {
+	struct records *r = arg;
+	size_t depth = r->cfg->depth;
+	struct trace_buf *tb = trace_thread(r->cfg->trace, "records writer");
+	struct block *b;
+	double t;
+	int err;
+
+	for (;;) {
+		pthread_mutex_lock(&r->lock);
+		for (;;) {
+			b = &r->blocks[r->nwritten % depth];
+			if (r->err != ERR_OK || (r->nwritten < r->nread &&
+			                         b->done) ||
+			    (r->eof && r->nwritten == r->nread))
+				break;
+
+			pthread_cond_wait(&r->can_write, &r->lock);
+		}
+
+		if (r->err != ERR_OK || r->nwritten == r->nread) {
+			pthread_mutex_unlock(&r->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&r->lock);
+
+		t = trace_begin(tb);
+		err = io_write_fd(r->outfd, b->out.data, b->out.data_size);
+		trace_end(tb, t, "write", NULL, b->out.data_size);
+
+		pthread_mutex_lock(&r->lock);
+		if (err != ERR_OK) {
+			set_error(r, err);
+		} else {
+			b->done = 0;
+			r->nwritten++;
+			pthread_cond_signal(&r->can_read);
+		}
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+
+
+void rec_config_init(struct rec_config *cfg, char delim, rec_work_fn *work,
+                     void *arg, size_t nthreads) {
+	long ncpus;
+
+	if (nthreads == 0) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->delim = delim;
+	cfg->depth = REC_DEFAULT_DEPTH;
+	cfg->bufsize = REC_DEFAULT_BUFSIZE;
+	cfg->nthreads = nthreads;
+	cfg->work = work;
+	cfg->arg = arg;
+}
+
+
+
+int rec_run(const struct rec_config *cfg, int infd, int outfd) {
+	struct records r;
+	struct worker *workers;
+	pthread_t wr;
+	size_t nstarted = 0;
+	size_t i;
+	int err;
+
+	if (cfg->depth == 0 || cfg->bufsize == 0 || cfg->nthreads == 0)
+		return ERR_INVAL;
+
+	memset(&r, 0, sizeof(r));
+	r.cfg = cfg;
+	r.infd = infd;
+	r.outfd = outfd;
+
+	/* The buffers are only allocated when the blocks are first used. */
+	r.blocks = calloc(cfg->depth, sizeof(*r.blocks));
+	workers = malloc(cfg->nthreads * sizeof(*workers));
+	if (r.blocks == NULL || workers == NULL) {
+		free(r.blocks);
+		free(workers);
+		return ERR_NOMEM;
+	}
+
+	pthread_mutex_init(&r.lock, NULL);
+	pthread_cond_init(&r.can_read, NULL);
+	pthread_cond_init(&r.can_work, NULL);
+	pthread_cond_init(&r.can_write, NULL);
+
+	if (pthread_create(&wr, NULL, writer, &r) != 0) {
+		err = ERR_THREAD;
+		goto err_writer;
+	}
+
+	for (nstarted = 0; nstarted < cfg->nthreads; nstarted++) {
+		workers[nstarted].r = &r;
+		workers[nstarted].idx = nstarted;
+		if (pthread_create(&workers[nstarted].thread, NULL,
+		                   worker_main, &workers[nstarted]) != 0)
+			break;
+	}
+
+	if (nstarted > 0) {
+		reader(&r);
+	} else {
+		pthread_mutex_lock(&r.lock);
+		set_error(&r, ERR_THREAD);
+		pthread_mutex_unlock(&r.lock);
+	}
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(workers[i].thread, NULL);
+	pthread_join(wr, NULL);
+
+	err = r.err;
+	errno = r.err_errno;
+
+err_writer:
+	pthread_cond_destroy(&r.can_write);
+	pthread_cond_destroy(&r.can_work);
+	pthread_cond_destroy(&r.can_read);
+	pthread_mutex_destroy(&r.lock);
+
+	for (i = 0; i < cfg->depth; i++) {
+		ARRAY_FREE(r.blocks[i].in);
+		ARRAY_FREE(r.blocks[i].out.data);
+	}
+	ARRAY_FREE(r.carry);
+	free(r.blocks);
+	free(workers);
+
+	return err;
+}
@@ -0,0 +1,74 @@
+#ifndef RECORDS_H__
+#define RECORDS_H__
+
+/*
+ * This module process a stream made of many independent records, like the
+ * lines of a log, each one on its own.
+ *
+ * The calling thread reads the input into blocks of whole records, a record
+ * spanning over two reads being carried to the next block. A pool of worker
+ * threads processes the blocks as they come, each record going through the
+ * work function, and a writer thread writes them out. The blocks are numbered
+ * and held in a ring until all the blocks before them are written, so that
+ * the output is in the order of the input even though the workers finish in
+ * any order.
+ */
+
+#include <sys/types.h>
+
+#include "array.h"
+#include "trace.h"
+
+
+/* Number of blocks being read, processed or written, and size of a read. */
+#define REC_DEFAULT_DEPTH 64
+#define REC_DEFAULT_BUFSIZE (64 * 1024)
+
+
+/* Output of a block. */
+struct rec_out {
+	ARRAY_DECL(char, data);
+};
+
+/*
+ * Function processing a record of len bytes, without its delimiter. thread is
+ * the index of the worker thread calling it, to let it use per-thread data.
+ * The record may be modified in place. Whatever the function gives to
+ * rec_emit is its output, the delimiter is added after it. Return an error
+ * code, anything but ERR_OK stops everything.
+ */
+typedef int rec_work_fn(void *arg, size_t thread, char *rec, size_t len,
+                        struct rec_out *out);
+
+struct rec_config {
+	/* Character ending every record. The last one may miss it, its output
+	 * then does as well. */
+	char delim;
+
+	size_t depth;
+	size_t bufsize;
+	size_t nthreads;
+	rec_work_fn *work;
+	void *arg;
+
+	/* Trace the reads, the writes and every block. May be NULL. */
+	struct trace *trace;
+};
+
+
+
+/* Fill cfg with the default values. nthreads may be 0 for one per CPU. */
+void rec_config_init(struct rec_config *cfg, char delim, rec_work_fn *work,
+                     void *arg, size_t nthreads);
+
+/* Append len bytes of data to the output of a record. */
+int rec_emit(struct rec_out *out, const char *data, size_t len);
+
+/*
+ * Process every record from infd and write them to outfd.
+ * Return ERR_IO with errno set if a read or a write failed, and the first
+ * error of the work function.
+ */
+int rec_run(const struct rec_config *cfg, int infd, int outfd);
+
+#endif
@@ -0,0 +1,278 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "error.h"
+#include "proto.h"
+#include "server.h"
+
+
+
+#define LISTEN_BACKLOG 64
+
+
+struct server {
+	const struct server_config *cfg;
+	int fd;
+
+	/* Set when the server is stopping. Protected by lock, like the
+	 * connections of the workers. */
+	pthread_mutex_t lock;
+	int stop;
+};
+
+struct worker {
+	struct server *srv;
+	size_t idx;
+	pthread_t thread;
+
+	/* Connection being served, or -1. */
+	int conn;
+};
+
+
+
+/* Answer the requests of a connection until the client closes it. */
+static void serve(struct worker *w, int fd, struct proto_msg *req) {
+	const struct server_config *cfg = w->srv->cfg;
+	struct proto_msg resp;
+	int err;
+
+	for (;;) {
+		proto_init(&resp);
+
+		/* After a bad message, there's no telling where the next one
+		 * starts. Tell the client before leaving. */
+		err = proto_read(fd, req);
+		if (err == ERR_FORMAT) {
+			resp.op = err;
+			proto_write(fd, &resp);
+		}
+		if (err != ERR_OK || req->closed)
+			return;
+
+		if (req->op >= PROTO_LAST)
+			err = ERR_INVAL;
+		else
+			err = cfg->handler(cfg->arg, w->idx, req, &resp);
+
+		/* Only the statistics are worth sending with an error. */
+		if (err != ERR_OK) {
+			resp.param = 0;
+			resp.key_len = 0;
+			resp.text_len = 0;
+		}
+
+		resp.op = err;
+		if (proto_write(fd, &resp) != ERR_OK)
+			return;
+	}
+}
+
+
+
+static void *worker_main(void *arg) {
+	struct worker *w = arg;
+	struct server *srv = w->srv;
+	struct proto_msg req;
+	int fd;
+
+	proto_init(&req);
+
+	for (;;) {
+		fd = accept(srv->fd, NULL, NULL);
+
+		pthread_mutex_lock(&srv->lock);
+		if (srv->stop) {
+			pthread_mutex_unlock(&srv->lock);
+			if (fd != -1)
+				close(fd);
+			break;
+		}
+
+		w->conn = fd;
+		pthread_mutex_unlock(&srv->lock);
+
+		/* Out of file descriptors or a client gone before being
+		 * accepted, the next one may do better. */
+		if (fd == -1)
+			continue;
+
+		serve(w, fd, &req);
+
+		pthread_mutex_lock(&srv->lock);
+		w->conn = -1;
+		pthread_mutex_unlock(&srv->lock);
+		close(fd);
+	}
+
+	proto_fini(&req);
+	return NULL;
+}
+
+
+
+/* Remove the socket of a server that didn't stop cleanly. Fail with
+ * EADDRINUSE if it is still running, and leave anything but a socket. */
+static int remove_stale(const struct sockaddr_un *addr) {
+	struct stat st;
+	int fd;
+	int ret;
+
+	if (lstat(addr->sun_path, &st) == -1 || !S_ISSOCK(st.st_mode))
+		return ERR_OK;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		return ERR_IO;
+
+	ret = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+	close(fd);
+
+	if (ret == 0) {
+		errno = EADDRINUSE;
+		return ERR_IO;
+	}
+
+	if (unlink(addr->sun_path) == -1 && errno != ENOENT)
+		return ERR_IO;
+
+	return ERR_OK;
+}
+
+
+
+static int listen_on(const char *path, int *fd) {
+	struct sockaddr_un addr;
+	int err;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return ERR_INVAL;
+
+	strcpy(addr.sun_path, path);
+
+	err = remove_stale(&addr);
+	if (err != ERR_OK)
+		return err;
+
+	*fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (*fd == -1)
+		return ERR_IO;
+
+	if (bind(*fd, (const struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		err = errno;
+		close(*fd);
+		errno = err;
+		return ERR_IO;
+	}
+
+	if (listen(*fd, LISTEN_BACKLOG) == -1) {
+		err = errno;
+		close(*fd);
+		unlink(path);
+		errno = err;
+		return ERR_IO;
+	}
+
+	return ERR_OK;
+}
+
+
+
+void server_config_init(struct server_config *cfg, const char *path,
+                        server_handler_fn *handler, void *arg,
+                        size_t nthreads) {
+	long ncpus;
+
+	if (nthreads == 0) {
+		ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->path = path;
+	cfg->nthreads = nthreads;
+	cfg->handler = handler;
+	cfg->arg = arg;
+}
+
+
+
+int server_run(const struct server_config *cfg) {
+	struct server srv;
+	struct worker *workers;
+	sigset_t set, oldset;
+	size_t nstarted;
+	size_t i;
+	int sig;
+	int err;
+
+	if (cfg->nthreads == 0)
+		return ERR_INVAL;
+
+	memset(&srv, 0, sizeof(srv));
+	srv.cfg = cfg;
+
+	workers = malloc(cfg->nthreads * sizeof(*workers));
+	if (workers == NULL)
+		return ERR_NOMEM;
+
+	err = listen_on(cfg->path, &srv.fd);
+	if (err != ERR_OK)
+		goto err_listen;
+
+	pthread_mutex_init(&srv.lock, NULL);
+
+	/* The workers inherit the mask, the signals can only be taken by
+	 * sigwait. */
+	sigemptyset(&set);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &set, &oldset);
+
+	for (nstarted = 0; nstarted < cfg->nthreads; nstarted++) {
+		workers[nstarted].srv = &srv;
+		workers[nstarted].idx = nstarted;
+		workers[nstarted].conn = -1;
+		if (pthread_create(&workers[nstarted].thread, NULL,
+		                   worker_main, &workers[nstarted]) != 0)
+			break;
+	}
+
+	if (nstarted == 0)
+		err = ERR_THREAD;
+	else
+		sigwait(&set, &sig);
+
+	/* Wake up the workers waiting in accept, and those waiting for the
+	 * next request of a client. */
+	pthread_mutex_lock(&srv.lock);
+	srv.stop = 1;
+	shutdown(srv.fd, SHUT_RDWR);
+	for (i = 0; i < nstarted; i++)
+		if (workers[i].conn != -1)
+			shutdown(workers[i].conn, SHUT_RD);
+	pthread_mutex_unlock(&srv.lock);
+
+	for (i = 0; i < nstarted; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	pthread_mutex_destroy(&srv.lock);
+	close(srv.fd);
+	unlink(cfg->path);
+err_listen:
+	free(workers);
+	return err;
+}
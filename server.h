@@ -0,0 +1,55 @@
+#ifndef SERVER_H__
+#define SERVER_H__
+
+/*
+ * This module answer the requests of the clients connecting to a Unix domain
+ * socket, with the protocol of proto.h.
+ *
+ * A pool of worker threads is started once and kept for the life of the
+ * server, each thread serving one connection at a time. Whatever the handler
+ * keeps per thread, like a struct cracker and its arena, is thus reused from a
+ * request to the next instead of being set up again for every text.
+ */
+
+#include <sys/types.h>
+
+#include "proto.h"
+
+
+/*
+ * Function answering a request. thread is the index of the worker thread
+ * calling it, to let it use per-thread data. The text of the request may be
+ * modified in place and used as the text of the response. The memory the
+ * response points to must stay valid until the next call from the same
+ * thread. Return an error code, which is sent as the op of the response.
+ */
+typedef int server_handler_fn(void *arg, size_t thread, struct proto_msg *req,
+                              struct proto_msg *resp);
+
+struct server_config {
+	/* Path of the socket. */
+	const char *path;
+	size_t nthreads;
+	server_handler_fn *handler;
+	void *arg;
+};
+
+
+
+/* Fill cfg with the default values. nthreads may be 0 for one per CPU. */
+void server_config_init(struct server_config *cfg, const char *path,
+                        server_handler_fn *handler, void *arg,
+                        size_t nthreads);
+
+/*
+ * Serve the requests until the process receives SIGINT or SIGTERM. The two
+ * signals are blocked during the call so that they stop the server cleanly,
+ * letting the requests being processed finish, and the socket is removed.
+ * A socket left by a server that didn't stop cleanly is replaced.
+ * Return ERR_INVAL if the path is too long for a socket, and ERR_IO with errno
+ * set if the socket can't be set up, EADDRINUSE when a server is still running
+ * there.
+ */
+int server_run(const struct server_config *cfg);
+
+#endif
@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "error.h"
+#include "arena.h"
+#include "perf.h"
+#include "stats.h"
+
+
+
+static const char *const stage_names[STATS_LAST] = {
+	"read",
+	"filter",
+	"kasiski",
+	"ioc",
+	"hamming",
+	"crib",
+	"dict",
+	"brute",
+	"beam",
+	"sample",
+	"freq",
+	"encrypt",
+	"decrypt",
+	"write"
+};
+
+
+
+static double clock_seconds(clockid_t id) {
+	struct timespec ts;
+
+	if (clock_gettime(id, &ts) != 0)
+		return 0;
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+void stats_init(struct stats *st) {
+	memset(st, 0, sizeof(*st));
+}
+
+
+
+const char *stats_stage_name(enum stats_stage stage) {
+	if (stage >= STATS_LAST)
+		return NULL;
+
+	return stage_names[stage];
+}
+
+
+
+void stats_begin(struct stats *st, const struct arena *arena) {
+	if (st == NULL)
+		return;
+
+	st->arena = arena;
+	if (arena != NULL) {
+		st->allocs_start = arena->nallocs;
+		st->alloc_bytes_start = arena->allocated;
+	}
+
+	st->cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+	st->wall_start = clock_seconds(CLOCK_MONOTONIC);
+
+	if (st->perf != NULL)
+		perf_start(st->perf);
+}
+
+
+
+void stats_end(struct stats *st, enum stats_stage stage, size_t bytes) {
+	struct stats_entry *e;
+	double wall, cpu;
+	double counter[PERF_LAST];
+	int has_counters = 0;
+	size_t i;
+
+	if (st == NULL)
+		return;
+
+	if (st->perf != NULL)
+		has_counters = perf_stop(st->perf, counter) == ERR_OK;
+
+	wall = clock_seconds(CLOCK_MONOTONIC);
+	cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+	e = &st->stage[stage];
+	e->calls++;
+	e->wall += wall - st->wall_start;
+	e->cpu += cpu - st->cpu_start;
+	e->bytes += bytes;
+
+	if (st->arena != NULL) {
+		e->allocs += st->arena->nallocs - st->allocs_start;
+		e->alloc_bytes += st->arena->allocated - st->alloc_bytes_start;
+	}
+
+	if (has_counters) {
+		for (i = 0; i < PERF_LAST; i++)
+			e->counter[i] += counter[i];
+		e->has_counters = 1;
+	}
+
+	st->arena = NULL;
+}
+
+
+
+/* Write the hardware counters, and the ratios derived from them. */
+static void write_counters(const struct stats_entry *e,
+                           const struct perf_group *pg, FILE *f) {
+	double cycles = e->counter[PERF_CYCLES];
+	double bytes = e->bytes;
+	size_t i;
+
+	for (i = 0; i < PERF_LAST; i++) {
+		if (perf_has(pg, i))
+			fprintf(f, ", \"%s\": %.0f", perf_counter_name(i),
+			        e->counter[i]);
+	}
+
+	if (perf_has(pg, PERF_INSTRUCTIONS) && cycles > 0)
+		fprintf(f, ", \"ipc\": %.3f",
+		        e->counter[PERF_INSTRUCTIONS] / cycles);
+
+	if (perf_has(pg, PERF_CACHE_MISSES) && bytes > 0)
+		fprintf(f, ", \"cache_misses_per_byte\": %.6f",
+		        e->counter[PERF_CACHE_MISSES] / bytes);
+
+	if (perf_has(pg, PERF_BRANCH_MISSES) && bytes > 0)
+		fprintf(f, ", \"branch_misses_per_byte\": %.6f",
+		        e->counter[PERF_BRANCH_MISSES] / bytes);
+}
+
+
+
+static void write_entry(const struct stats *st, const struct stats_entry *e,
+                        FILE *f) {
+	double mbps = e->wall > 0 ? e->bytes / e->wall / 1e6 : 0;
+
+	fprintf(f, "\"calls\": %lu, \"wall_s\": %.9f, \"cpu_s\": %.9f, "
+	        "\"bytes\": %lu, \"mb_per_s\": %.3f, \"allocs\": %lu, "
+	        "\"alloc_bytes\": %lu", (unsigned long)e->calls, e->wall,
+	        e->cpu, (unsigned long)e->bytes, mbps,
+	        (unsigned long)e->allocs, (unsigned long)e->alloc_bytes);
+
+	if (st->perf != NULL && e->has_counters)
+		write_counters(e, st->perf, f);
+
+	fprintf(f, "}");
+}
+
+
+
+int stats_write_json(const struct stats *st, FILE *f) {
+	struct stats_entry total;
+	size_t i, j;
+	int first = 1;
+
+	memset(&total, 0, sizeof(total));
+	fprintf(f, "{\"stages\": [");
+
+	for (i = 0; i < STATS_LAST; i++) {
+		const struct stats_entry *e = &st->stage[i];
+
+		if (e->calls == 0)
+			continue;
+
+		fprintf(f, "%s\n  {\"name\": \"%s\", ", first ? "" : ",",
+		        stage_names[i]);
+		write_entry(st, e, f);
+		first = 0;
+
+		total.calls += e->calls;
+		total.wall += e->wall;
+		total.cpu += e->cpu;
+		if (e->bytes > total.bytes)
+			total.bytes = e->bytes;
+		total.allocs += e->allocs;
+		total.alloc_bytes += e->alloc_bytes;
+
+		for (j = 0; j < PERF_LAST; j++)
+			total.counter[j] += e->counter[j];
+		total.has_counters |= e->has_counters;
+	}
+
+	/* Bytes aren't summed since every stage goes over the same text. The
+	 * total is the size of the biggest one, usually the input. */
+	fprintf(f, "\n], \"total\": {");
+	write_entry(st, &total, f);
+	fprintf(f, "}\n");
+
+	if (fflush(f) != 0 || ferror(f))
+		return ERR_IO;
+
+	return ERR_OK;
+}
+
+
+
+int stats_json(const struct stats *st, char **str, size_t *len) {
+	FILE *f;
+	int err;
+
+	f = open_memstream(str, len);
+	if (f == NULL)
+		return ERR_NOMEM;
+
+	err = stats_write_json(st, f);
+	if (fclose(f) != 0 && err == ERR_OK)
+		err = ERR_NOMEM;
+
+	/* The stream ran out of memory. */
+	if (err != ERR_OK) {
+		free(*str);
+		*str = NULL;
+		return ERR_NOMEM;
+	}
+
+	return ERR_OK;
+}
@@ -0,0 +1,98 @@
+#ifndef STATS_H__
+#define STATS_H__
+
+/*
+ * This module measure the cost of every processing stage: wall time, CPU
+ * time, bytes processed and the allocations made from an arena in the
+ * meantime. Only one stage may be measured at a time with a given struct
+ * stats, and the CPU time is the one of the whole process.
+ *
+ * The hardware counters of a struct perf_group can be recorded as well by
+ * setting the perf field. They only count the thread calling stats_begin.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "arena.h"
+#include "perf.h"
+
+
+enum stats_stage {
+	STATS_READ,
+	STATS_FILTER,
+	STATS_KASISKI,
+	STATS_IOC,
+	STATS_HAMMING,
+	STATS_CRIB,
+	STATS_DICT,
+	STATS_BRUTE,
+	STATS_BEAM,
+	STATS_SAMPLE,
+	STATS_FREQ,
+	STATS_ENCRYPT,
+	STATS_DECRYPT,
+	STATS_WRITE,
+	STATS_LAST
+};
+
+
+struct stats_entry {
+	size_t calls;
+	double wall;
+	double cpu;
+	size_t bytes;
+
+	/* Allocations made from the arena given to stats_begin. */
+	size_t allocs;
+	size_t alloc_bytes;
+
+	/* Hardware counters. Only meaningful if has_counters is set. */
+	double counter[PERF_LAST];
+	int has_counters;
+};
+
+
+struct stats {
+	struct stats_entry stage[STATS_LAST];
+
+	/* Opened counters to record, or NULL. */
+	struct perf_group *perf;
+
+	/* State of the stage being measured. */
+	double wall_start;
+	double cpu_start;
+	const struct arena *arena;
+	size_t allocs_start;
+	size_t alloc_bytes_start;
+};
+
+
+
+/* Initialize a struct stats with every counter set to 0. */
+void stats_init(struct stats *st);
+
+/* Return the name of a stage. */
+const char *stats_stage_name(enum stats_stage stage);
+
+/*
+ * Start measuring a stage. arena is the one the stage allocate from. It may be
+ * NULL if the stage doesn't use one, the allocations are then not counted.
+ * st may be NULL, in which case nothing is done.
+ */
+void stats_begin(struct stats *st, const struct arena *arena);
+
+/* Add the cost since stats_begin to the given stage. */
+void stats_end(struct stats *st, enum stats_stage stage, size_t bytes);
+
+/*
+ * Write the stages that have been run as a JSON object.
+ * Return ERR_IO if writing fails.
+ */
+int stats_write_json(const struct stats *st, FILE *f);
+
+/* Same as stats_write_json into a malloc'ed nul-terminated string of len
+ * bytes. */
+int stats_json(const struct stats *st, char **str, size_t *len);
+
+#endif
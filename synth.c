@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "charset.h"
+#include "corpus.h"
+#include "synth.h"
+
+
+
+#define SYM_SPACE 26
+#define SYM_PERIOD 27
+
+
+
+/* Map a character to a symbol of the model, -1 for the ones ignored. */
+static int sym_of(char c) {
+	if (c >= 'a' && c <= 'z')
+		return c - 'a';
+
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A';
+
+	if (c == ' ' || c == '\n')
+		return SYM_SPACE;
+
+	if (c == '.' || c == '?' || c == '!')
+		return SYM_PERIOD;
+
+	return -1;
+}
+
+
+
+void synth_seed(struct synth_rng *r, unsigned long seed) {
+	/* xorshift doesn't like 0. */
+	r->state = (seed & 0xffffffffUL) != 0 ? seed & 0xffffffffUL : 1;
+}
+
+
+
+unsigned long synth_rand(struct synth_rng *r, unsigned long n) {
+	unsigned long x = r->state;
+
+	/* 32 bits xorshift, masked to work with any size of long. */
+	x ^= (x << 13) & 0xffffffffUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xffffffffUL;
+	r->state = x;
+
+	return n > 0 ? x % n : 0;
+}
+
+
+
+void synth_train(struct synth_model *m) {
+	size_t i;
+	int a = SYM_PERIOD, b = SYM_SPACE;
+
+	memset(m, 0, sizeof(*m));
+
+	for (i = 0; i < corpus_en_count; i++) {
+		const char *p;
+
+		for (p = corpus_en[i]; *p != '\0'; p++) {
+			int c = sym_of(*p);
+
+			if (c == -1)
+				continue;
+
+			/* Squeeze the spaces. */
+			if (c == SYM_SPACE && b == SYM_SPACE)
+				continue;
+
+			m->count[a][b][c]++;
+			m->total[a][b]++;
+			a = b;
+			b = c;
+		}
+
+		m->count[a][b][SYM_SPACE]++;
+		m->total[a][b]++;
+		a = b;
+		b = SYM_SPACE;
+	}
+}
+
+
+
+/* Draw the symbol following a and b. */
+static int next_sym(const struct synth_model *m, struct synth_rng *r, int a,
+                    int b) {
+	unsigned long x;
+	int c;
+
+	/* Never seen this pair, restart a sentence. */
+	if (m->total[a][b] == 0)
+		return SYM_PERIOD;
+
+	x = synth_rand(r, m->total[a][b]);
+	for (c = 0; c < SYNTH_NSYM; c++) {
+		if (x < m->count[a][b][c])
+			return c;
+		x -= m->count[a][b][c];
+	}
+
+	return SYM_SPACE;
+}
+
+
+
+void synth_text(const struct synth_model *m, struct synth_rng *r, char *buf,
+                size_t len) {
+	int a = SYM_PERIOD, b = SYM_SPACE;
+	int upper = 1;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		int c = next_sym(m, r, a, b);
+
+		if (c == SYM_SPACE) {
+			buf[i] = ' ';
+		} else if (c == SYM_PERIOD) {
+			buf[i] = '.';
+			upper = 1;
+		} else {
+			buf[i] = (upper ? 'A' : 'a') + c;
+			upper = 0;
+		}
+
+		a = b;
+		b = c;
+	}
+}
+
+
+
+void synth_key(struct synth_rng *r, const struct charset *cs, char *key,
+               size_t klen) {
+	size_t i;
+
+	for (i = 0; i < klen; i++)
+		key[i] = cs_chr(cs, synth_rand(r, cs->length));
+
+	key[klen] = '\0';
+}
@@ -0,0 +1,53 @@
+#ifndef SYNTH_H__
+#define SYNTH_H__
+
+/*
+ * This module generate synthetic plaintexts and keys to test and benchmark
+ * the cracker.
+ * The text comes from an order 2 Markov model of the letters, spaces and
+ * periods of the English corpus. It doesn't make sense, but it has the letter
+ * and bigram frequencies of English text.
+ */
+
+#include <sys/types.h>
+
+#include "charset.h"
+
+
+/* Letters, space and period. */
+#define SYNTH_NSYM 28
+
+
+/* Small pseudo-random number generator so that runs are reproducible. */
+struct synth_rng {
+	unsigned long state;
+};
+
+struct synth_model {
+	/* count[a][b][c] is the number of times c followed a and b. */
+	unsigned long count[SYNTH_NSYM][SYNTH_NSYM][SYNTH_NSYM];
+	unsigned long total[SYNTH_NSYM][SYNTH_NSYM];
+};
+
+
+
+void synth_seed(struct synth_rng *r, unsigned long seed);
+
+/* Return a random number in [0, n). */
+unsigned long synth_rand(struct synth_rng *r, unsigned long n);
+
+/* Build the model from the English corpus. */
+void synth_train(struct synth_model *m);
+
+/*
+ * Fill buf with len bytes of generated text. Sentences start with an
+ * uppercase letter, the rest is lowercase.
+ */
+void synth_text(const struct synth_model *m, struct synth_rng *r, char *buf,
+                size_t len);
+
+/* Generate a nul-terminated random key of klen characters of cs. */
+void synth_key(struct synth_rng *r, const struct charset *cs, char *key,
+               size_t klen);
+
+#endif
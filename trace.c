@@ -0,0 +1,235 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "trace.h"
+
+
+
+struct trace_event {
+	const char *name;
+	const char *label;
+	long value;
+	double ts;
+	double dur;
+};
+
+struct trace_chunk {
+	struct trace_chunk *next;
+	size_t n;
+	struct trace_event ev[TRACE_CHUNK_EVENTS];
+};
+
+
+
+static double now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+
+static char *copy_str(const char *str) {
+	char *c;
+
+	if (str == NULL)
+		return NULL;
+
+	c = malloc(strlen(str) + 1);
+	if (c != NULL)
+		strcpy(c, str);
+
+	return c;
+}
+
+
+
+void trace_init(struct trace *t) {
+	memset(t, 0, sizeof(*t));
+	t->start = now();
+}
+
+
+
+static void free_buf(struct trace_buf *b) {
+	struct trace_chunk *c, *next;
+
+	for (c = b->first; c != NULL; c = next) {
+		next = c->next;
+		free(c);
+	}
+
+	free(b->name);
+	free(b);
+}
+
+
+
+void trace_fini(struct trace *t) {
+	struct trace_buf *b, *next;
+
+	for (b = t->bufs; b != NULL; b = next) {
+		next = b->next;
+		free_buf(b);
+	}
+
+	memset(t, 0, sizeof(*t));
+}
+
+
+
+struct trace_buf *trace_thread(struct trace *t, const char *name) {
+	struct trace_buf *b;
+
+	if (t == NULL)
+		return NULL;
+
+	b = malloc(sizeof(*b));
+	if (b == NULL)
+		return NULL;
+
+	memset(b, 0, sizeof(*b));
+	b->trace = t;
+	b->name = copy_str(name);
+	b->tid = __atomic_add_fetch(&t->nbufs, 1, __ATOMIC_RELAXED);
+
+	/* Push the buffer at the head of the list. */
+	b->next = __atomic_load_n(&t->bufs, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&t->bufs, &b->next, b, 1,
+	                                    __ATOMIC_RELEASE,
+	                                    __ATOMIC_RELAXED))
+		;
+
+	return b;
+}
+
+
+
+double trace_begin(const struct trace_buf *b) {
+	if (b == NULL)
+		return 0;
+
+	return now();
+}
+
+
+
+void trace_end(struct trace_buf *b, double start, const char *name,
+               const char *label, long value) {
+	struct trace_chunk *c;
+	struct trace_event *e;
+	double end;
+
+	if (b == NULL)
+		return;
+
+	end = now();
+
+	c = b->cur;
+	if (c == NULL || c->n == TRACE_CHUNK_EVENTS) {
+		c = malloc(sizeof(*c));
+		if (c == NULL) {
+			b->dropped++;
+			return;
+		}
+
+		c->next = NULL;
+		c->n = 0;
+
+		if (b->cur == NULL)
+			b->first = c;
+		else
+			b->cur->next = c;
+		b->cur = c;
+	}
+
+	e = &c->ev[c->n++];
+	e->name = name;
+	e->label = label;
+	e->value = value;
+	e->ts = start - b->trace->start;
+	e->dur = end - start;
+}
+
+
+
+/* Write a JSON string with the needed escapes. */
+static void write_string(FILE *f, const char *str) {
+	const unsigned char *p;
+
+	fputc('"', f);
+	for (p = (const unsigned char *)str; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(f, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(f, "\\u%04x", *p);
+		else
+			fputc(*p, f);
+	}
+	fputc('"', f);
+}
+
+
+
+static void write_event(FILE *f, const struct trace_event *e, long pid,
+                        unsigned long tid) {
+	fprintf(f, ",\n{\"name\": ");
+	write_string(f, e->name);
+	fprintf(f, ", \"cat\": \"unvigenere\", \"ph\": \"X\", \"ts\": %.3f, "
+	        "\"dur\": %.3f, \"pid\": %ld, \"tid\": %lu", e->ts * 1e6,
+	        e->dur * 1e6, pid, tid);
+
+	if (e->label != NULL || e->value >= 0) {
+		fprintf(f, ", \"args\": {");
+		if (e->label != NULL) {
+			fprintf(f, "\"label\": ");
+			write_string(f, e->label);
+		}
+		if (e->value >= 0)
+			fprintf(f, "%s\"value\": %ld",
+			        e->label != NULL ? ", " : "", e->value);
+		fprintf(f, "}");
+	}
+
+	fprintf(f, "}");
+}
+
+
+
+int trace_write(const struct trace *t, FILE *f) {
+	const struct trace_buf *b;
+	const struct trace_chunk *c;
+	long pid = getpid();
+	size_t i;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %ld, "
+	        "\"args\": {\"name\": \"unvigenere\"}}", pid);
+
+	for (b = t->bufs; b != NULL; b = b->next) {
+		fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+		        "\"pid\": %ld, \"tid\": %lu, \"args\": {\"name\": ",
+		        pid, b->tid);
+		write_string(f, b->name != NULL ? b->name : "thread");
+		fprintf(f, ", \"dropped\": %lu}}", (unsigned long)b->dropped);
+
+		for (c = b->first; c != NULL; c = c->next) {
+			for (i = 0; i < c->n; i++)
+				write_event(f, &c->ev[i], pid, b->tid);
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+
+	if (fflush(f) != 0 || ferror(f))
+		return ERR_IO;
+
+	return ERR_OK;
+}
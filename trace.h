@@ -0,0 +1,80 @@
+#ifndef TRACE_H__
+#define TRACE_H__
+
+/*
+ * This module record spans of time and write them in the Chrome trace event
+ * format, which can be loaded into chrome://tracing or Perfetto.
+ *
+ * Every thread records into its own struct trace_buf, so no lock is taken
+ * while tracing. A buffer is obtained once per thread with trace_thread and
+ * then only used by that thread. Every function accepts a NULL struct trace
+ * or struct trace_buf, and then does nothing, so that the instrumented code
+ * doesn't need to check whether tracing is enabled.
+ *
+ * The names and the labels of the spans are not copied, so that recording a
+ * span never allocates memory besides the chunks of events. They must be
+ * string literals or otherwise remain valid until trace_write.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+
+#define TRACE_CHUNK_EVENTS 1024
+
+
+struct trace_chunk;
+struct trace;
+
+struct trace_buf {
+	struct trace_buf *next;
+	struct trace *trace;
+	unsigned long tid;
+	char *name;
+
+	struct trace_chunk *first;
+	struct trace_chunk *cur;
+
+	/* Events lost because of a memory allocation failure. */
+	size_t dropped;
+};
+
+struct trace {
+	/* List of all the buffers, pushed without lock. */
+	struct trace_buf *bufs;
+	unsigned long nbufs;
+	double start;
+};
+
+
+
+/* Initialize a trace. Time is counted from now. */
+void trace_init(struct trace *t);
+
+/* Free the trace and all its buffers. */
+void trace_fini(struct trace *t);
+
+/*
+ * Get a new buffer for the calling thread, shown with the given name. May be
+ * called concurrently from any number of threads. Return NULL if t is NULL or
+ * on memory allocation failure, tracing is then disabled for this thread.
+ */
+struct trace_buf *trace_thread(struct trace *t, const char *name);
+
+/* Return the start time to give to trace_end. */
+double trace_begin(const struct trace_buf *b);
+
+/*
+ * Record a span named name from start till now. label may be NULL and value
+ * may be negative if not relevant.
+ */
+void trace_end(struct trace_buf *b, double start, const char *name,
+               const char *label, long value);
+
+/*
+ * Write all the events in JSON. Must not be called while other threads are
+ * still tracing. Return ERR_IO if writing fails.
+ */
+int trace_write(const struct trace *t, FILE *f);
+
+#endif
@@ -1,16 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <ctype.h>
 
 #include "getopthelp.h"
-#include "cracker.h"
-#include "filtered_string.h"
-#include "vigenere.h"
-#include "charset.h"
-#include "array.h"
+#include "libunvigenere.h"
+#include "io.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "server.h"
+#include "records.h"
 #include "misc.h"
 
 
+/* Size of the reads of --follow. */
+#define FOLLOW_BUFSIZE (64 * 1024)
+
 
 enum action {
 	ACTION_ENCRYPT,
@@ -24,6 +30,31 @@ enum option_id {
 	OPT_KASISKI_MIN_LENGTH = 256,
 	OPT_SHOW_KASISKI_TABLE,
 	OPT_SHOW_KASISKI_LENGTH,
+	OPT_BATCH,
+	OPT_THREADS,
+	OPT_NO_URING,
+	OPT_ESTIMATOR,
+	OPT_STATS,
+	OPT_STATS_FILE,
+	OPT_PERF_COUNTERS,
+	OPT_TRACE,
+	OPT_BYTES,
+	OPT_CIPHER,
+	OPT_ALPHABET_KEY,
+	OPT_CRIB,
+	OPT_WORDLIST,
+	OPT_BRUTE_FORCE,
+	OPT_TOP,
+	OPT_BEAM,
+	OPT_FOLLOW,
+	OPT_SAMPLE,
+	OPT_TIME_BUDGET,
+	OPT_CHECKPOINT,
+	OPT_CHECKPOINT_INTERVAL,
+	OPT_RESUME,
+	OPT_CACHE,
+	OPT_SERVE,
+	OPT_RECORDS,
 	OPT_LAST
 };
 
@@ -47,24 +78,116 @@ static const struct goh_option opt_desc[] = {
 		"Show the score table for the kasiski method."},
 	{"show-kasiski-length", '\0', GOH_ARG_REFUSED, OPT_SHOW_KASISKI_LENGTH,
 		"Show the probable key length with respect to kasiski method."},
+	{"estimator", '\0', GOH_ARG_REQUIRED, OPT_ESTIMATOR,
+		"Method used to find the key length, kasiski or ioc (index of "
+		"coincidence). Default to kasiski. With --bytes, ioc or "
+		"hamming, default to ioc."},
+	{"crib", '\0', GOH_ARG_REQUIRED, OPT_CRIB,
+		"Known fragment of the plaintext. The key is recovered from "
+		"the positions where it implies a periodic key instead of "
+		"using an estimator and a frequency analysis."},
+	{"wordlist", '\0', GOH_ARG_REQUIRED, OPT_WORDLIST,
+		"File with one candidate key per line. The one whose "
+		"decryption looks the most like English is used instead of "
+		"an estimator and a frequency analysis."},
+	{"brute-force", '\0', GOH_ARG_OPTIONAL, OPT_BRUTE_FORCE,
+		"Try every key up to the given length, 6 by default, and keep "
+		"the one whose decryption looks the most like English."},
+	{"top", '\0', GOH_ARG_REQUIRED, OPT_TOP,
+		"Show the given number of best keys found by --brute-force or "
+		"--beam."},
+	{"beam", '\0', GOH_ARG_OPTIONAL, OPT_BEAM,
+		"Refine the frequency analysis with a beam search of the given "
+		"width, 64 by default, over the best shifts of every column."},
+	{"follow", '\0', GOH_ARG_REFUSED, OPT_FOLLOW,
+		"Read the input as it arrives, like from a pipe, and print "
+		"the key found so far every time it changes. The statistics "
+		"are updated with the new data instead of being computed "
+		"again. Nothing is decrypted."},
+	{"sample", '\0', GOH_ARG_OPTIONAL, OPT_SAMPLE,
+		"Only analyze the beginning of the text, growing until the key "
+		"stays the same the given number of times in a row, 3 by "
+		"default, then decrypt the whole text. Each time, the text "
+		"analyzed is twice as long."},
+	{"time-budget", '\0', GOH_ARG_REQUIRED, OPT_TIME_BUDGET,
+		"Seconds the analysis of a text may take. When they're over, "
+		"the best key found so far is used and a warning is printed. "
+		"In batch mode, every file has its own budget."},
+	{"checkpoint", '\0', GOH_ARG_REQUIRED, OPT_CHECKPOINT,
+		"File where to save the progress of the Kasiski analysis, "
+		"--wordlist or --brute-force every so often and when the "
+		"time budget is over. It is removed once the analysis is "
+		"complete."},
+	{"checkpoint-interval", '\0', GOH_ARG_REQUIRED,
+		OPT_CHECKPOINT_INTERVAL,
+		"Seconds between two checkpoints. Default to 60."},
+	{"resume", '\0', GOH_ARG_REFUSED, OPT_RESUME,
+		"Continue the analysis from the --checkpoint file if it "
+		"exists. The text and the options must be the same."},
+	{"cache", '\0', GOH_ARG_REQUIRED, OPT_CACHE,
+		"Directory where to keep the Kasiski scores, the indexes of "
+		"coincidence and the column frequencies of the texts "
+		"cracked, to reuse them when cracking the same text again."},
 	{"charset", 'c', GOH_ARG_REQUIRED, 'c',
 		"Characters to be transformed. Use several --charset options "
 		"to make several characters equivalent. "
 		"Default is upper and lower alphabetic characters, "
-		"uppercase being equivalent to lowercase."}
+		"uppercase being equivalent to lowercase."},
+	{"cipher", '\0', GOH_ARG_REQUIRED, OPT_CIPHER,
+		"Cipher used to encrypt / decrypt: vigenere, beaufort, variant "
+		"(variant Beaufort) or keyed (Vigenere on a mixed alphabet, "
+		"see --alphabet-key). Default to vigenere."},
+	{"alphabet-key", '\0', GOH_ARG_REQUIRED, OPT_ALPHABET_KEY,
+		"Keyword the mixed alphabet of --cipher keyed starts with."},
+	{"bytes", '\0', GOH_ARG_OPTIONAL, OPT_BYTES,
+		"Work on raw bytes instead of a charset, every byte of the "
+		"key being XORed (xor, the default) or added (add) to the "
+		"data. The key may then hold any byte as \\xNN, and \\\\ "
+		"for a backslash."},
+	{"batch", '\0', GOH_ARG_REFUSED, OPT_BATCH,
+		"Process every file given as argument independently. "
+		"The output option is then the directory where to write them."},
+	{"records", '\0', GOH_ARG_OPTIONAL, OPT_RECORDS,
+		"Process every record of the input on its own, each one "
+		"starting at the beginning of the key, and write them in the "
+		"same order. The records are lines (line, the default) or end "
+		"with a nul byte (nul). When cracking, every record is "
+		"written as the key found, a tab and the decrypted record."},
+	{"serve", '\0', GOH_ARG_REQUIRED, OPT_SERVE,
+		"Answer the requests of unvigenere-client on the given Unix "
+		"socket until SIGINT or SIGTERM, with the cracking options "
+		"of the command line. Every worker thread keeps its "
+		"analyses' memory from a request to the next."},
+	{"stats", '\0', GOH_ARG_OPTIONAL, OPT_STATS,
+		"Record the time, bytes and allocations of every processing "
+		"stage and write them in the given format. Only json is "
+		"supported, which is the default. This disables streaming."},
+	{"stats-file", '\0', GOH_ARG_REQUIRED, OPT_STATS_FILE,
+		"Where to write the statistics. Default to stderr."},
+	{"perf-counters", '\0', GOH_ARG_REFUSED, OPT_PERF_COUNTERS,
+		"Add the hardware performance counters of every stage to the "
+		"statistics. Implies --stats."},
+	{"trace", '\0', GOH_ARG_REQUIRED, OPT_TRACE,
+		"Write a trace of every processing stage of every thread in "
+		"the Chrome trace event format to the given file."},
+	{"threads", 't', GOH_ARG_REQUIRED, OPT_THREADS,
+		"Number of worker threads in batch mode, record mode, server "
+		"mode, with --wordlist or --brute-force. "
+		"Default to the number of CPUs."},
+	{"no-uring", '\0', GOH_ARG_REFUSED, OPT_NO_URING,
+		"Use plain blocking reads and writes in batch mode "
+		"instead of io_uring."}
 };
 
 
 
-
-
 static void crack_ka_show_table(const struct cracker *ck) {
 	size_t i;
 	size_t nlen;
 
 	printf("Kasiski score table:\n");
 
-	nlen = strlen(ck->str->norm);
+	nlen = ck->str->nlen;
 	for (i = 0; i < nlen; i++)
 		printf("%lu: %lu\n", i, ck->ka.score[i]);
 }
@@ -72,43 +195,17 @@ static void crack_ka_show_table(const struct cracker *ck) {
 
 
 
-static const size_t *sort_score_helper_argument;
-
-
-
-static int sort_score_helper(const void *arg1, const void *arg2) {
-	const size_t *a = arg1;
-	const size_t *b = arg2;
-	const size_t *score = sort_score_helper_argument;
-
-	return score[*b] - score[*a];
-}
-
-
-
 static void crack_ka_show_length(const struct cracker *ck) {
 	size_t *ka_len;
 	size_t i;
 	size_t nlen;
 
-	nlen = strlen(ck->str->norm);
-
 	/*
-	 * Build a table of index into ck->ka.score. They happen to be probable
-	 * key length. The probability for the key to be length l is
-	 * ck->ka.score[l].
+	 * Get a table of index into ck->ka.score sorted by score. They happen
+	 * to be probable key length. The probability for the key to be length
+	 * l is ck->ka.score[l].
 	 */
-
-	ka_len = malloc(nlen * sizeof(ka_len));
-	if (ka_len == NULL)
-		system_error("malloc");
-
-	for (i = 0; i < nlen; i++)
-		ka_len[i] = i;
-
-	/* Sort that table according to the score. */
-	sort_score_helper_argument = ck->ka.score;
-	qsort(ka_len, nlen, sizeof(*ka_len), sort_score_helper);
+	check(ck_ka_lengths(ck, &ka_len, &nlen), "Kasiski key lengths");
 
 	printf("Probable key length with respect to Kasiski attack:");
 
@@ -134,26 +231,201 @@ static void crack_ka_show_length(const struct cracker *ck) {
 struct crack_args {
 	struct fs_ctx *str;
 	size_t klen;
+	enum ck_estimator estimator;
 	size_t ka_minlen;
 	int ka_show_table;
 	int ka_show_length;
+	struct stats *stats;
+	const char *crib;
+	const char *wordlist;
+	size_t brute_maxlen;
+	size_t ntop;
+	size_t beam_width;
+	size_t sample_rounds;
+	size_t nthreads;
+
+	/* Seconds allowed to the analysis of a text, 0 for no limit. */
+	double budget;
+
+	/* Where to save the progress of the analysis, NULL for nowhere, how
+	 * often, and whether to start from there. */
+	const char *checkpoint;
+	double ckpt_interval;
+	int resume;
+
+	/* Directory of the analysis cache, NULL for none. */
+	const char *cache_dir;
+
+	/* Substitution table of the cipher, NULL for plain Vigenere. */
+	const struct vig_table *table;
+
+	/* Byte mode. */
+	int bytes;
+	enum bytes_op bop;
+	enum bc_estimator bc_estimator;
+
+	/* The whole trace and the buffer of the main thread. */
+	struct trace *trace;
+	struct trace_buf *tb;
 };
 
 
 
+/* Deadline of an analysis starting now, see deadline.h. */
+static double budget_deadline(const struct crack_args *a) {
+	if (a->budget <= 0)
+		return 0;
+
+	return deadline_after(a->budget);
+}
+
+
+
+/* Tell that the key isn't the result of a complete analysis. */
+static void warn_expired(int expired) {
+	if (expired)
+		custom_warn("Time budget exceeded, the key is the best one "
+		            "found in time");
+}
+
+
+
+/* Tell that the analysis cache couldn't be updated. */
+static void warn_cache(const struct crack_args *a, int err) {
+	if (err != ERR_OK)
+		custom_warn("%s: Can't store the analyses: %s", a->cache_dir,
+		            err_str(err));
+}
+
+
+
+/* Initialize the checkpoint of an analysis, and read it back with --resume.
+ * The fingerprint is the one of the filtered text, more data may be added to
+ * it. Return 0 without --checkpoint. */
+static int ckpt_setup(struct ckpt *c, const struct crack_args *a,
+                      enum ckpt_kind kind, const void *more, size_t len) {
+	unsigned long fp;
+	int err;
+
+	if (a->checkpoint == NULL)
+		return 0;
+
+	fp = ckpt_hash(0, a->str->norm, a->str->nlen);
+	fp = ckpt_hash(fp, more, len);
+	check(ckpt_init(c, kind, fp), "Checkpoint");
+
+	if (!a->resume)
+		return 1;
+
+	/* The first run has nothing to resume from. */
+	err = ckpt_read(c, a->checkpoint);
+	if (err == ERR_IO && errno == ENOENT)
+		return 1;
+	if (err == ERR_IO)
+		system_error(a->checkpoint);
+	if (err == ERR_FORMAT)
+		custom_error("%s: Not a checkpoint of this analysis",
+		             a->checkpoint);
+	check(err, a->checkpoint);
+
+	return 1;
+}
+
+
+
+/* Check the error of a *_restore function. */
+static void check_restore(const struct crack_args *a, int err) {
+	if (err == ERR_FORMAT)
+		custom_error("%s: Saved with other options", a->checkpoint);
+	check(err, a->checkpoint);
+}
+
+
+
+static void write_checkpoint(const struct crack_args *a, struct ckpt *c) {
+	int err;
+
+	err = ckpt_write(c, a->checkpoint);
+	if (err == ERR_IO)
+		system_error(a->checkpoint);
+	check(err, a->checkpoint);
+}
+
+
+
+/* Remove the checkpoint of a complete analysis. */
+static void finish_checkpoint(const struct crack_args *a, int expired) {
+	if (a->checkpoint != NULL && !expired && remove(a->checkpoint) != 0 &&
+	    errno != ENOENT)
+		system_error(a->checkpoint);
+}
+
+
+
+/* Deadline of the next run of an analysis until the next checkpoint, when the
+ * whole analysis has the given deadline. */
+static double ckpt_deadline(const struct crack_args *a, double deadline) {
+	double d;
+
+	if (a->checkpoint == NULL)
+		return deadline;
+
+	d = deadline_after(a->ckpt_interval);
+	return deadline == 0 || d < deadline ? d : deadline;
+}
+
+
+
 static void crack(const struct crack_args *a) {
 	struct cracker ck;
-
+	struct cache cache;
+	struct ckpt c;
+	int ckpt;
+	size_t i;
+	double t;
+	int err;
 
 	ck_init(&ck, a->str);
 
 	if (a->klen != 0)
-		ck_set_length(&ck, a->klen);
+		check(ck_set_length(&ck, a->klen), "Key length");
 
+	ck.estimator = a->estimator;
+	ck.stats = a->stats;
+	ck.trace = a->tb;
 	if (a->ka_minlen != 0)
 		ck.ka_minlen = a->ka_minlen;
+	ck.beam_width = a->beam_width;
+	if (a->ntop != 0)
+		ck.beam_ntop = a->ntop;
+	ck.deadline = budget_deadline(a);
+
+	if (a->cache_dir != NULL) {
+		cache_init(&cache, a->cache_dir, a->str->norm, a->str->nlen,
+		           a->str->charset);
+		ck.cache = &cache;
+	}
 
-	ck_crack(&ck);
+	ckpt = ckpt_setup(&c, a, CKPT_KASISKI, NULL, 0);
+	if (ckpt) {
+		ck.ka_ckpt = &c;
+		ck.ckpt_file = a->checkpoint;
+		ck.ckpt_interval = a->ckpt_interval;
+	}
+
+	err = ck_crack(&ck);
+	if (err == ERR_FORMAT)
+		check_restore(a, err);
+	if (err == ERR_IO)
+		system_error(a->checkpoint);
+	if (err == ERR_CHARSET && a->beam_width != 0)
+		custom_error("--beam needs a charset of %d characters",
+		             NGRAM_NSYM);
+	if (err == ERR_TOOSHORT)
+		custom_error("Can't break key length of a text with only %lu "
+		             "signficant characters",
+		             (unsigned long)a->str->nlen);
+	check(err, "Crack");
 
 	if (a->ka_show_table)
 		crack_ka_show_table(&ck);
@@ -162,102 +434,1103 @@ static void crack(const struct crack_args *a) {
 	if (a->ka_show_length)
 		crack_ka_show_length(&ck);
 
+	if (a->ntop != 0) {
+		for (i = 0; i < ck.beam.nkeys; i++)
+			printf("Candidate key %lu: %s (score %.2f)\n",
+			       (unsigned long)i + 1, beam_key(&ck.beam, i),
+			       ck.beam.scores[i]);
+	}
+
+	if (ckpt) {
+		finish_checkpoint(a, ck.ka.expired);
+		ckpt_fini(&c);
+	}
 
+	warn_cache(a, ck.cache_err);
+	warn_expired(ck.expired);
 	printf("Found key: %s\n", ck.key);
 
-	vig_decrypt(a->str, ck.key);
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	check(vig_decrypt(a->str, ck.key), "Decrypt");
+	trace_end(a->tb, t, "decrypt", NULL, a->str->len);
+	stats_end(a->stats, STATS_DECRYPT, a->str->len);
 
 	ck_fini(&ck);
 }
 
 
 
-static void simple_action(struct fs_ctx *s, const char *key, enum action act) {
+/* Initialize a struct online with the options of the command line. */
+static void online_setup(struct online *ol, const struct crack_args *a,
+                         const struct charset *cs) {
+	size_t maxlen = IOC_DEFAULT_MAXLEN;
+	size_t minlen = 3;
+
+	if (a->klen > maxlen)
+		maxlen = a->klen;
+	if (a->ka_minlen != 0)
+		minlen = a->ka_minlen;
+
+	check(online_init(ol, cs, maxlen, minlen), "Analysis");
+	ol->estimator = a->estimator;
+}
+
+
+
+/* Crack the input while it is being read, printing every new key. */
+static void follow(const struct crack_args *a, const struct charset *cs,
+                   const char *filenamein) {
+	struct online ol;
+	char buf[FOLLOW_BUFSIZE];
+	char *last;
+	size_t klen;
+	int found = 0;
+	ssize_t nr;
+	int fd;
+	int err;
+
+	online_setup(&ol, a, cs);
+
+	last = calloc(ol.maxlen + 1, 1);
+	if (last == NULL)
+		check(ERR_NOMEM, "Follow");
+
+	fd = io_open_read(filenamein);
+	if (fd == -1)
+		system_error(filenamein);
+
+	while ((nr = io_read_some(fd, buf, sizeof(buf))) > 0) {
+		check(online_append(&ol, buf, nr), "Follow");
+
+		klen = a->klen != 0 ? a->klen : online_length(&ol);
+		if (klen == 0 || klen > online_size(&ol))
+			continue;
+
+		err = online_key(&ol, klen);
+		if (err == ERR_CHARSET)
+			custom_error("--follow needs a charset of %d characters",
+			             CS_ALPHA_LEN);
+		check(err, "Follow");
+
+		if (found && strcmp(last, ol.key) == 0)
+			continue;
+
+		strcpy(last, ol.key);
+
+		printf("Key after %lu characters: %s\n",
+		       (unsigned long)online_size(&ol), ol.key);
+		fflush(stdout);
+		found = 1;
+	}
+
+	if (nr < 0)
+		system_error(filenamein);
+
+	if (!found)
+		custom_error("Can't break key length of a text with only %lu "
+		             "signficant characters",
+		             (unsigned long)online_size(&ol));
+
+	io_close(fd);
+	free(last);
+	online_fini(&ol);
+}
+
+
+
+static void crib_crack(const struct crack_args *a) {
+	struct crib cr;
+	size_t i;
+	double t;
+	int err;
+
+	check(crib_init(&cr, a->str->norm, a->str->nlen, a->crib,
+	                a->str->charset, NULL), "Crib");
+	cr.klen = a->klen;
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	err = crib_analyze(&cr);
+	trace_end(a->tb, t, "crib", NULL, a->str->nlen);
+	stats_end(a->stats, STATS_CRIB, a->str->nlen);
+
+	if (err == ERR_TOOSHORT)
+		custom_error("The crib must be longer than the key by at "
+		             "least %lu characters",
+		             (unsigned long)cr.minchecks);
+	check(err, "Crib");
+
+	if (cr.hits_size == 0)
+		custom_error("No position of the crib implies a periodic key");
+
+	for (i = 0; i < cr.hits_size; i++)
+		printf("Crib at position %lu: key length %lu, key %s\n",
+		       (unsigned long)cr.hits[i].pos,
+		       (unsigned long)cr.hits[i].klen, cr.hits[i].key);
+
+	printf("Found key: %s\n", cr.hits[0].key);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	check(vig_decrypt(a->str, cr.hits[0].key), "Decrypt");
+	trace_end(a->tb, t, "decrypt", NULL, a->str->len);
+	stats_end(a->stats, STATS_DECRYPT, a->str->len);
+
+	crib_fini(&cr);
+}
+
+
+
+static void wordlist_crack(const struct crack_args *a) {
+	double deadline = budget_deadline(a);
+	struct io_buf list;
+	struct dict d;
+	struct ckpt c;
+	int ckpt;
+	double t;
+	int err;
+
+	err = io_read(&list, a->wordlist);
+	if (err == ERR_IO)
+		system_error(a->wordlist);
+	check(err, a->wordlist);
+
+	err = dict_init(&d, a->str->norm, a->str->nlen, a->str->charset, NULL);
+	if (err == ERR_CHARSET)
+		custom_error("--wordlist needs a charset of %d characters",
+		             CS_ALPHA_LEN);
+	check(err, "Wordlist");
+	d.klen = a->klen;
+	d.nthreads = a->nthreads;
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+
+	err = dict_load(&d, list.data, list.len);
+	if (err == ERR_INVAL)
+		custom_error("%s: No usable key", a->wordlist);
+	check(err, a->wordlist);
+
+	ckpt = ckpt_setup(&c, a, CKPT_DICT, list.data, list.len);
+	if (ckpt && c.data_size > 0)
+		check_restore(a, dict_restore(&d, &c));
+
+	for (;;) {
+		d.deadline = ckpt_deadline(a, deadline);
+		err = dict_crack(&d);
+		if (err != ERR_OK || !d.expired || !ckpt)
+			break;
+
+		ckpt_clear(&c);
+		check(dict_save(&d, &c), "Checkpoint");
+		write_checkpoint(a, &c);
+
+		if (deadline_passed(deadline))
+			break;
+	}
+	trace_end(a->tb, t, "dict", NULL, list.len);
+	stats_end(a->stats, STATS_DICT, list.len);
+
+	if (err == ERR_TOOSHORT)
+		custom_error("Can't crack a text with no signficant character");
+	check(err, "Crack");
+
+	if (ckpt) {
+		finish_checkpoint(a, d.expired);
+		ckpt_fini(&c);
+	}
+
+	warn_expired(d.expired);
+	printf("Found key: %s\n", d.key);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	check(vig_decrypt(a->str, d.key), "Decrypt");
+	trace_end(a->tb, t, "decrypt", NULL, a->str->len);
+	stats_end(a->stats, STATS_DECRYPT, a->str->len);
+
+	dict_fini(&d);
+	io_release(&list);
+}
+
+
+
+static void exhaustive_crack(const struct crack_args *a) {
+	double deadline = budget_deadline(a);
+	struct brute b;
+	struct ckpt c;
+	int ckpt;
+	size_t i;
+	double t;
+	int err;
+
+	err = brute_init(&b, a->str->norm, a->str->nlen, a->str->charset,
+	                 NULL);
+	if (err == ERR_CHARSET)
+		custom_error("--brute-force needs a charset of %d characters",
+		             NGRAM_NSYM);
+	check(err, "Brute force");
+	b.maxlen = a->brute_maxlen;
+	if (a->klen != 0)
+		b.minlen = b.maxlen = a->klen;
+	b.ntop = a->ntop != 0 ? a->ntop : 1;
+	b.nthreads = a->nthreads;
+
+	ckpt = ckpt_setup(&c, a, CKPT_BRUTE, NULL, 0);
+	if (ckpt && c.data_size > 0) {
+		err = brute_restore(&b, &c);
+		if (err == ERR_INVAL)
+			custom_error("Brute force only goes up to keys of %d "
+			             "characters", BRUTE_MAX_KLEN);
+		check_restore(a, err);
+	}
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	for (;;) {
+		b.deadline = ckpt_deadline(a, deadline);
+		err = brute_crack(&b);
+		if (err != ERR_OK || !b.expired || !ckpt)
+			break;
+
+		ckpt_clear(&c);
+		check(brute_save(&b, &c), "Checkpoint");
+		write_checkpoint(a, &c);
+
+		if (deadline_passed(deadline))
+			break;
+	}
+	trace_end(a->tb, t, "brute", NULL, a->str->nlen);
+	stats_end(a->stats, STATS_BRUTE, a->str->nlen);
+
+	if (err == ERR_INVAL)
+		custom_error("Brute force only goes up to keys of %d "
+		             "characters", BRUTE_MAX_KLEN);
+	if (err == ERR_TOOSHORT)
+		custom_error("Can't brute force a text with only %lu "
+		             "signficant characters",
+		             (unsigned long)a->str->nlen);
+	check(err, "Brute force");
+
+	if (ckpt) {
+		finish_checkpoint(a, b.expired);
+		ckpt_fini(&c);
+	}
+
+	if (a->ntop != 0) {
+		for (i = 0; i < b.top_size; i++)
+			printf("Candidate key %lu: %s (score %.2f)\n",
+			       (unsigned long)i + 1, b.top[i].key,
+			       b.top[i].score);
+	}
+
+	warn_expired(b.expired);
+	printf("Found key: %s\n", b.top[0].key);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	check(vig_decrypt(a->str, b.top[0].key), "Decrypt");
+	trace_end(a->tb, t, "decrypt", NULL, a->str->len);
+	stats_end(a->stats, STATS_DECRYPT, a->str->len);
+
+	brute_fini(&b);
+}
+
+
+
+/* Print a key of the byte mode with the non-printable bytes escaped. */
+static void print_bytes_key(const unsigned char *key, size_t klen) {
+	size_t i;
+
+	printf("Found key: ");
+	for (i = 0; i < klen; i++) {
+		if (isprint(key[i]) && key[i] != '\\')
+			putchar(key[i]);
+		else
+			printf("\\x%02x", key[i]);
+	}
+	printf("\n");
+}
+
+
+
+/*
+ * Decode in place a key of the byte mode written like print_bytes_key prints
+ * them, with \xNN for any byte and \\ for a backslash. Return its length, the
+ * key may hold nul bytes.
+ */
+static size_t parse_bytes_key(char *key) {
+	const char *p = key;
+	char hex[3];
+	size_t len = 0;
+
+	while (*p != '\0') {
+		if (*p != '\\') {
+			key[len++] = *p++;
+		} else if (p[1] == '\\') {
+			key[len++] = '\\';
+			p += 2;
+		} else if (p[1] == 'x' && isxdigit((unsigned char)p[2]) &&
+		           isxdigit((unsigned char)p[3])) {
+			hex[0] = p[2];
+			hex[1] = p[3];
+			hex[2] = '\0';
+			key[len++] = strtoul(hex, NULL, 16);
+			p += 4;
+		} else {
+			custom_error("Invalid escape in the key, only \\xNN and "
+			             "\\\\ are allowed");
+		}
+	}
+
+	return len;
+}
+
+
+
+static void bytes_crack(const struct crack_args *a, struct io_buf *text) {
+	struct byte_cracker bc;
+	unsigned char *data = (unsigned char *)text->data;
+	double t;
+	int err;
+
+	bc_init(&bc, data, text->len, a->bop);
+	bc.estimator = a->bc_estimator;
+	bc.stats = a->stats;
+	bc.trace = a->tb;
+
+	if (a->klen != 0)
+		check(bc_set_length(&bc, a->klen), "Key length");
+
+	err = bc_crack(&bc);
+	if (err == ERR_TOOSHORT)
+		custom_error("Can't break the key length of only %lu bytes",
+		             (unsigned long)text->len);
+	check(err, "Crack");
+
+	print_bytes_key(bc.key, bc.klen);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	check(bytes_decrypt(data, text->len, bc.key, bc.klen, a->bop),
+	      "Decrypt");
+	trace_end(a->tb, t, "decrypt", NULL, text->len);
+	stats_end(a->stats, STATS_DECRYPT, text->len);
+
+	bc_fini(&bc);
+}
+
+
+
+static void bytes_action(struct io_buf *text, const char *key, size_t keylen,
+                         enum bytes_op op, enum action act) {
+	unsigned char *data = (unsigned char *)text->data;
+	const unsigned char *k = (const unsigned char *)key;
+
 	if (act == ACTION_ENCRYPT)
-		vig_encrypt(s, key);
+		check(bytes_encrypt(data, text->len, k, keylen, op),
+		      "Encrypt");
+	else if (act == ACTION_DECRYPT)
+		check(bytes_decrypt(data, text->len, k, keylen, op),
+		      "Decrypt");
+	else
+		custom_error("Dafuq? bytes_action called with an unknown action");
+}
+
+
+
+static void simple_action(struct fs_ctx *s, const struct vig_table *vt,
+                          const char *key, enum action act) {
+	if (act == ACTION_ENCRYPT && vt != NULL)
+		check(vig_encrypt_table(s, vt, key), "Encrypt");
+	else if (act == ACTION_DECRYPT && vt != NULL)
+		check(vig_decrypt_table(s, vt, key), "Decrypt");
+	else if (act == ACTION_ENCRYPT)
+		check(vig_encrypt(s, key), "Encrypt");
 	else if (act == ACTION_DECRYPT)
-		vig_decrypt(s, key);
+		check(vig_decrypt(s, key), "Decrypt");
 	else
 		custom_error("Dafuq? simple_action called with an unknown action");
 }
 
 
 
+/* Prepare a stream with the cipher of the command line. */
+static void key_stream(struct vig_stream *vs, const struct crack_args *cka,
+                       const struct charset *cs, const char *key, int sign) {
+	if (cka->table != NULL)
+		check(vig_stream_init_table(vs, cka->table, key, sign, NULL),
+		      "Key");
+	else
+		check(vig_stream_init(vs, cs, key, sign, NULL), "Key");
+}
+
+
+
+/* Prepare the cracker of a worker thread with the options of the command
+ * line. */
+static void worker_cracker(struct cracker *ck, const struct crack_args *cka) {
+	ck_init(ck, NULL);
+	ck->estimator = cka->estimator;
+	ck->beam_width = cka->beam_width;
+	if (cka->ka_minlen != 0)
+		ck->ka_minlen = cka->ka_minlen;
+}
+
+
+
+/*
+ * Crack the key on as little of the text as needed, then decrypt all of it.
+ * The text isn't filtered, the decryption skips the other characters itself.
+ */
+static void sample_crack(const struct crack_args *a, const struct charset *cs,
+                         struct io_buf *text) {
+	struct online ol;
+	struct vig_stream vs;
+	size_t used;
+	double t;
+	int err;
+
+	online_setup(&ol, a, cs);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	ol.deadline = budget_deadline(a);
+	err = online_sample(&ol, text->data, text->len, a->klen,
+	                    a->sample_rounds, &used);
+	trace_end(a->tb, t, "sample", NULL, used);
+	stats_end(a->stats, STATS_SAMPLE, used);
+
+	if (err == ERR_CHARSET)
+		custom_error("--sample needs a charset of %d characters",
+		             CS_ALPHA_LEN);
+	if (err == ERR_TOOSHORT)
+		custom_error("Can't break key length of a text with only %lu "
+		             "signficant characters",
+		             (unsigned long)online_size(&ol));
+	check(err, "Sample");
+
+	printf("Analyzed %lu bytes out of %lu\n", (unsigned long)used,
+	       (unsigned long)text->len);
+	warn_expired(ol.expired);
+	printf("Found key: %s\n", ol.key);
+
+	stats_begin(a->stats, NULL);
+	t = trace_begin(a->tb);
+	key_stream(&vs, a, cs, ol.key, VIG_DECRYPT);
+	vig_stream_apply(&vs, text->data, text->len);
+	vig_stream_fini(&vs);
+	trace_end(a->tb, t, "decrypt", NULL, text->len);
+	stats_end(a->stats, STATS_DECRYPT, text->len);
+
+	online_fini(&ol);
+}
+
+
+
+static void stream_transform(void *arg, char *buf, size_t len) {
+	vig_stream_apply(arg, buf, len);
+}
+
+
+
+static void bytes_transform(void *arg, char *buf, size_t len) {
+	bytes_stream_apply(arg, (unsigned char *)buf, len);
+}
+
+
+
 /*
- * Load a file into a buffer allocated with malloc. Must be freed by caller.
- * The filename may be "-" to read from stdin.
+ * Encrypt or decrypt the input while it's being read and write it out at the
+ * same time. Return 0 without doing anything if the output is the input file
+ * since it would be truncated before being read.
  */
-static char *read_file(const char *filename) {
-	FILE *fp = stdin;
-	ARRAY_DECL(char, buffer);
-	size_t nr;
+static int stream_action(const struct crack_args *cka,
+                         const struct charset *cs, const char *key,
+                         size_t keylen, enum action act,
+                         const char *filenamein, const char *filenameout) {
+	struct vig_stream vs;
+	struct bytes_stream bs;
+	struct pl_config cfg;
+	int infd, outfd;
+	int sign;
 	int err;
-	char nulchar = '\0';
 
-	if (strcmp(filename, "-") != 0) {
-		fp = fopen(filename, "r");
-		if (fp == NULL)
-			system_error(filename);
+	if (io_same_file(filenamein, filenameout))
+		return 0;
+
+	infd = io_open_read(filenamein);
+	if (infd == -1)
+		system_error(filenamein);
+
+	outfd = io_open_write(filenameout);
+	if (outfd == -1)
+		system_error(filenameout);
+
+	if (cka->bytes) {
+		sign = act == ACTION_ENCRYPT ? BYTES_ENCRYPT : BYTES_DECRYPT;
+		check(bytes_stream_init(&bs, (const unsigned char *)key,
+		                        keylen, cka->bop, sign, NULL), "Key");
+		pl_config_init(&cfg, bytes_transform, &bs);
+	} else {
+		sign = act == ACTION_ENCRYPT ? VIG_ENCRYPT : VIG_DECRYPT;
+		key_stream(&vs, cka, cs, key, sign);
+		pl_config_init(&cfg, stream_transform, &vs);
 	}
 
-	ARRAY_ALLOC(buffer, 8);
+	cfg.trace = cka->trace;
+	err = pl_run(&cfg, infd, outfd);
+	if (err == ERR_IO)
+		system_error("Stream");
+	check(err, "Stream");
+
+	if (cka->bytes)
+		bytes_stream_fini(&bs);
+	else
+		vig_stream_fini(&vs);
+
+	if (io_close(outfd) == -1)
+		system_error(filenameout);
+	io_close(infd);
+
+	return 1;
+}
+
+
+
+/* Everything the worker threads of the batch mode need. */
+struct batch_args {
+	enum action action;
+	const struct charset *cs;
+	const struct crack_args *cka;
+
+	/* Template for the encryption or decryption of every file. */
+	struct vig_stream vs;
+
+	/* One per worker thread. */
+	struct cracker *ck;
+};
+
 
-	do {
-		/* Grow the buffer if needed. */
-		if (buffer_size >= buffer_mem)
-			ARRAY_GROW(buffer);
 
-		nr = fread(buffer + buffer_size, 1, buffer_mem - buffer_size, fp);
-		buffer_size += nr;
-	} while (nr > 0);
+/* Result of batch_crack, the key is stored right after the struct. */
+struct batch_result {
+	char *key;
+
+	/* The time budget was exceeded. */
+	int expired;
+};
+
+
+
+static int batch_crack(struct batch_args *ba, struct cracker *ck,
+                       struct batch_item *it) {
+	struct batch_result *res;
+	struct cache cache;
+	struct fs_ctx s;
+	double t;
+	int err;
 
-	/* TODO: It sucks a bit to need a variable nulchar for this. */
-	ARRAY_APPEND(buffer, nulchar);
+	ck_reset(ck);
+	ck->trace = it->trace;
+	ck->deadline = budget_deadline(ba->cka);
 
-	if (ferror(fp))
-		system_error("fread");
+	t = trace_begin(it->trace);
+	err = fs_init(&s, it->data, it->len, ba->cs, &ck->arena);
+	trace_end(it->trace, t, "filter", NULL, it->len);
+	if (err != ERR_OK)
+		return err;
 
-	if (strcmp(filename, "-") != 0) {
-		err = fclose(fp);
-		if (err == -1)
-			system_error("fclose");
+	ck_set_text(ck, &s);
+
+	if (ba->cka->cache_dir != NULL) {
+		cache_init(&cache, ba->cka->cache_dir, s.norm, s.nlen, ba->cs);
+		ck->cache = &cache;
+	}
+
+	err = ERR_OK;
+	if (ba->cka->klen != 0)
+		err = ck_set_length(ck, ba->cka->klen);
+
+	if (err == ERR_OK)
+		err = ck_crack(ck);
+
+	if (err == ERR_OK) {
+		t = trace_begin(it->trace);
+		err = vig_decrypt(&s, ck->key);
+		trace_end(it->trace, t, "decrypt", NULL, it->len);
+	}
+
+	if (err == ERR_OK) {
+		res = malloc(sizeof(*res) + ck->klen + 1);
+		if (res == NULL) {
+			err = ERR_NOMEM;
+		} else {
+			res->key = (char *)(res + 1);
+			memcpy(res->key, ck->key, ck->klen + 1);
+			res->expired = ck->expired;
+			it->result = res;
+		}
 	}
 
-	return buffer;
+	ck->cache = NULL;
+	fs_fini(&s);
+	return err;
+}
+
+
+
+static int batch_work(void *arg, size_t thread, struct batch_item *it) {
+	struct batch_args *ba = arg;
+	struct vig_stream vs;
+
+	if (ba->action == ACTION_CRACK)
+		return batch_crack(ba, &ba->ck[thread], it);
+
+	/* Every file starts at the beginning of the key. */
+	vs = ba->vs;
+	vs.phase = 0;
+	vig_stream_apply(&vs, it->data, it->len);
+
+	return ERR_OK;
+}
+
+
+
+static void write_trace(const struct trace *trace, const char *filename) {
+	FILE *f;
+
+	f = fopen(filename, "w");
+	if (f == NULL)
+		system_error(filename);
+
+	if (trace_write(trace, f) != ERR_OK || fclose(f) != 0)
+		system_error(filename);
 }
 
 
 
 /*
- * Write some data to a file. May be "-" to write to stdout.
+ * Process every file independently, and write them into the directory
+ * outdir. Return the number of files that failed.
  */
-static void write_file(const char *filename, const char *data) {
-	FILE *fp = stdout;
+static size_t batch(const struct crack_args *cka, const struct charset *cs,
+                    const char *key, enum action act, char *const *files,
+                    size_t nfiles, const char *outdir, size_t nthreads,
+                    int use_uring) {
+	struct batch_config cfg;
+	struct batch_args ba;
+	struct batch_item *items;
+	size_t nfailed = 0;
+	size_t i;
+	int sign;
+
+	memset(&ba, 0, sizeof(ba));
+	ba.action = act;
+	ba.cs = cs;
+	ba.cka = cka;
+
+	batch_config_init(&cfg, batch_work, &ba, nthreads);
+	cfg.use_uring = use_uring;
+	cfg.trace = cka->trace;
+
+	if (act == ACTION_CRACK) {
+		ba.ck = malloc(cfg.nthreads * sizeof(*ba.ck));
+		if (ba.ck == NULL)
+			system_error("malloc");
+
+		for (i = 0; i < cfg.nthreads; i++)
+			worker_cracker(&ba.ck[i], cka);
+	} else {
+		sign = act == ACTION_ENCRYPT ? VIG_ENCRYPT : VIG_DECRYPT;
+		key_stream(&ba.vs, cka, cs, key, sign);
+	}
+
+	items = malloc(nfiles * sizeof(*items));
+	if (items == NULL)
+		system_error("malloc");
+
+	memset(items, 0, nfiles * sizeof(*items));
+
+	for (i = 0; i < nfiles; i++) {
+		const char *base = strrchr(files[i], '/');
+		char *out;
+
+		base = base != NULL ? base + 1 : files[i];
+		asprintf(&out, "%s/%s", outdir, base);
+
+		items[i].in = files[i];
+		items[i].out = out;
+	}
+
+	check(batch_run(&cfg, items, nfiles), "Batch");
+
+	for (i = 0; i < nfiles; i++) {
+		struct batch_item *it = &items[i];
+		const struct batch_result *res = it->result;
+
+		if (it->err == ERR_IO)
+			custom_warn("%s: %s", it->in,
+			            strerror(it->errno_value));
+		else if (it->err != ERR_OK)
+			custom_warn("%s: %s", it->in, err_str(it->err));
+		else if (act == ACTION_CRACK)
+			printf("%s: Found key: %s%s\n", it->in, res->key,
+			       res->expired ? " (time budget exceeded)" : "");
+
+		if (it->err != ERR_OK)
+			nfailed++;
+
+		free(it->result);
+		free((char *)it->out);
+	}
+
+	free(items);
+
+	if (act == ACTION_CRACK) {
+		for (i = 0; i < cfg.nthreads; i++) {
+			warn_cache(cka, ba.ck[i].cache_err);
+			ck_fini(&ba.ck[i]);
+		}
+		free(ba.ck);
+	} else {
+		vig_stream_fini(&ba.vs);
+	}
+
+	return nfailed;
+}
+
+
+
+/* Everything the worker threads of the record mode need. */
+struct record_args {
+	enum action action;
+	const struct charset *cs;
+	const struct crack_args *cka;
+
+	/* Template for the encryption or decryption of every record. */
+	struct vig_stream vs;
+
+	/* One per worker thread. */
+	struct cracker *ck;
+
+	/* Number of records that couldn't be cracked, with the error of one of
+	 * them, and of records whose time budget ran out. */
+	size_t nfailed;
+	int failure;
+	size_t nexpired;
+};
+
+
+
+static int record_crack(struct record_args *ra, struct cracker *ck,
+                        char *rec, size_t len, struct rec_out *out) {
+	struct fs_ctx s;
+	int err;
+
+	ck_reset(ck);
+	ck->deadline = budget_deadline(ra->cka);
+
+	err = fs_init(&s, rec, len, ra->cs, &ck->arena);
+	if (err != ERR_OK)
+		return err;
+
+	ck_set_text(ck, &s);
+
+	if (ra->cka->klen != 0)
+		err = ck_set_length(ck, ra->cka->klen);
+
+	if (err == ERR_OK)
+		err = ck_crack(ck);
+
+	if (err == ERR_OK)
+		err = vig_decrypt(&s, ck->key);
+
+	fs_fini(&s);
+
+	/* A record that can't be cracked, like a too short one, is written as
+	 * is with an empty key. Only a lack of memory stops everything. */
+	if (err == ERR_NOMEM)
+		return err;
+
+	if (err != ERR_OK) {
+		__atomic_add_fetch(&ra->nfailed, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&ra->failure, err, __ATOMIC_RELAXED);
+	} else {
+		if (ck->expired)
+			__atomic_add_fetch(&ra->nexpired, 1,
+			                   __ATOMIC_RELAXED);
+
+		err = rec_emit(out, ck->key, ck->klen);
+		if (err != ERR_OK)
+			return err;
+	}
+
+	err = rec_emit(out, "\t", 1);
+	if (err == ERR_OK)
+		err = rec_emit(out, rec, len);
+
+	return err;
+}
+
+
+
+static int record_work(void *arg, size_t thread, char *rec, size_t len,
+                       struct rec_out *out) {
+	struct record_args *ra = arg;
+	struct vig_stream vs;
+
+	if (ra->action == ACTION_CRACK)
+		return record_crack(ra, &ra->ck[thread], rec, len, out);
+
+	/* Every record starts at the beginning of the key. */
+	vs = ra->vs;
+	vs.phase = 0;
+	vig_stream_apply(&vs, rec, len);
+
+	return rec_emit(out, rec, len);
+}
+
+
+
+/* Process every record of the input independently. */
+static void records(const struct crack_args *cka, const struct charset *cs,
+                    const char *key, enum action act, char delim,
+                    const char *filenamein, const char *filenameout,
+                    size_t nthreads) {
+	struct rec_config cfg;
+	struct record_args ra;
+	int infd, outfd;
+	size_t i;
+	int sign;
+	int err;
+
+	if (io_same_file(filenamein, filenameout))
+		custom_error("--records can't write over its input");
+
+	memset(&ra, 0, sizeof(ra));
+	ra.action = act;
+	ra.cs = cs;
+	ra.cka = cka;
+
+	rec_config_init(&cfg, delim, record_work, &ra, nthreads);
+	cfg.trace = cka->trace;
+
+	if (act == ACTION_CRACK) {
+		ra.ck = malloc(cfg.nthreads * sizeof(*ra.ck));
+		if (ra.ck == NULL)
+			system_error("malloc");
+
+		for (i = 0; i < cfg.nthreads; i++)
+			worker_cracker(&ra.ck[i], cka);
+	} else {
+		sign = act == ACTION_ENCRYPT ? VIG_ENCRYPT : VIG_DECRYPT;
+		key_stream(&ra.vs, cka, cs, key, sign);
+	}
+
+	infd = io_open_read(filenamein);
+	if (infd == -1)
+		system_error(filenamein);
+
+	outfd = io_open_write(filenameout);
+	if (outfd == -1)
+		system_error(filenameout);
+
+	err = rec_run(&cfg, infd, outfd);
+	if (err == ERR_IO)
+		system_error("Records");
+	check(err, "Records");
+
+	if (io_close(outfd) == -1)
+		system_error(filenameout);
+	io_close(infd);
+
+	if (ra.nfailed != 0)
+		custom_warn("%lu records couldn't be cracked: %s",
+		            (unsigned long)ra.nfailed, err_str(ra.failure));
+
+	if (ra.nexpired != 0)
+		custom_warn("Time budget exceeded on %lu records, their key "
+		            "is the best one found in time",
+		            (unsigned long)ra.nexpired);
+
+	if (act == ACTION_CRACK) {
+		for (i = 0; i < cfg.nthreads; i++)
+			ck_fini(&ra.ck[i]);
+		free(ra.ck);
+	} else {
+		vig_stream_fini(&ra.vs);
+	}
+}
+
+
+
+/* Everything the worker threads of the server mode need. */
+struct serve_args {
+	const struct charset *cs;
+	const struct crack_args *cka;
+
+	/* One per worker thread, with the statistics of its last request. */
+	struct cracker *ck;
+	struct stats *stats;
+	char **json;
+};
+
+
+
+static int serve_crack(struct serve_args *sa, size_t thread,
+                       struct proto_msg *req, struct proto_msg *resp) {
+	struct cracker *ck = &sa->ck[thread];
+	struct stats *st = &sa->stats[thread];
+	struct cache cache;
+	struct fs_ctx s;
+	int err;
+
+	stats_begin(st, &ck->arena);
+	err = fs_init(&s, req->text, req->text_len, sa->cs, &ck->arena);
+	stats_end(st, STATS_FILTER, req->text_len);
+	if (err != ERR_OK)
+		return err;
+
+	ck_set_text(ck, &s);
+	ck->deadline = budget_deadline(sa->cka);
+
+	if (sa->cka->cache_dir != NULL) {
+		cache_init(&cache, sa->cka->cache_dir, s.norm, s.nlen, sa->cs);
+		ck->cache = &cache;
+	}
+
+	err = ERR_OK;
+	if (req->param != 0)
+		err = ck_set_length(ck, req->param);
+
+	if (err == ERR_OK)
+		err = ck_crack(ck);
+
+	if (err == ERR_OK) {
+		stats_begin(st, NULL);
+		err = vig_decrypt(&s, ck->key);
+		stats_end(st, STATS_DECRYPT, req->text_len);
+	}
+
+	/* The key stays in the arena until the next request. */
+	resp->param = ck->expired;
+	resp->key = ck->key;
+	resp->key_len = ck->klen;
+
+	ck->cache = NULL;
+	fs_fini(&s);
+	return err;
+}
+
+
+
+static int serve_cipher(struct serve_args *sa, size_t thread,
+                        struct proto_msg *req, struct proto_msg *resp) {
+	struct cracker *ck = &sa->ck[thread];
+	struct stats *st = &sa->stats[thread];
+	int encrypt = req->op == PROTO_ENCRYPT;
+	int sign = encrypt ? VIG_ENCRYPT : VIG_DECRYPT;
+	struct vig_stream vs;
+	char *key;
+	int err;
+
+	key = arena_alloc(&ck->arena, req->key_len + 1);
+	if (key == NULL)
+		return ERR_NOMEM;
+
+	memcpy(key, req->key, req->key_len);
+	key[req->key_len] = '\0';
+
+	err = vig_stream_init(&vs, sa->cs, key, sign, &ck->arena);
+	if (err != ERR_OK)
+		return err;
+
+	stats_begin(st, NULL);
+	vig_stream_apply(&vs, req->text, req->text_len);
+	stats_end(st, encrypt ? STATS_ENCRYPT : STATS_DECRYPT, req->text_len);
+	vig_stream_fini(&vs);
+
+	resp->key = req->key;
+	resp->key_len = req->key_len;
+	return ERR_OK;
+}
+
+
+
+static int serve_request(void *arg, size_t thread, struct proto_msg *req,
+                         struct proto_msg *resp) {
+	struct serve_args *sa = arg;
+	struct stats *st = &sa->stats[thread];
 	size_t len;
-	size_t nw;
 	int err;
 
+	ck_reset(&sa->ck[thread]);
+	stats_init(st);
 
-	if (strcmp(filename, "-") != 0) {
-		fp = fopen(filename, "w");
-		if (fp == NULL)
-			system_error(filename);
+	if (req->op == PROTO_CRACK)
+		err = serve_crack(sa, thread, req, resp);
+	else
+		err = serve_cipher(sa, thread, req, resp);
+
+	resp->text = req->text;
+	resp->text_len = req->text_len;
+
+	/* The statistics are only missing if there's no memory left. */
+	free(sa->json[thread]);
+	sa->json[thread] = NULL;
+	if (stats_json(st, &sa->json[thread], &len) == ERR_OK) {
+		resp->stats = sa->json[thread];
+		resp->stats_len = len;
 	}
 
-	len = strlen(data);
+	return err;
+}
 
-	nw = fwrite(data, 1, len, fp);
-	if (ferror(fp))
-		system_error("fwrite");
 
-	if (nw != len)
-		custom_error("Dafuq? Didn't write everything we should.");
 
-	if (strcmp(filename, "-") != 0) {
-		err = fclose(fp);
-		if (err == -1)
-			system_error("fclose");
+/* Answer the requests of the clients until SIGINT or SIGTERM. */
+static void serve(const struct crack_args *cka, const struct charset *cs,
+                  const char *path, size_t nthreads) {
+	struct server_config cfg;
+	struct serve_args sa;
+	size_t i;
+	int err;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.cs = cs;
+	sa.cka = cka;
+
+	server_config_init(&cfg, path, serve_request, &sa, nthreads);
+
+	sa.ck = malloc(cfg.nthreads * sizeof(*sa.ck));
+	sa.stats = malloc(cfg.nthreads * sizeof(*sa.stats));
+	sa.json = calloc(cfg.nthreads, sizeof(*sa.json));
+	if (sa.ck == NULL || sa.stats == NULL || sa.json == NULL)
+		system_error("malloc");
+
+	for (i = 0; i < cfg.nthreads; i++) {
+		worker_cracker(&sa.ck[i], cka);
+		sa.ck[i].stats = &sa.stats[i];
 	}
+
+	err = server_run(&cfg);
+	if (err == ERR_INVAL)
+		custom_error("%s: Path too long for a socket", path);
+	if (err == ERR_IO)
+		system_error(path);
+	check(err, "Server");
+
+	for (i = 0; i < cfg.nthreads; i++) {
+		warn_cache(cka, sa.ck[i].cache_err);
+		ck_fini(&sa.ck[i]);
+		free(sa.json[i]);
+	}
+
+	free(sa.ck);
+	free(sa.stats);
+	free(sa.json);
 }
 
 
@@ -268,13 +1541,38 @@ int main(int argc, char **argv) {
 	struct fs_ctx s;
 	enum action action = ACTION_CRACK;
 	char *key = NULL;
+	size_t keylen = 0;
 	const char *filenamein = "-";
 	const char *filenameout = "-";
-	char *text = NULL;
+	struct io_buf text;
+	int err;
 	struct charset cs;
 	struct crack_args cka;
-
-	cs_init(&cs);
+	int batchmode = 0;
+	int followmode = 0;
+	const char *socketpath = NULL;
+	int recordmode = 0;
+	char delim = '\n';
+	size_t nthreads = 0;
+	int use_uring = 1;
+	size_t nfailed;
+	int argidx;
+	struct stats stats;
+	const char *statsformat = NULL;
+	const char *statsfile = NULL;
+	FILE *statsout;
+	int useperf = 0;
+	struct perf_group perf;
+	struct trace trace;
+	const char *tracefile = NULL;
+	const char *estimator = NULL;
+	enum vig_cipher cipher = VIG_VIGENERE;
+	const char *alphakey = NULL;
+	struct vig_table table;
+	double t;
+	struct arena arena;
+
+	check(cs_init(&cs), "Charset");
 	memset(&cka, 0, sizeof(cka));
 
 	/* Parse the options. */
@@ -319,8 +1617,146 @@ int main(int argc, char **argv) {
 			cka.ka_show_length = 1;
 			break;
 
+		case OPT_ESTIMATOR:
+			estimator = st.argval;
+			break;
+
+		case OPT_CIPHER:
+			cipher = vig_cipher_from_name(st.argval);
+			if (cipher == VIG_CIPHER_LAST)
+				custom_error("Unknown cipher %s", st.argval);
+			break;
+
+		case OPT_ALPHABET_KEY:
+			alphakey = st.argval;
+			break;
+
+		case OPT_CRIB:
+			cka.crib = st.argval;
+			break;
+
+		case OPT_WORDLIST:
+			cka.wordlist = st.argval;
+			break;
+
+		case OPT_BRUTE_FORCE:
+			cka.brute_maxlen = BRUTE_DEFAULT_MAXLEN;
+			if (st.argval != NULL)
+				cka.brute_maxlen = atoi(st.argval);
+			if (cka.brute_maxlen == 0)
+				custom_error("Invalid key length %s",
+				             st.argval);
+			break;
+
+		case OPT_BEAM:
+			cka.beam_width = BEAM_DEFAULT_WIDTH;
+			if (st.argval != NULL)
+				cka.beam_width = atoi(st.argval);
+			if (cka.beam_width == 0)
+				custom_error("Invalid beam width %s",
+				             st.argval);
+			break;
+
+		case OPT_FOLLOW:
+			followmode = 1;
+			break;
+
+		case OPT_SAMPLE:
+			cka.sample_rounds = ONLINE_DEFAULT_ROUNDS;
+			if (st.argval != NULL)
+				cka.sample_rounds = atoi(st.argval);
+			if (cka.sample_rounds == 0)
+				custom_error("Invalid number of checks %s",
+				             st.argval);
+			break;
+
+		case OPT_TIME_BUDGET:
+			cka.budget = atof(st.argval);
+			if (cka.budget <= 0)
+				custom_error("Invalid time budget %s",
+				             st.argval);
+			break;
+
+		case OPT_CHECKPOINT:
+			cka.checkpoint = st.argval;
+			break;
+
+		case OPT_CHECKPOINT_INTERVAL:
+			cka.ckpt_interval = atof(st.argval);
+			if (cka.ckpt_interval <= 0)
+				custom_error("Invalid checkpoint interval %s",
+				             st.argval);
+			break;
+
+		case OPT_RESUME:
+			cka.resume = 1;
+			break;
+
+		case OPT_CACHE:
+			cka.cache_dir = st.argval;
+			break;
+
+		case OPT_SERVE:
+			socketpath = st.argval;
+			break;
+
+		case OPT_RECORDS:
+			recordmode = 1;
+			if (st.argval == NULL || strcmp(st.argval, "line") == 0)
+				delim = '\n';
+			else if (strcmp(st.argval, "nul") == 0)
+				delim = '\0';
+			else
+				custom_error("Unknown record delimiter %s",
+				             st.argval);
+			break;
+
+		case OPT_TOP:
+			cka.ntop = atoi(st.argval);
+			if (cka.ntop == 0)
+				custom_error("Invalid number of keys %s",
+				             st.argval);
+			break;
+
+		case OPT_BYTES:
+			cka.bytes = 1;
+			if (st.argval != NULL)
+				cka.bop = bytes_op_from_name(st.argval);
+			if (cka.bop == BYTES_OP_LAST)
+				custom_error("Unknown byte operation %s",
+				             st.argval);
+			break;
+
+		case OPT_STATS:
+			statsformat = st.argval != NULL ? st.argval : "json";
+			break;
+
+		case OPT_STATS_FILE:
+			statsfile = st.argval;
+			break;
+
+		case OPT_PERF_COUNTERS:
+			useperf = 1;
+			break;
+
+		case OPT_TRACE:
+			tracefile = st.argval;
+			break;
+
 		case 'c':
-			cs_add(&cs, st.argval);
+			check(cs_add(&cs, st.argval), "--charset");
+			break;
+
+		case OPT_BATCH:
+			batchmode = 1;
+			break;
+
+		case OPT_THREADS:
+			nthreads = atoi(st.argval);
+			break;
+
+		case OPT_NO_URING:
+			use_uring = 0;
 			break;
 
 		default:
@@ -331,11 +1767,21 @@ int main(int argc, char **argv) {
 
 
 	/* Common command line mistake. */
-	if (st.argidx != argc)
+	if (!batchmode && st.argidx != argc)
 		custom_error("Useless argument %s", argv[st.argidx]);
 
+	if (batchmode && st.argidx == argc)
+		custom_error("--batch needs the files to process as arguments");
+
+	argidx = st.argidx;
 	goh_fini(&st);
 
+	/* The keys of the byte mode may hold any byte, given as escapes. */
+	if (key != NULL && cka.bytes)
+		keylen = parse_bytes_key(key);
+	else if (key != NULL)
+		keylen = strlen(key);
+
 	/* Check for some invalid options combinations. */
 	if (action != ACTION_CRACK && key == NULL)
 		custom_error("Encryption and decryption take a --key");
@@ -346,7 +1792,7 @@ int main(int argc, char **argv) {
 	if (cka.klen > 0 && key != NULL)
 		custom_warn("Unnecessary key length option with an actual key");
 
-	if (cka.klen > 0 && key != NULL && cka.klen != strlen(key))
+	if (cka.klen > 0 && key != NULL && cka.klen != keylen)
 		custom_error("Key length option doesn't match "
 		             "the length of the key");
 
@@ -374,29 +1820,436 @@ int main(int argc, char **argv) {
 		custom_warn("Option --show-kasiski-length ignored when a key "
 		            "length is given");
 
+	if (estimator != NULL && cka.bytes) {
+		cka.bc_estimator = bc_estimator_from_name(estimator);
+		if (cka.bc_estimator == BC_EST_LAST)
+			custom_error("Unknown estimator %s", estimator);
+	} else if (estimator != NULL) {
+		cka.estimator = ck_estimator_from_name(estimator);
+		if (cka.estimator == CK_EST_LAST)
+			custom_error("Unknown estimator %s", estimator);
+	}
+
+	if (cka.bytes && (cka.ka_minlen > 0 || cka.ka_show_table ||
+	                  cka.ka_show_length))
+		custom_error("Kasiski options can't be used with --bytes");
+
+	if (cka.bytes && cs.chars_size > 0)
+		custom_error("--charset can't be used with --bytes");
+
+	if (cipher != VIG_VIGENERE && action == ACTION_CRACK)
+		custom_error("--cipher %s can only be used to encrypt or "
+		             "decrypt", vig_cipher_name(cipher));
+
+	if (cipher == VIG_KEYED && alphakey == NULL)
+		custom_error("--cipher keyed needs an --alphabet-key");
+
+	if (cipher != VIG_KEYED && alphakey != NULL)
+		custom_error("--alphabet-key can only be used with --cipher "
+		             "keyed");
+
+	if (cka.bytes && cipher != VIG_VIGENERE)
+		custom_error("--cipher can't be used with --bytes");
+
+	if (cka.crib != NULL && action != ACTION_CRACK)
+		custom_error("--crib can only be used in cracking mode");
+
+	if (cka.crib != NULL && (estimator != NULL || cka.ka_minlen > 0 ||
+	                         cka.ka_show_table || cka.ka_show_length))
+		custom_error("--crib replaces the key length estimators, their "
+		             "options can't be used with it");
+
+	if (cka.crib != NULL && (cka.bytes || batchmode))
+		custom_error("--crib can't be used with --bytes or --batch");
+
+	if (cka.wordlist != NULL && action != ACTION_CRACK)
+		custom_error("--wordlist can only be used in cracking mode");
+
+	if (cka.wordlist != NULL && (estimator != NULL || cka.ka_minlen > 0 ||
+	                             cka.ka_show_table || cka.ka_show_length))
+		custom_error("--wordlist replaces the key length estimators, "
+		             "their options can't be used with it");
+
+	if (cka.wordlist != NULL && (cka.bytes || batchmode ||
+	                             cka.crib != NULL))
+		custom_error("--wordlist can't be used with --bytes, --batch "
+		             "or --crib");
+
+	if (cka.brute_maxlen != 0 && action != ACTION_CRACK)
+		custom_error("--brute-force can only be used in cracking mode");
+
+	if (cka.brute_maxlen != 0 && (estimator != NULL ||
+	                              cka.ka_minlen > 0 ||
+	                              cka.ka_show_table ||
+	                              cka.ka_show_length))
+		custom_error("--brute-force replaces the key length "
+		             "estimators, their options can't be used with it");
+
+	if (cka.brute_maxlen != 0 && (cka.bytes || batchmode ||
+	                              cka.crib != NULL ||
+	                              cka.wordlist != NULL))
+		custom_error("--brute-force can't be used with --bytes, "
+		             "--batch, --crib or --wordlist");
+
+	if (cka.beam_width != 0 && action != ACTION_CRACK)
+		custom_error("--beam can only be used in cracking mode");
+
+	if (cka.beam_width != 0 && (cka.bytes || cka.crib != NULL ||
+	                            cka.wordlist != NULL ||
+	                            cka.brute_maxlen != 0))
+		custom_error("--beam can't be used with --bytes, --crib, "
+		             "--wordlist or --brute-force");
+
+	if (cka.ntop != 0 && cka.brute_maxlen == 0 && cka.beam_width == 0)
+		custom_error("--top needs --brute-force or --beam");
+
+	if (cka.ntop != 0 && batchmode)
+		custom_error("--top can't be used with --batch");
+
+	if (cka.bytes && batchmode)
+		custom_error("--bytes can't be used with --batch");
+
+	if (followmode && action != ACTION_CRACK)
+		custom_error("--follow can only be used in cracking mode");
+
+	if (followmode && (cka.bytes || batchmode || cka.crib != NULL ||
+	                   cka.wordlist != NULL || cka.brute_maxlen != 0 ||
+	                   cka.beam_width != 0))
+		custom_error("--follow can't be used with --bytes, --batch, "
+		             "--crib, --wordlist, --brute-force or --beam");
+
+	if (followmode && (cka.ka_show_table || cka.ka_show_length))
+		custom_error("--show-kasiski-* options can't be used with "
+		             "--follow");
+
+	if (followmode && strcmp(filenameout, "-") != 0)
+		custom_error("--follow doesn't write any --output");
+
+	if (cka.sample_rounds != 0 && action != ACTION_CRACK)
+		custom_error("--sample can only be used in cracking mode");
+
+	if (cka.sample_rounds != 0 && (cka.bytes || batchmode || followmode ||
+	                               cka.crib != NULL ||
+	                               cka.wordlist != NULL ||
+	                               cka.brute_maxlen != 0 ||
+	                               cka.beam_width != 0))
+		custom_error("--sample can't be used with --bytes, --batch, "
+		             "--follow, --crib, --wordlist, --brute-force or "
+		             "--beam");
+
+	if (cka.sample_rounds != 0 && (cka.ka_show_table ||
+	                               cka.ka_show_length))
+		custom_error("--show-kasiski-* options can't be used with "
+		             "--sample");
+
+	if (cka.budget > 0 && action != ACTION_CRACK)
+		custom_error("--time-budget can only be used in cracking mode");
+
+	if (cka.budget > 0 && (cka.bytes || cka.crib != NULL || followmode))
+		custom_error("--time-budget can't be used with --bytes, --crib "
+		             "or --follow");
+
+	if (cka.checkpoint != NULL && action != ACTION_CRACK)
+		custom_error("--checkpoint can only be used in cracking mode");
+
+	if (cka.checkpoint != NULL && (cka.bytes || batchmode || followmode ||
+	                               cka.sample_rounds != 0 ||
+	                               cka.crib != NULL))
+		custom_error("--checkpoint can't be used with --bytes, --batch, "
+		             "--follow, --sample or --crib");
+
+	if (cka.checkpoint != NULL && cka.wordlist == NULL &&
+	    cka.brute_maxlen == 0 && (cka.estimator != CK_EST_KASISKI ||
+	                              cka.klen != 0))
+		custom_error("--checkpoint only saves the Kasiski analysis, "
+		             "--wordlist or --brute-force");
+
+	if (cka.cache_dir != NULL && action != ACTION_CRACK)
+		custom_error("--cache can only be used in cracking mode");
+
+	if (cka.cache_dir != NULL && (cka.bytes || followmode ||
+	                              cka.sample_rounds != 0 ||
+	                              cka.crib != NULL ||
+	                              cka.wordlist != NULL ||
+	                              cka.brute_maxlen != 0))
+		custom_error("--cache can't be used with --bytes, --follow, "
+		             "--sample, --crib, --wordlist or --brute-force");
+
+	if (socketpath != NULL && (action != ACTION_CRACK || key != NULL ||
+	                           cka.klen != 0))
+		custom_error("The operation, the key and its length come with "
+		             "the requests to --serve");
+
+	if (socketpath != NULL && (strcmp(filenamein, "-") != 0 ||
+	                           strcmp(filenameout, "-") != 0))
+		custom_error("The texts come with the requests to --serve, "
+		             "there is no --input or --output");
+
+	if (socketpath != NULL && (cka.bytes || batchmode || followmode ||
+	                           cka.sample_rounds != 0 ||
+	                           cka.crib != NULL || cka.wordlist != NULL ||
+	                           cka.brute_maxlen != 0 ||
+	                           cka.checkpoint != NULL ||
+	                           cipher != VIG_VIGENERE))
+		custom_error("--serve can't be used with --bytes, --batch, "
+		             "--follow, --sample, --crib, --wordlist, "
+		             "--brute-force, --checkpoint or --cipher");
+
+	if (socketpath != NULL && (cka.ka_show_table || cka.ka_show_length ||
+	                           cka.ntop != 0))
+		custom_error("--show-kasiski-* and --top can't be used with "
+		             "--serve");
+
+	if (socketpath != NULL && (statsformat != NULL || useperf ||
+	                           tracefile != NULL))
+		custom_error("--serve sends the statistics of every request "
+		             "with its response, --stats, --perf-counters and "
+		             "--trace can't be used with it");
+
+	if (recordmode && (cka.bytes || batchmode || followmode ||
+	                   socketpath != NULL || cka.sample_rounds != 0 ||
+	                   cka.crib != NULL || cka.wordlist != NULL ||
+	                   cka.brute_maxlen != 0 || cka.checkpoint != NULL ||
+	                   cka.cache_dir != NULL))
+		custom_error("--records can't be used with --bytes, --batch, "
+		             "--follow, --serve, --sample, --crib, --wordlist, "
+		             "--brute-force, --checkpoint or --cache");
+
+	if (recordmode && (cka.ka_show_table || cka.ka_show_length ||
+	                   cka.ntop != 0))
+		custom_error("--show-kasiski-* and --top can't be used with "
+		             "--records");
+
+	if (recordmode && statsformat != NULL)
+		custom_error("--stats can't be used with --records");
+
+	if ((cka.resume || cka.ckpt_interval > 0) && cka.checkpoint == NULL)
+		custom_error("--resume and --checkpoint-interval need "
+		             "--checkpoint");
+
+	if (cka.ckpt_interval <= 0)
+		cka.ckpt_interval = CKPT_DEFAULT_INTERVAL;
+
+	if ((cka.ka_minlen > 0 || cka.ka_show_table || cka.ka_show_length) &&
+	    cka.estimator != CK_EST_KASISKI)
+		custom_error("Kasiski options can't be used with --estimator "
+		             "%s", ck_estimator_name(cka.estimator));
+
+	if (batchmode && strcmp(filenamein, "-") != 0)
+		custom_error("--input can't be used with --batch");
+
+	if (batchmode && strcmp(filenameout, "-") == 0)
+		custom_error("--batch needs an --output directory");
+
+	if (batchmode && (cka.ka_show_table || cka.ka_show_length))
+		custom_error("--show-kasiski-* options can't be used with "
+		             "--batch");
+
+	if (useperf && statsformat == NULL)
+		statsformat = "json";
+
+	if (statsformat != NULL && strcmp(statsformat, "json") != 0)
+		custom_error("Unknown statistics format %s", statsformat);
+
+	if (statsfile != NULL && statsformat == NULL)
+		custom_error("--stats-file needs --stats");
+
+	if (batchmode && statsformat != NULL)
+		custom_error("--stats can't be used with --batch");
+
+	if (followmode && statsformat != NULL)
+		custom_error("--stats can't be used with --follow");
+
+	if (!batchmode && !recordmode && socketpath == NULL &&
+	    cka.wordlist == NULL && cka.brute_maxlen == 0 && nthreads != 0)
+		custom_warn("Option --threads is only useful with --batch, "
+		            "--records, --serve, --wordlist or --brute-force");
+
+	if (!batchmode && !use_uring)
+		custom_warn("Option --no-uring is only useful with --batch");
+
+	cka.nthreads = nthreads;
+
 	/* Default charset. */
 	if (cs.chars_size == 0) {
-		cs_add(&cs, CHARSET_UPPER);
-		cs_add(&cs, CHARSET_LOWER);
+		check(cs_add(&cs, CHARSET_UPPER), "Charset");
+		check(cs_add(&cs, CHARSET_LOWER), "Charset");
+	}
+
+	if (cipher != VIG_VIGENERE) {
+		check(vig_table_init(&table, &cs, cipher, alphakey, NULL),
+		      "Cipher");
+		cka.table = &table;
+	}
+
+
+	trace_init(&trace);
+	if (tracefile != NULL) {
+		cka.trace = &trace;
+		cka.tb = trace_thread(&trace, "main");
 	}
 
 
 	/* Start to do the job. */
-	text = read_file(filenamein);
-	fs_init(&s, text, &cs);
-	cka.str = &s;
+	if (batchmode) {
+		nfailed = batch(&cka, &cs, key, action, argv + argidx,
+		                argc - argidx, filenameout, nthreads,
+		                use_uring);
+		if (tracefile != NULL)
+			write_trace(&trace, tracefile);
+		trace_fini(&trace);
+		if (cka.table != NULL)
+			vig_table_fini(&table);
+		cs_fini(&cs);
+		return nfailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
-	if (action == ACTION_CRACK)
-		crack(&cka);
-	else
-		simple_action(&s, key, action);
+	if (recordmode) {
+		records(&cka, &cs, key, action, delim, filenamein,
+		        filenameout, nthreads);
+		if (tracefile != NULL)
+			write_trace(&trace, tracefile);
+		trace_fini(&trace);
+		if (cka.table != NULL)
+			vig_table_fini(&table);
+		cs_fini(&cs);
+		return EXIT_SUCCESS;
+	}
 
-	write_file(filenameout, text);
+	if (socketpath != NULL) {
+		serve(&cka, &cs, socketpath, nthreads);
+		trace_fini(&trace);
+		cs_fini(&cs);
+		return EXIT_SUCCESS;
+	}
 
-	fs_fini(&s);
-	free(text);
+	if (followmode) {
+		follow(&cka, &cs, filenamein);
+		if (tracefile != NULL)
+			write_trace(&trace, tracefile);
+		trace_fini(&trace);
+		cs_fini(&cs);
+		return EXIT_SUCCESS;
+	}
+
+	stats_init(&stats);
+	if (statsformat != NULL)
+		cka.stats = &stats;
+
+	if (useperf && perf_open(&perf) == ERR_OK)
+		stats.perf = &perf;
+	else if (useperf)
+		custom_warn("Hardware counters unavailable: %s",
+		            strerror(errno));
+
+	/* Streaming would mix all the stages together. */
+	if (action != ACTION_CRACK && cka.stats == NULL &&
+	    stream_action(&cka, &cs, key, keylen, action, filenamein,
+	                  filenameout)) {
+		if (tracefile != NULL)
+			write_trace(&trace, tracefile);
+		trace_fini(&trace);
+		if (cka.table != NULL)
+			vig_table_fini(&table);
+		cs_fini(&cs);
+		return EXIT_SUCCESS;
+	}
+
+	stats_begin(cka.stats, NULL);
+	t = trace_begin(cka.tb);
+	err = io_read(&text, filenamein);
+	if (err == ERR_IO)
+		system_error(filenamein);
+	check(err, filenamein);
+	trace_end(cka.tb, t, "read", NULL, text.len);
+	stats_end(cka.stats, STATS_READ, text.len);
+
+	arena_init(&arena, 0);
+	if (cka.bytes && action == ACTION_CRACK) {
+		bytes_crack(&cka, &text);
+	} else if (cka.bytes) {
+		stats_begin(cka.stats, NULL);
+		t = trace_begin(cka.tb);
+		bytes_action(&text, key, keylen, cka.bop, action);
+		trace_end(cka.tb, t, action == ACTION_ENCRYPT ? "encrypt" :
+		          "decrypt", NULL, text.len);
+		stats_end(cka.stats, action == ACTION_ENCRYPT ? STATS_ENCRYPT :
+		          STATS_DECRYPT, text.len);
+	} else if (action == ACTION_CRACK && cka.sample_rounds != 0) {
+		sample_crack(&cka, &cs, &text);
+	} else {
+		stats_begin(cka.stats, &arena);
+		t = trace_begin(cka.tb);
+		check(fs_init(&s, text.data, text.len, &cs, &arena), "Filter");
+		trace_end(cka.tb, t, "filter", NULL, text.len);
+		stats_end(cka.stats, STATS_FILTER, text.len);
+		cka.str = &s;
+
+		if (action == ACTION_CRACK && cka.crib != NULL) {
+			crib_crack(&cka);
+		} else if (action == ACTION_CRACK && cka.brute_maxlen != 0) {
+			exhaustive_crack(&cka);
+		} else if (action == ACTION_CRACK && cka.wordlist != NULL) {
+			wordlist_crack(&cka);
+		} else if (action == ACTION_CRACK) {
+			crack(&cka);
+		} else {
+			stats_begin(cka.stats, NULL);
+			t = trace_begin(cka.tb);
+			simple_action(&s, cka.table, key, action);
+			trace_end(cka.tb, t, action == ACTION_ENCRYPT ?
+			          "encrypt" : "decrypt", NULL, text.len);
+			stats_end(cka.stats, action == ACTION_ENCRYPT ?
+			          STATS_ENCRYPT : STATS_DECRYPT, text.len);
+		}
+	}
+
+	/* io_write doesn't go through stdio, keep the messages first. */
+	fflush(stdout);
+
+	/* The input file is about to be truncated. */
+	if (io_same_file(filenamein, filenameout))
+		check(io_detach(&text), filenamein);
+
+	stats_begin(cka.stats, NULL);
+	t = trace_begin(cka.tb);
+	err = io_write(filenameout, text.data, text.len);
+	if (err == ERR_IO)
+		system_error(filenameout);
+	check(err, filenameout);
+	trace_end(cka.tb, t, "write", NULL, text.len);
+	stats_end(cka.stats, STATS_WRITE, text.len);
+
+	if (cka.str != NULL)
+		fs_fini(&s);
+	arena_fini(&arena);
+	io_release(&text);
+	if (cka.table != NULL)
+		vig_table_fini(&table);
 	cs_fini(&cs);
 
+	if (cka.stats != NULL) {
+		statsout = stderr;
+		if (statsfile != NULL && strcmp(statsfile, "-") != 0) {
+			statsout = fopen(statsfile, "w");
+			if (statsout == NULL)
+				system_error(statsfile);
+		}
+
+		if (stats_write_json(cka.stats, statsout) != ERR_OK)
+			system_error(statsfile != NULL ? statsfile : "stderr");
+
+		if (statsout != stderr && fclose(statsout) != 0)
+			system_error(statsfile);
+	}
+
+	if (stats.perf != NULL)
+		perf_close(stats.perf);
+
+	if (tracefile != NULL)
+		write_trace(&trace, tracefile);
+	trace_fini(&trace);
+
 
 	return EXIT_SUCCESS;
 }
@@ -1,73 +1,401 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "misc.h"
+#include "error.h"
 #include "charset.h"
 #include "filtered_string.h"
+#include "arena.h"
 #include "vigenere.h"
 
 
 
+static const char *const cipher_names[VIG_CIPHER_LAST] = {
+	"vigenere",
+	"beaufort",
+	"variant",
+	"keyed"
+};
 
-static char shift_char(struct fs_ctx *str, char c, int s) {
-	size_t sidx, pos;
-	const struct charset *cs; /* shorthand */
 
-	cs = str->charset;
 
-	if (!cs_find_char(cs, c, &sidx, &pos))
-		return -1;
+/* Apply the stream vs, already initialized, to the whole text. */
+static int vigenere_compute(struct fs_ctx *str, struct vig_stream *vs) {
+	char *ntext;
+	int err;
+
+	/* Duplicate str->norm so that the struct str isn't transiently
+	 * inconsistent. */
+	ntext = arena_alloc(str->arena, str->nlen);
+	if (ntext == NULL && str->nlen > 0) {
+		vig_stream_fini(vs);
+		return ERR_NOMEM;
+	}
+
+	memcpy(ntext, str->norm, str->nlen);
+	vig_stream_apply(vs, ntext, str->nlen);
+
+	err = fs_replace(str, ntext, str->nlen);
+	arena_free(str->arena, ntext);
+	vig_stream_fini(vs);
+
+	return err;
+}
+
 
-	/* This double trick allow to ensure that s is always positive and less
-	 * than cs->length. Even if s greatly negative. */
-	s %= (int)cs->length;
-	s = (s + cs->length) % cs->length;
 
-	pos = (pos + s) % cs->length;
+const char *vig_cipher_name(enum vig_cipher cipher) {
+	if (cipher >= VIG_CIPHER_LAST)
+		return NULL;
 
-	return cs->chars[sidx][pos];
+	return cipher_names[cipher];
 }
 
 
 
-static void vigenere_compute(struct fs_ctx *str, const char *key, int sign) {
-	struct fs_ctx fskey;
+enum vig_cipher vig_cipher_from_name(const char *name) {
+	size_t i;
+
+	for (i = 0; i < VIG_CIPHER_LAST; i++) {
+		if (strcmp(cipher_names[i], name) == 0)
+			return i;
+	}
+
+	return VIG_CIPHER_LAST;
+}
+
+
+
+/*
+ * Build the mixed alphabet of the keyword alphakey: its characters without the
+ * duplicates, then the rest of the charset in order. alpha[i] is the position
+ * in the charset of the i-th character of the mixed alphabet and inv is the
+ * inverse permutation.
+ */
+static void keyed_alphabet(const struct charset *cs, const char *alphakey,
+                           unsigned char *alpha, unsigned char *inv) {
+	char seen[256];
+	size_t i, n;
+	int o;
+
+	memset(seen, 0, sizeof(seen));
+	n = 0;
+
+	for (i = 0; alphakey[i] != '\0'; i++) {
+		o = cs_ord(cs, alphakey[i]);
+		if (o == -1 || seen[o])
+			continue;
+
+		seen[o] = 1;
+		alpha[n++] = o;
+	}
+
+	for (i = 0; i < cs->length; i++) {
+		if (!seen[i])
+			alpha[n++] = i;
+	}
+
+	for (i = 0; i < cs->length; i++)
+		inv[alpha[i]] = i;
+}
+
+
+
+int vig_table_init(struct vig_table *vt, const struct charset *cs,
+                   enum vig_cipher cipher, const char *alphakey,
+                   struct arena *arena) {
+	unsigned char *alpha = NULL, *inv = NULL;
+	size_t n = cs->length;
+	size_t k, p, c;
+
+	memset(vt, 0, sizeof(*vt));
+	vt->charset = cs;
+	vt->cipher = cipher;
+	vt->length = n;
+	vt->arena = arena;
+
+	if (cipher >= VIG_CIPHER_LAST || n == 0 ||
+	    (cipher == VIG_KEYED) != (alphakey != NULL))
+		return ERR_INVAL;
+
+	vt->enc = arena_alloc(arena, 2 * n * n);
+	if (vt->enc == NULL)
+		return ERR_NOMEM;
+
+	vt->dec = vt->enc + n * n;
+
+	if (cipher == VIG_KEYED) {
+		alpha = arena_alloc(arena, 2 * n);
+		if (alpha == NULL) {
+			vig_table_fini(vt);
+			return ERR_NOMEM;
+		}
+
+		inv = alpha + n;
+		keyed_alphabet(cs, alphakey, alpha, inv);
+	}
+
+	for (k = 0; k < n; k++) {
+		for (p = 0; p < n; p++) {
+			switch (cipher) {
+			case VIG_BEAUFORT:
+				c = (k + n - p) % n;
+				break;
+
+			case VIG_VARIANT:
+				c = (p + n - k) % n;
+				break;
+
+			case VIG_KEYED:
+				c = alpha[(inv[p] + inv[k]) % n];
+				break;
+
+			default:
+				c = (p + k) % n;
+				break;
+			}
+
+			vt->enc[k * n + p] = c;
+			vt->dec[k * n + c] = p;
+		}
+	}
+
+	arena_free(arena, alpha);
+	return ERR_OK;
+}
+
+
+
+void vig_table_fini(struct vig_table *vt) {
+	arena_free(vt->arena, vt->enc);
+	memset(vt, 0, sizeof(*vt));
+}
+
+
+
+int vig_stream_init(struct vig_stream *vs, const struct charset *cs,
+                    const char *key, int sign, struct arena *arena) {
 	size_t klen, i;
-	char *ntext;
+	int o;
 
-	/* I know filtered_string won't modify key. */
-	fs_init(&fskey, (char *)key, str->charset);
-	key = fskey.norm;
-	klen = strlen(key);
+	memset(vs, 0, sizeof(*vs));
+	vs->charset = cs;
+	vs->arena = arena;
 
-	/* Duplicate str->norm so that the struct str isn't transiently
-	 * inconsistent. */
-	ntext = strdup(str->norm);
+	klen = 0;
+	for (i = 0; key[i] != '\0'; i++)
+		klen += cs_belong(cs, key[i]);
+
+	if (klen == 0)
+		return ERR_INVAL;
 
-	i = 0;
-	while (ntext[i] != '\0') {
-		int shift = cs_ord(str->charset, key[i % klen]);
+	vs->shift = arena_alloc(arena, klen * sizeof(*vs->shift));
+	if (vs->shift == NULL)
+		return ERR_NOMEM;
 
+	vs->klen = 0;
+	for (i = 0; key[i] != '\0'; i++) {
+		o = cs_ord(cs, key[i]);
+		if (o == -1)
+			continue;
+
+		/* Store a positive shift to have nothing to check later. */
 		if (sign < 0)
-			shift = -shift;
+			o = (cs->length - o) % cs->length;
+
+		vs->shift[vs->klen++] = o;
+	}
+
+	return ERR_OK;
+}
+
+
 
-		ntext[i] = shift_char(str, ntext[i], shift);
-		i++;
+int vig_stream_init_table(struct vig_stream *vs, const struct vig_table *vt,
+                          const char *key, int sign, struct arena *arena) {
+	const struct charset *cs = vt->charset;
+	const unsigned char *tab;
+	size_t klen, i;
+	int o;
+
+	memset(vs, 0, sizeof(*vs));
+	vs->charset = cs;
+	vs->arena = arena;
+
+	klen = 0;
+	for (i = 0; key[i] != '\0'; i++)
+		klen += cs_belong(cs, key[i]);
+
+	if (klen == 0)
+		return ERR_INVAL;
+
+	vs->rows = arena_alloc(arena, klen * sizeof(*vs->rows));
+	if (vs->rows == NULL)
+		return ERR_NOMEM;
+
+	tab = sign < 0 ? vt->dec : vt->enc;
+
+	vs->klen = 0;
+	for (i = 0; key[i] != '\0'; i++) {
+		o = cs_ord(cs, key[i]);
+		if (o != -1)
+			vs->rows[vs->klen++] = tab + o * vt->length;
 	}
 
-	fs_replace(str, ntext);
-	free(ntext);
-	fs_fini(&fskey);
+	return ERR_OK;
 }
 
 
 
-void vig_encrypt(struct fs_ctx *str, const char *key) {
-	vigenere_compute(str, key, 1);
+void vig_stream_fini(struct vig_stream *vs) {
+	arena_free(vs->arena, vs->shift);
+	arena_free(vs->arena, vs->rows);
+	memset(vs, 0, sizeof(*vs));
 }
 
 
 
-void vig_decrypt(struct fs_ctx *str, const char *key) {
-	vigenere_compute(str, key, -1);
+/*
+ * Shift the A-Z and a-z ranges arithmetically. The case is kept since only the
+ * offset within the range of the character changes.
+ */
+static size_t apply_alpha(const struct vig_stream *vs, char *buf, size_t len,
+                          size_t phase) {
+	const struct charset *cs = vs->charset;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		unsigned o = CS_ALPHA_ORD(cs, buf[i]);
+		char base;
+
+		if (o >= CS_ALPHA_LEN)
+			continue;
+
+		base = buf[i] - o;
+		o += vs->shift[phase];
+		if (o >= CS_ALPHA_LEN)
+			o -= CS_ALPHA_LEN;
+		buf[i] = base + o;
+
+		if (++phase == vs->klen)
+			phase = 0;
+	}
+
+	return phase;
+}
+
+
+
+/* Shift any charset through its lookup tables. */
+static size_t apply_table(const struct vig_stream *vs, char *buf, size_t len,
+                          size_t phase) {
+	const struct charset *cs = vs->charset;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = buf[i];
+		const char *row = cs->row[c];
+		size_t pos;
+
+		if (row == NULL)
+			continue;
+
+		pos = CS_TABLE_ORD(cs, c) + vs->shift[phase];
+		if (pos >= cs->length)
+			pos -= cs->length;
+		buf[i] = row[pos];
+
+		if (++phase == vs->klen)
+			phase = 0;
+	}
+
+	return phase;
+}
+
+
+
+/* Substitute through the row of each key character. */
+static size_t apply_rows(const struct vig_stream *vs, char *buf, size_t len,
+                         size_t phase) {
+	const struct charset *cs = vs->charset;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char c = buf[i];
+		const char *row = cs->row[c];
+
+		if (row == NULL)
+			continue;
+
+		buf[i] = row[vs->rows[phase][CS_TABLE_ORD(cs, c)]];
+
+		if (++phase == vs->klen)
+			phase = 0;
+	}
+
+	return phase;
+}
+
+
+
+void vig_stream_apply(struct vig_stream *vs, char *buf, size_t len) {
+	if (vs->rows != NULL)
+		vs->phase = apply_rows(vs, buf, len, vs->phase);
+	else if (vs->charset->alpha)
+		vs->phase = apply_alpha(vs, buf, len, vs->phase);
+	else
+		vs->phase = apply_table(vs, buf, len, vs->phase);
+}
+
+
+
+int vig_encrypt(struct fs_ctx *str, const char *key) {
+	struct vig_stream vs;
+	int err;
+
+	err = vig_stream_init(&vs, str->charset, key, VIG_ENCRYPT, str->arena);
+	if (err != ERR_OK)
+		return err;
+
+	return vigenere_compute(str, &vs);
+}
+
+
+
+int vig_decrypt(struct fs_ctx *str, const char *key) {
+	struct vig_stream vs;
+	int err;
+
+	err = vig_stream_init(&vs, str->charset, key, VIG_DECRYPT, str->arena);
+	if (err != ERR_OK)
+		return err;
+
+	return vigenere_compute(str, &vs);
+}
+
+
+
+int vig_encrypt_table(struct fs_ctx *str, const struct vig_table *vt,
+                      const char *key) {
+	struct vig_stream vs;
+	int err;
+
+	err = vig_stream_init_table(&vs, vt, key, VIG_ENCRYPT, str->arena);
+	if (err != ERR_OK)
+		return err;
+
+	return vigenere_compute(str, &vs);
+}
+
+
+
+int vig_decrypt_table(struct fs_ctx *str, const struct vig_table *vt,
+                      const char *key) {
+	struct vig_stream vs;
+	int err;
+
+	err = vig_stream_init_table(&vs, vt, key, VIG_DECRYPT, str->arena);
+	if (err != ERR_OK)
+		return err;
+
+	return vigenere_compute(str, &vs);
 }
@@ -10,6 +10,10 @@
  * For instance, two charsets "ABCDEFGHIJKLMNOPQRSTUVWXYZ" and
  * "abcdefghijklmnopqrstuvwxyz" for a key "AbC" encode "Hello" into "Igomq".
  * A character that do not belong to a charset is not modified.
+ *
+ * The Beaufort, variant Beaufort and keyed-alphabet variants go through a
+ * struct vig_table that precompute, for every key character, the row of
+ * substitutions to apply.
  */
 
 
@@ -17,16 +21,128 @@
 
 #include "charset.h"
 #include "filtered_string.h"
+#include "arena.h"
 
 
 /*
  * Encrypt the text str using the key key.
+ * Return ERR_INVAL if the key has no character from the charset.
  */
-void vig_encrypt(struct fs_ctx *str, const char *key);
+int vig_encrypt(struct fs_ctx *str, const char *key);
 
 /*
- * Encrypt the text str using the key key.
+ * Decrypt the text str using the key key.
+ * Return ERR_INVAL if the key has no character from the charset.
+ */
+int vig_decrypt(struct fs_ctx *str, const char *key);
+
+
+
+/*
+ * The polyalphabetic ciphers supported by struct vig_table. With p, k and c
+ * the positions of the plaintext, key and ciphertext characters:
+ * - VIG_VIGENERE: c = p + k
+ * - VIG_BEAUFORT: c = k - p
+ * - VIG_VARIANT: c = p - k (variant Beaufort)
+ * - VIG_KEYED: Vigenere on a mixed alphabet built from a keyword, used for
+ *   the plaintext, the ciphertext and the key (Quagmire III).
+ * All computed modulo the charset length.
+ */
+enum vig_cipher {
+	VIG_VIGENERE,
+	VIG_BEAUFORT,
+	VIG_VARIANT,
+	VIG_KEYED,
+	VIG_CIPHER_LAST
+};
+
+/*
+ * Substitution tables of a cipher over a charset. Both tables have one row of
+ * length positions per key position. enc[k * length + p] is the position of
+ * the ciphertext of p, dec is the inverse operation.
+ * Once built, it can be shared by any number of threads.
+ */
+struct vig_table {
+	const struct charset *charset;
+	enum vig_cipher cipher;
+	size_t length;
+
+	unsigned char *enc;
+	unsigned char *dec;
+
+	struct arena *arena;
+};
+
+/* Return the name of a cipher, or NULL if it doesn't exist. */
+const char *vig_cipher_name(enum vig_cipher cipher);
+
+/* Return the cipher with the given name, or VIG_CIPHER_LAST if none. */
+enum vig_cipher vig_cipher_from_name(const char *name);
+
+/*
+ * Build the tables of cipher for the charset cs. alphakey is the keyword of
+ * the mixed alphabet of VIG_KEYED and must be NULL for the other ciphers.
+ * Return ERR_INVAL if alphakey is missing or unexpected.
+ */
+int vig_table_init(struct vig_table *vt, const struct charset *cs,
+                   enum vig_cipher cipher, const char *alphakey,
+                   struct arena *arena);
+
+void vig_table_fini(struct vig_table *vt);
+
+/*
+ * Same as vig_encrypt and vig_decrypt with the cipher of the table vt. The
+ * text must use the charset of the table.
+ */
+int vig_encrypt_table(struct fs_ctx *str, const struct vig_table *vt,
+                      const char *key);
+int vig_decrypt_table(struct fs_ctx *str, const struct vig_table *vt,
+                      const char *key);
+
+
+
+/*
+ * Encrypt or decrypt a text that is not available all at once.
+ * The pieces must be given in order to vig_stream_apply, the key position is
+ * carried from one piece to the next.
  */
-void vig_decrypt(struct fs_ctx *str, const char *key);
+struct vig_stream {
+	const struct charset *charset;
+
+	/* Shift to apply for each key character. Always positive. */
+	size_t *shift;
+
+	/* Or substitution row of each key character, when using a table. */
+	const unsigned char **rows;
+	size_t klen;
+
+	/* Index in the key of the next character to transform. */
+	size_t phase;
+
+	struct arena *arena;
+};
+
+#define VIG_ENCRYPT 1
+#define VIG_DECRYPT -1
+
+/*
+ * Prepare the stream to encrypt (sign = VIG_ENCRYPT) or decrypt
+ * (sign = VIG_DECRYPT) with the given key.
+ * Return ERR_INVAL if the key has no character from the charset.
+ */
+int vig_stream_init(struct vig_stream *vs, const struct charset *cs,
+                    const char *key, int sign, struct arena *arena);
+
+/*
+ * Same as vig_stream_init with the cipher of the table vt. The table must
+ * outlive the stream.
+ */
+int vig_stream_init_table(struct vig_stream *vs, const struct vig_table *vt,
+                          const char *key, int sign, struct arena *arena);
+
+void vig_stream_fini(struct vig_stream *vs);
+
+/* Transform the next len bytes of the text in place. */
+void vig_stream_apply(struct vig_stream *vs, char *buf, size_t len);
 
 #endif